@@ -0,0 +1,288 @@
+// ArrowSeries.cpp : export and import of series through the Arrow C Data Interface.
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "ArrowSeries.h"
+#include "TimeSeriesTransformations.h"
+
+namespace
+{
+	// buffers of an exported column (only one of the two vectors is used). Each column owns its buffers, so that a consumer may
+	// move a child out of the struct and release it on its own, as the specification allows.
+	struct ColumnData
+	{
+		std::vector<int64_t> times;
+		std::vector<double> prices;
+		const void* buffers[2];
+	};
+
+	// the children of an exported struct array and the pointers to them.
+	struct StructData
+	{
+		ArrowArray children[2];
+		ArrowArray* childPointers[2];
+		const void* buffers[1];
+	};
+
+	// the name and the child schemas of an exported struct schema.
+	struct SchemaData
+	{
+		std::string name;
+		ArrowSchema children[2];
+		ArrowSchema* childPointers[2];
+	};
+
+	void releaseColumn(ArrowArray* array)
+	{
+		delete static_cast<ColumnData*>(array->private_data);
+		array->release = nullptr;
+	}
+
+	void releaseStruct(ArrowArray* array)
+	{
+		StructData* data = static_cast<StructData*>(array->private_data);
+		for (ArrowArray& child : data->children)
+		{
+			if (child.release != nullptr)
+			{
+				child.release(&child);
+			}
+		}
+		delete data;
+		array->release = nullptr;
+	}
+
+	// the child schemas only point at string literals.
+	void releaseChildSchema(ArrowSchema* schema)
+	{
+		schema->release = nullptr;
+	}
+
+	void releaseSchema(ArrowSchema* schema)
+	{
+		SchemaData* data = static_cast<SchemaData*>(schema->private_data);
+		for (ArrowSchema& child : data->children)
+		{
+			if (child.release != nullptr)
+			{
+				child.release(&child);
+			}
+		}
+		delete data;
+		schema->release = nullptr;
+	}
+
+	void makeChildSchema(ArrowSchema* schema, const char* format, const char* name)
+	{
+		*schema = ArrowSchema();
+		schema->format = format;
+		schema->name = name;
+		schema->release = releaseChildSchema;
+	}
+
+	// a primitive array over the column of data, which it owns.
+	void makeColumn(ArrowArray* array, ColumnData* data, const void* values, size_t length)
+	{
+		data->buffers[0] = nullptr;
+		data->buffers[1] = values;
+		*array = ArrowArray();
+		array->length = (int64_t)length;
+		array->n_buffers = 2;
+		array->buffers = data->buffers;
+		array->release = releaseColumn;
+		array->private_data = data;
+	}
+
+	bool isTimeFormat(const char* format)
+	{
+		return strcmp(format, "i") == 0 || strcmp(format, "l") == 0 || strncmp(format, "tss:", 4) == 0;
+	}
+
+	// true if an array has no nulls (a missing validity buffer also means no nulls).
+	bool hasNoNulls(const ArrowArray* array)
+	{
+		return array->null_count == 0 || (array->n_buffers > 0 && array->buffers != nullptr && array->buffers[0] == nullptr);
+	}
+
+	// true if a child schema and its format are there to be read.
+	bool hasFormat(const ArrowSchema* schema)
+	{
+		return schema != nullptr && schema->format != nullptr;
+	}
+
+	// true if a child array holds a values buffer (which may only be missing when the column is empty).
+	bool hasValues(const ArrowArray* array, int64_t length)
+	{
+		return array != nullptr && array->n_buffers == 2 && array->buffers != nullptr && (array->buffers[1] != nullptr || length == 0);
+	}
+}
+
+void ArrowSeries::exportColumns(const std::string& name, std::vector<int64_t>&& times, std::vector<double>&& prices, ArrowSchema* schema, ArrowArray* array)
+{
+	SchemaData* schemaData = new SchemaData();
+	schemaData->name = name;
+	makeChildSchema(&schemaData->children[0], "tss:UTC", "time");
+	makeChildSchema(&schemaData->children[1], "g", "price");
+	schemaData->childPointers[0] = &schemaData->children[0];
+	schemaData->childPointers[1] = &schemaData->children[1];
+
+	*schema = ArrowSchema();
+	schema->format = "+s";
+	schema->name = schemaData->name.c_str();
+	schema->n_children = 2;
+	schema->children = schemaData->childPointers;
+	schema->release = releaseSchema;
+	schema->private_data = schemaData;
+
+	size_t length = times.size();
+	ColumnData* timeData = new ColumnData();
+	timeData->times = std::move(times);
+	ColumnData* priceData = new ColumnData();
+	priceData->prices = std::move(prices);
+
+	StructData* structData = new StructData();
+	makeColumn(&structData->children[0], timeData, timeData->times.data(), length);
+	makeColumn(&structData->children[1], priceData, priceData->prices.data(), length);
+	structData->childPointers[0] = &structData->children[0];
+	structData->childPointers[1] = &structData->children[1];
+	structData->buffers[0] = nullptr;
+
+	*array = ArrowArray();
+	array->length = (int64_t)length;
+	array->n_buffers = 1;
+	array->buffers = structData->buffers;
+	array->n_children = 2;
+	array->children = structData->childPointers;
+	array->release = releaseStruct;
+	array->private_data = structData;
+}
+
+ArrowSeries::ArrowSeries(ArrowSchema* schema, ArrowArray* array)
+{
+	// moving the structures: the caller's copies are marked as released and the callbacks are now ours to call.
+	_schema = *schema;
+	_array = *array;
+	schema->release = nullptr;
+	array->release = nullptr;
+
+	// a foreign producer may hand over anything: every pointer is checked before it is followed.
+	bool valid = _schema.release != nullptr && _array.release != nullptr && _schema.format != nullptr && strcmp(_schema.format, "+s") == 0
+		&& _schema.n_children == 2 && _schema.children != nullptr && hasFormat(_schema.children[0]) && hasFormat(_schema.children[1])
+		&& _array.n_children == 2 && _array.children != nullptr && isTimeFormat(_schema.children[0]->format)
+		&& strcmp(_schema.children[1]->format, "g") == 0 && hasNoNulls(&_array) && _array.length >= 0 && _array.offset >= 0;
+	if (valid)
+	{
+		const ArrowArray* times = _array.children[0];
+		const ArrowArray* prices = _array.children[1];
+		valid = hasValues(times, _array.length) && hasValues(prices, _array.length) && hasNoNulls(times) && hasNoNulls(prices)
+			&& times->length >= _array.offset + _array.length && prices->length >= _array.offset + _array.length;
+		if (valid)
+		{
+			// the offset of the struct applies to its children, on top of their own offsets.
+			int64_t timeStart = _array.offset + times->offset;
+			if (strcmp(_schema.children[0]->format, "i") == 0)
+			{
+				_times32 = static_cast<const int32_t*>(times->buffers[1]) + timeStart;
+			}
+			else
+			{
+				_times64 = static_cast<const int64_t*>(times->buffers[1]) + timeStart;
+			}
+			_prices = static_cast<const double*>(prices->buffers[1]) + _array.offset + prices->offset;
+			_count = (size_t)_array.length;
+		}
+	}
+
+	if (!valid)
+	{
+		release();
+		throw std::invalid_argument("The Arrow array is not a series of times and prices.");
+	}
+}
+
+void ArrowSeries::release()
+{
+	if (_array.release != nullptr)
+	{
+		_array.release(&_array);
+	}
+	if (_schema.release != nullptr)
+	{
+		_schema.release(&_schema);
+	}
+	_times32 = nullptr;
+	_times64 = nullptr;
+	_prices = nullptr;
+	_count = 0;
+}
+
+ArrowSeries::~ArrowSeries()
+{
+	release();
+}
+
+ArrowSeries::ArrowSeries(ArrowSeries&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+ArrowSeries& ArrowSeries::operator=(ArrowSeries&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		_schema = other._schema;
+		_array = other._array;
+		_times32 = other._times32;
+		_times64 = other._times64;
+		_prices = other._prices;
+		_count = other._count;
+		other._schema.release = nullptr;
+		other._array.release = nullptr;
+		other.release();
+	}
+	return *this;
+}
+
+size_t ArrowSeries::count() const
+{
+	return _count;
+}
+
+std::string ArrowSeries::getName() const
+{
+	return (_schema.release != nullptr && _schema.name != nullptr ? _schema.name : "");
+}
+
+int64_t ArrowSeries::time(size_t i) const
+{
+	return (_times32 != nullptr ? _times32[i] : _times64[i]);
+}
+
+double ArrowSeries::price(size_t i) const
+{
+	return _prices[i];
+}
+
+const double* ArrowSeries::prices() const
+{
+	return _prices;
+}
+
+TimeSeriesTransformations ArrowSeries::toSeries() const
+{
+	std::vector<int> times(_count);
+	std::vector<double> prices(_prices, _prices + _count);
+	for (size_t i = 0; i < _count; i++)
+	{
+		// a 64-bit time beyond the range of the series is refused rather than truncated into another time.
+		int64_t value = time(i);
+		if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+		{
+			throw std::invalid_argument("The Arrow times do not fit the UNIX times of a series.");
+		}
+		times[i] = (int)value;
+	}
+	return TimeSeriesTransformations(times, prices, getName());
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "ArrowCDataInterface.h"
+
+class TimeSeriesTransformations;
+
+// a series held in Arrow C Data Interface structures, as exchanged with other runtimes (pyarrow, R arrow, DuckDB, ...).
+// the layout is a struct array with two non-nullable children: "time", a timestamp in seconds ("tss:UTC", 64-bit values) and
+// "price", a float64 ("g"). TimeSeriesTransformations::exportArrow produces it.
+// an ArrowSeries adopts the structures produced by another library without copying their buffers: it reads the columns in place
+// and calls the release callback of the producer when it is destroyed. Time columns of 32 or 64-bit integers are accepted too.
+class ArrowSeries
+{
+
+private:
+    ArrowSchema _schema{};
+    ArrowArray _array{};
+
+    // the two columns, at the offset of their arrays. Only one of the two time pointers is set.
+    const int32_t* _times32 = nullptr;
+    const int64_t* _times64 = nullptr;
+    const double* _prices = nullptr;
+    size_t _count = 0;
+
+    // releases the adopted structures.
+    void release();
+
+public:
+
+    // takes over the columns already copied out of a series and exports them, with a release callback that frees them.
+    static void exportColumns(const std::string& name, std::vector<int64_t>&& times, std::vector<double>&& prices, ArrowSchema* schema, ArrowArray* array);
+
+    // an empty series.
+    ArrowSeries() = default;
+
+    // adopts a schema and an array (which are marked as released, as the specification asks of a move).
+    // throws std::invalid_argument, after releasing them, if they do not describe a series.
+    ArrowSeries(ArrowSchema* schema, ArrowArray* array);
+
+    ~ArrowSeries();
+
+    ArrowSeries(const ArrowSeries&) = delete;
+    ArrowSeries& operator=(const ArrowSeries&) = delete;
+
+    ArrowSeries(ArrowSeries&& other) noexcept;
+    ArrowSeries& operator=(ArrowSeries&& other) noexcept;
+
+    // number of rows.
+    size_t count() const;
+
+    // name of the series (the name of the struct field, empty if there is none).
+    std::string getName() const;
+
+    // time and price of row i, read from the foreign buffers.
+    int64_t time(size_t i) const;
+    double price(size_t i) const;
+
+    // the price column itself.
+    const double* prices() const;
+
+    // copies the rows into a new series. Throws std::invalid_argument if a time does not fit the int UNIX times of a series.
+    TimeSeriesTransformations toSeries() const;
+
+};
@@ -0,0 +1,286 @@
+// BinarySeriesFile.cpp : binary series files with a block index in their footer.
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include "BinarySeriesFile.h"
+#include "TimeSeriesTransformations.h"
+
+namespace
+{
+	const char fileMagic[8] = { 'T', 'S', 'T', 'B', 'I', 'N', '0', '1' };
+	const char footerMagic[8] = { 'T', 'S', 'T', 'F', 'O', 'O', 'T', '1' };
+
+	// the trailer holds the offset of the footer, the number of blocks and the footer magic.
+	const size_t trailerSize = 24;
+
+	size_t roundUpTo8(size_t size)
+	{
+		return (size + 7) / 8 * 8;
+	}
+
+	uint64_t readUint64(const char* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+}
+
+void BinarySeriesFile::write(const TimeSeriesTransformations& t, const std::string& filenameandpath, int blockSize)
+{
+	std::ofstream out(filenameandpath, std::ios::binary);
+	if (!out.is_open())
+	{
+		throw std::runtime_error("Could not open file.");
+	}
+
+	const std::vector<std::pair<int, double>>& data = t._data;
+	size_t rowsPerBlock = (size_t)std::max(blockSize, 1);
+	const char padding[8] = {};
+	out.write(fileMagic, sizeof(fileMagic));
+	uint64_t offset = sizeof(fileMagic);
+
+	std::vector<BlockEntry> index;
+	std::vector<int32_t> times;
+	std::vector<double> prices;
+	for (size_t begin = 0; begin < data.size(); begin += rowsPerBlock)
+	{
+		size_t count = std::min(rowsPerBlock, data.size() - begin);
+		times.resize(count);
+		prices.resize(count);
+
+		BlockEntry entry = {};
+		entry.firstTime = data[begin].first;
+		entry.lastTime = data[begin + count - 1].first;
+		entry.count = (uint32_t)count;
+		entry.offset = offset;
+		entry.minPrice = std::numeric_limits<double>::infinity();
+		entry.maxPrice = -std::numeric_limits<double>::infinity();
+		for (size_t i = 0; i < count; i++)
+		{
+			times[i] = data[begin + i].first;
+			prices[i] = data[begin + i].second;
+			entry.minPrice = std::min(entry.minPrice, prices[i]);
+			entry.maxPrice = std::max(entry.maxPrice, prices[i]);
+			entry.sum += prices[i];
+		}
+		index.push_back(entry);
+
+		out.write(reinterpret_cast<const char*>(times.data()), count * sizeof(int32_t));
+		out.write(padding, roundUpTo8(count * sizeof(int32_t)) - count * sizeof(int32_t));
+		out.write(reinterpret_cast<const char*>(prices.data()), count * sizeof(double));
+		offset += roundUpTo8(count * sizeof(int32_t)) + count * sizeof(double);
+	}
+
+	// footer: the name, then the index.
+	uint64_t footerOffset = offset;
+	uint64_t nameLength = t._name.size();
+	out.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+	out.write(t._name.data(), nameLength);
+	out.write(padding, roundUpTo8(nameLength) - nameLength);
+	out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(BlockEntry));
+
+	uint64_t blockCount = index.size();
+	out.write(reinterpret_cast<const char*>(&footerOffset), sizeof(footerOffset));
+	out.write(reinterpret_cast<const char*>(&blockCount), sizeof(blockCount));
+	out.write(footerMagic, sizeof(footerMagic));
+	if (!out.good())
+	{
+		throw std::runtime_error("Could not write file.");
+	}
+}
+
+// only the trailer and the footer are read here; the blocks are paged in when a query touches them.
+BinarySeriesFile::BinarySeriesFile(const std::string& filenameandpath)
+	: _file(filenameandpath)
+{
+	const char* data = _file.data();
+	size_t size = _file.size();
+	if (size < sizeof(fileMagic) + trailerSize || memcmp(data, fileMagic, sizeof(fileMagic)) != 0
+		|| memcmp(data + size - sizeof(footerMagic), footerMagic, sizeof(footerMagic)) != 0)
+	{
+		throw std::runtime_error("Not a binary series file.");
+	}
+
+	uint64_t footerOffset = readUint64(data + size - trailerSize);
+	uint64_t blockCount = readUint64(data + size - trailerSize + 8);
+	if (footerOffset % 8 != 0 || footerOffset + 8 > size - trailerSize)
+	{
+		throw std::runtime_error("Not a binary series file.");
+	}
+	uint64_t nameLength = readUint64(data + footerOffset);
+	uint64_t indexOffset = footerOffset + 8 + roundUpTo8(nameLength);
+	if (nameLength > size || indexOffset + blockCount * sizeof(BlockEntry) != size - trailerSize)
+	{
+		throw std::runtime_error("Not a binary series file.");
+	}
+
+	_name.assign(data + footerOffset + 8, nameLength);
+	_blocks = reinterpret_cast<const BlockEntry*>(data + indexOffset);
+	_blockCount = (size_t)blockCount;
+	for (size_t b = 0; b < _blockCount; b++)
+	{
+		if (_blocks[b].offset + roundUpTo8(_blocks[b].count * sizeof(int32_t)) + _blocks[b].count * sizeof(double) > footerOffset)
+		{
+			throw std::runtime_error("Not a binary series file.");
+		}
+		_count += _blocks[b].count;
+	}
+}
+
+const int32_t* BinarySeriesFile::blockTimes(size_t b) const
+{
+	return reinterpret_cast<const int32_t*>(_file.data() + _blocks[b].offset);
+}
+
+const double* BinarySeriesFile::blockPrices(size_t b) const
+{
+	return reinterpret_cast<const double*>(_file.data() + _blocks[b].offset + roundUpTo8(_blocks[b].count * sizeof(int32_t)));
+}
+
+size_t BinarySeriesFile::firstBlockFrom(int unix) const
+{
+	return std::lower_bound(_blocks, _blocks + _blockCount, unix, [](const BlockEntry& block, int time) { return block.lastTime < time; }) - _blocks;
+}
+
+template <typename BlockFunction, typename RowFunction>
+void BinarySeriesFile::scanBetween(int from, int to, BlockFunction onBlock, RowFunction onRow) const
+{
+	if (from > to)
+	{
+		return;
+	}
+
+	for (size_t b = firstBlockFrom(from); b < _blockCount && _blocks[b].firstTime <= to; b++)
+	{
+		const BlockEntry& block = _blocks[b];
+		if (block.firstTime >= from && block.lastTime <= to)
+		{
+			// the whole block is in range: its summary is enough.
+			onBlock(block);
+		}
+		else
+		{
+			const int32_t* times = blockTimes(b);
+			const double* prices = blockPrices(b);
+			size_t begin = std::lower_bound(times, times + block.count, from) - times;
+			size_t end = std::upper_bound(times, times + block.count, to) - times;
+			for (size_t i = begin; i < end; i++)
+			{
+				onRow(times[i], prices[i]);
+			}
+		}
+	}
+}
+
+TimeSeriesTransformations BinarySeriesFile::load() const
+{
+	return loadBetween(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+}
+
+TimeSeriesTransformations BinarySeriesFile::loadBetween(int from, int to) const
+{
+	TimeSeriesTransformations t;
+	t._name = _name;
+	t._separator = ',';
+	t._data.reserve(countBetween(from, to));
+
+	scanBetween(from, to, [this, &t](const BlockEntry& block)
+	{
+		size_t b = &block - _blocks;
+		const int32_t* times = blockTimes(b);
+		const double* prices = blockPrices(b);
+		for (size_t i = 0; i < block.count; i++)
+		{
+			t._data.push_back({ times[i], prices[i] });
+		}
+	}, [&t](int time, double price) { t._data.push_back({ time, price }); });
+	return t;
+}
+
+size_t BinarySeriesFile::count() const
+{
+	return _count;
+}
+
+size_t BinarySeriesFile::blockCount() const
+{
+	return _blockCount;
+}
+
+std::string BinarySeriesFile::getName() const
+{
+	return _name;
+}
+
+size_t BinarySeriesFile::countBetween(int from, int to) const
+{
+	size_t n = 0;
+	scanBetween(from, to, [&n](const BlockEntry& block) { n += block.count; }, [&n](int, double) { n++; });
+	return n;
+}
+
+bool BinarySeriesFile::sumBetween(int from, int to, double* value) const
+{
+	size_t n = 0;
+	double cumSum = 0.0;
+	scanBetween(from, to, [&](const BlockEntry& block) { n += block.count; cumSum += block.sum; }, [&](int, double price) { n++; cumSum += price; });
+
+	*value = (n == 0 ? std::numeric_limits<double>::quiet_NaN() : cumSum);
+	return n != 0;
+}
+
+bool BinarySeriesFile::meanBetween(int from, int to, double* value) const
+{
+	size_t n = 0;
+	double cumSum = 0.0;
+	scanBetween(from, to, [&](const BlockEntry& block) { n += block.count; cumSum += block.sum; }, [&](int, double price) { n++; cumSum += price; });
+
+	*value = (n == 0 ? std::numeric_limits<double>::quiet_NaN() : cumSum / n);
+	return n != 0;
+}
+
+bool BinarySeriesFile::minBetween(int from, int to, double* value) const
+{
+	double lowest = std::numeric_limits<double>::infinity();
+	size_t n = 0;
+	scanBetween(from, to, [&](const BlockEntry& block) { n += block.count; lowest = std::min(lowest, block.minPrice); }, [&](int, double price) { n++; lowest = std::min(lowest, price); });
+
+	*value = (n == 0 ? std::numeric_limits<double>::quiet_NaN() : lowest);
+	return n != 0;
+}
+
+bool BinarySeriesFile::maxBetween(int from, int to, double* value) const
+{
+	double highest = -std::numeric_limits<double>::infinity();
+	size_t n = 0;
+	scanBetween(from, to, [&](const BlockEntry& block) { n += block.count; highest = std::max(highest, block.maxPrice); }, [&](int, double price) { n++; highest = std::max(highest, price); });
+
+	*value = (n == 0 ? std::numeric_limits<double>::quiet_NaN() : highest);
+	return n != 0;
+}
+
+// only the block that may hold the time is read.
+bool BinarySeriesFile::getPriceAtTime(int unix, double* value) const
+{
+	size_t b = firstBlockFrom(unix);
+	if (b < _blockCount && _blocks[b].firstTime <= unix)
+	{
+		const int32_t* times = blockTimes(b);
+		size_t i = std::lower_bound(times, times + _blocks[b].count, unix) - times;
+		if (i < _blocks[b].count && times[i] == unix)
+		{
+			*value = blockPrices(b)[i];
+			return true;
+		}
+	}
+	*value = std::numeric_limits<double>::quiet_NaN();
+	return false;
+}
+
+bool BinarySeriesFile::getPriceAtDate(const std::string& date, double* value) const
+{
+	return getPriceAtTime(TimeSeriesTransformations::convertToUnix(date), value);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "MappedFile.h"
+
+class TimeSeriesTransformations;
+
+// single-file binary format of a series with a footer that makes range reads cheap.
+// the rows are stored in blocks (times then prices of each block). After the blocks comes the footer: the name of the series and
+// a sparse index holding, for every block, its time bounds, its offset in the file and the count, min, max and sum of its prices.
+// the file ends with the offset of the footer. A reader maps the file and reads the footer only: lookups binary search the index
+// and touch one block, and range statistics come from the block summaries except for the two blocks at the edges of the range.
+class BinarySeriesFile
+{
+
+private:
+    // entry of the sparse index, as stored in the footer.
+    struct BlockEntry
+    {
+        int32_t firstTime;
+        int32_t lastTime;
+        uint32_t count;
+        uint32_t padding;
+        uint64_t offset;
+        double minPrice;
+        double maxPrice;
+        double sum;
+    };
+
+    MappedFile _file;
+    std::string _name{};
+
+    // the sparse index, pointing into the mapped footer.
+    const BlockEntry* _blocks = nullptr;
+    size_t _blockCount = 0;
+    size_t _count = 0;
+
+    // times and prices of a block, pointing into the mapped file.
+    const int32_t* blockTimes(size_t b) const;
+    const double* blockPrices(size_t b) const;
+
+    // index of the first block whose last time is at least the given one.
+    size_t firstBlockFrom(int unix) const;
+
+    // visits the blocks overlapping [from, to]: the fully covered ones are passed to onBlock, the rows in range of the others to onRow.
+    template <typename BlockFunction, typename RowFunction>
+    void scanBetween(int from, int to, BlockFunction onBlock, RowFunction onRow) const;
+
+public:
+
+    // default number of rows of a block.
+    static const int defaultBlockSize = 4096;
+
+    // writes the series to a binary file with blocks of blockSize rows. Throws std::runtime_error if the file cannot be written.
+    static void write(const TimeSeriesTransformations& t, const std::string& filenameandpath, int blockSize = defaultBlockSize);
+
+    // maps a binary file and reads its footer. Throws std::runtime_error if the file cannot be opened or is not a binary series.
+    explicit BinarySeriesFile(const std::string& filenameandpath);
+
+    // loads the whole series.
+    TimeSeriesTransformations load() const;
+
+    // loads the prices with from <= time <= to, touching only the blocks that overlap the range.
+    TimeSeriesTransformations loadBetween(int from, int to) const;
+
+    // number of prices, and number of blocks.
+    size_t count() const;
+    size_t blockCount() const;
+
+    // name of the stored series.
+    std::string getName() const;
+
+    // number of prices with from <= time <= to, and their sum, mean, lowest and highest value.
+    size_t countBetween(int from, int to) const;
+    bool sumBetween(int from, int to, double* value) const;
+    bool meanBetween(int from, int to, double* value) const;
+    bool minBetween(int from, int to, double* value) const;
+    bool maxBetween(int from, int to, double* value) const;
+
+    // price at a given UNIX time (the first one if the time is repeated), reading a single block.
+    bool getPriceAtTime(int unix, double* value) const;
+
+    // same as getPriceAtTime for a date in the format of TimeSeriesTransformations::convertToUnix.
+    bool getPriceAtDate(const std::string& date, double* value) const;
+
+};
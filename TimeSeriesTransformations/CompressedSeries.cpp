@@ -0,0 +1,557 @@
+// CompressedSeries.cpp : block compressed storage for TimeSeriesTransformations objects.
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <cmath>
+#include "CompressedSeries.h"
+#include "TimeSeriesTransformations.h"
+
+namespace
+{
+	// writes values bit by bit (most significant bit first) at the end of a stream of 64-bit words.
+	class BitWriter
+	{
+	private:
+		std::vector<uint64_t>& _words;
+		size_t& _bitCount;
+
+	public:
+		BitWriter(std::vector<uint64_t>& words, size_t& bitCount) : _words(words), _bitCount(bitCount) {}
+
+		// appends the lowest "bits" bits of value (0 <= bits <= 64).
+		void write(uint64_t value, int bits)
+		{
+			if (bits == 0)
+			{
+				return;
+			}
+			if (bits < 64)
+			{
+				value &= (uint64_t(1) << bits) - 1;
+			}
+
+			// number of bits still free in the last word.
+			int used = (int)(_bitCount % 64);
+			if (used == 0)
+			{
+				_words.push_back(0);
+			}
+			int free = 64 - used;
+
+			if (bits <= free)
+			{
+				_words.back() |= value << (free - bits);
+			}
+			else
+			{
+				// the value straddles two words.
+				_words.back() |= value >> (bits - free);
+				_words.push_back(value << (64 - (bits - free)));
+			}
+			_bitCount += bits;
+		}
+	};
+
+	// reads back the values written by BitWriter.
+	class BitReader
+	{
+	private:
+		const uint64_t* _words;
+		size_t _position;
+
+	public:
+		BitReader(const uint64_t* words, size_t position) : _words(words), _position(position) {}
+
+		uint64_t read(int bits)
+		{
+			if (bits == 0)
+			{
+				return 0;
+			}
+			size_t word = _position / 64;
+			int offset = (int)(_position % 64);
+			int available = 64 - offset;
+			uint64_t value;
+
+			if (bits <= available)
+			{
+				value = (_words[word] << offset) >> (64 - bits);
+			}
+			else
+			{
+				int rest = bits - available;
+				value = (((_words[word] << offset) >> offset) << rest) | (_words[word + 1] >> (64 - rest));
+			}
+			_position += bits;
+			return value;
+		}
+	};
+
+	// reinterprets a double as its 64 bits and back.
+	uint64_t toBits(double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	double fromBits(uint64_t bits)
+	{
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// number of leading and trailing zero bits of a non-zero word.
+	int leadingZeros(uint64_t x)
+	{
+		int n = 0;
+		for (int shift = 32; shift > 0; shift /= 2)
+		{
+			if ((x >> (64 - shift)) == 0)
+			{
+				n += shift;
+				x <<= shift;
+			}
+		}
+		return n;
+	}
+
+	int trailingZeros(uint64_t x)
+	{
+		int n = 0;
+		for (int shift = 32; shift > 0; shift /= 2)
+		{
+			if ((x << (64 - shift)) == 0)
+			{
+				n += shift;
+				x >>= shift;
+			}
+		}
+		return n;
+	}
+
+	// the delta of two consecutive deltas is stored with a variable length code:
+	// '0' for zero (regular timestamps), then '10', '110', '1110' followed by 7, 9 or 12 bits, and '1111' followed by 33 bits.
+	// the value is zigzag encoded so that small negative numbers also get a short code.
+	void writeDeltaOfDelta(BitWriter& writer, int64_t deltaOfDelta)
+	{
+		if (deltaOfDelta == 0)
+		{
+			writer.write(0, 1);
+			return;
+		}
+
+		uint64_t zigzag = ((uint64_t)deltaOfDelta << 1) ^ (uint64_t)(deltaOfDelta >> 63);
+
+		if (zigzag < (uint64_t(1) << 7))
+		{
+			writer.write(2, 2); writer.write(zigzag, 7);
+		}
+		else if (zigzag < (uint64_t(1) << 9))
+		{
+			writer.write(6, 3); writer.write(zigzag, 9);
+		}
+		else if (zigzag < (uint64_t(1) << 12))
+		{
+			writer.write(14, 4); writer.write(zigzag, 12);
+		}
+		else
+		{
+			// timestamps are 32-bit, so a delta of deltas always fits in 33 bits once zigzag encoded.
+			writer.write(15, 4); writer.write(zigzag, 33);
+		}
+	}
+
+	int64_t readDeltaOfDelta(BitReader& reader)
+	{
+		int bits;
+		if (reader.read(1) == 0)
+		{
+			return 0;
+		}
+		else if (reader.read(1) == 0)
+		{
+			bits = 7;
+		}
+		else if (reader.read(1) == 0)
+		{
+			bits = 9;
+		}
+		else if (reader.read(1) == 0)
+		{
+			bits = 12;
+		}
+		else
+		{
+			bits = 33;
+		}
+
+		uint64_t zigzag = reader.read(bits);
+		return (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+	}
+}
+
+// we compress the data of the given object in blocks of blockSize points.
+CompressedSeries::CompressedSeries(const TimeSeriesTransformations& t, int blockSize)
+{
+	if (blockSize < 1)
+	{
+		blockSize = defaultBlockSize;
+	}
+
+	_name = t._name;
+	_count = (int)t._data.size();
+
+	for (int first = 0; first < _count; first += blockSize)
+	{
+		appendBlock(t._data.data() + first, std::min(blockSize, _count - first));
+	}
+
+	// release the spare capacity left by the growth of the vectors.
+	_bits.shrink_to_fit();
+	_blocks.shrink_to_fit();
+}
+
+// function that encodes a block of sorted points at the end of the bit stream and stores its summary.
+void CompressedSeries::appendBlock(const std::pair<int, double>* points, int count)
+{
+	Block block{ _bitCount, count, points[0].first, points[count - 1].first,
+		std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0.0 };
+
+	BitWriter writer(_bits, _bitCount);
+
+	// the first point is stored in full.
+	writer.write((uint32_t)points[0].first, 32);
+	writer.write(toBits(points[0].second), 64);
+
+	int64_t previousTime = points[0].first;
+	int64_t previousDelta = 0;
+	uint64_t previousBits = toBits(points[0].second);
+
+	// meaningful bit window of the last XOR written in full (-1 means none yet).
+	int previousLeading = -1;
+	int previousTrailing = 0;
+
+	for (int i = 1; i < count; i++)
+	{
+		// timestamps: delta of deltas, which is zero for a regular grid.
+		int64_t delta = (int64_t)points[i].first - previousTime;
+		writeDeltaOfDelta(writer, delta - previousDelta);
+		previousTime = points[i].first;
+		previousDelta = delta;
+
+		// prices: XOR with the previous price, of which only the meaningful bits are written.
+		uint64_t bits = toBits(points[i].second);
+		uint64_t xored = bits ^ previousBits;
+		previousBits = bits;
+
+		if (xored == 0)
+		{
+			writer.write(0, 1);
+			continue;
+		}
+
+		int leading = std::min(leadingZeros(xored), 31);
+		int trailing = trailingZeros(xored);
+
+		if (previousLeading >= 0 && leading >= previousLeading && trailing >= previousTrailing)
+		{
+			// the meaningful bits fit in the previous window.
+			writer.write(2, 2);
+			writer.write(xored >> previousTrailing, 64 - previousLeading - previousTrailing);
+		}
+		else
+		{
+			// new window: 5 bits of leading zeros and 6 bits of length (64 is stored as 0).
+			int significant = 64 - leading - trailing;
+			writer.write(3, 2);
+			writer.write(leading, 5);
+			writer.write(significant == 64 ? 0 : significant, 6);
+			writer.write(xored >> trailing, significant);
+			previousLeading = leading;
+			previousTrailing = trailing;
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		block.minPrice = std::min(block.minPrice, points[i].second);
+		block.maxPrice = std::max(block.maxPrice, points[i].second);
+		block.sum += points[i].second;
+	}
+
+	_blocks.push_back(block);
+}
+
+// function that decodes a block into the given vectors.
+void CompressedSeries::decodeBlock(int block, std::vector<int>* time, std::vector<double>* price) const
+{
+	const Block& summary = _blocks[block];
+	time->resize(summary.count);
+	price->resize(summary.count);
+
+	BitReader reader(_bits.data(), summary.bitOffset);
+
+	int64_t previousTime = (int32_t)(uint32_t)reader.read(32);
+	uint64_t previousBits = reader.read(64);
+	int64_t previousDelta = 0;
+	int previousLeading = 0;
+	int previousTrailing = 0;
+
+	(*time)[0] = (int)previousTime;
+	(*price)[0] = fromBits(previousBits);
+
+	for (int i = 1; i < summary.count; i++)
+	{
+		previousDelta += readDeltaOfDelta(reader);
+		previousTime += previousDelta;
+
+		if (reader.read(1) == 1)
+		{
+			if (reader.read(1) == 1)
+			{
+				previousLeading = (int)reader.read(5);
+				int significant = (int)reader.read(6);
+				if (significant == 0)
+				{
+					significant = 64;
+				}
+				previousTrailing = 64 - previousLeading - significant;
+			}
+			previousBits ^= reader.read(64 - previousLeading - previousTrailing) << previousTrailing;
+		}
+
+		(*time)[i] = (int)previousTime;
+		(*price)[i] = fromBits(previousBits);
+	}
+}
+
+// function that rebuilds a TimeSeriesTransformations object from the blocks.
+TimeSeriesTransformations CompressedSeries::decompress() const
+{
+	TimeSeriesTransformations t;
+	t._name = _name;
+	t._separator = ',';
+	t._data.reserve(_count);
+
+	std::vector<int> time;
+	std::vector<double> price;
+	for (int b = 0; b < blockCount(); b++)
+	{
+		decodeBlock(b, &time, &price);
+		for (size_t i = 0; i < time.size(); i++)
+		{
+			t._data.push_back({ time[i], price[i] });
+		}
+	}
+	return t;
+}
+
+int CompressedSeries::count() const
+{
+	return _count;
+}
+
+std::string CompressedSeries::getName() const
+{
+	return _name;
+}
+
+int CompressedSeries::blockCount() const
+{
+	return (int)_blocks.size();
+}
+
+// the mean only needs the sum of each block.
+bool CompressedSeries::mean(double* meanValue) const
+{
+	if (_count == 0)
+	{
+		*meanValue = std::numeric_limits<double>::quiet_NaN();
+		return false;
+	}
+
+	double cumSum = 0.0;
+	for (const Block& block : _blocks)
+	{
+		cumSum += block.sum;
+	}
+	*meanValue = cumSum / _count;
+	return true;
+}
+
+// the standard deviation needs the squared differences to the mean, so every block is decoded once (one at a time).
+bool CompressedSeries::standardDeviation(double* standardDeviationValue) const
+{
+	double meanValue;
+	if (!mean(&meanValue))
+	{
+		*standardDeviationValue = std::numeric_limits<double>::quiet_NaN();
+		return false;
+	}
+
+	double cumSum = 0.0;
+	std::vector<int> time;
+	std::vector<double> price;
+	for (int b = 0; b < blockCount(); b++)
+	{
+		decodeBlock(b, &time, &price);
+		for (double point : price)
+		{
+			cumSum += (point - meanValue) * (point - meanValue);
+		}
+	}
+
+	// sample SD, as in TimeSeriesTransformations::standardDeviation.
+	*standardDeviationValue = sqrt(cumSum / (_count - 1));
+	return true;
+}
+
+bool CompressedSeries::minPrice(double* value) const
+{
+	if (_count == 0)
+	{
+		*value = std::numeric_limits<double>::quiet_NaN();
+		return false;
+	}
+	*value = _blocks[0].minPrice;
+	for (const Block& block : _blocks)
+	{
+		*value = std::min(*value, block.minPrice);
+	}
+	return true;
+}
+
+bool CompressedSeries::maxPrice(double* value) const
+{
+	if (_count == 0)
+	{
+		*value = std::numeric_limits<double>::quiet_NaN();
+		return false;
+	}
+	*value = _blocks[0].maxPrice;
+	for (const Block& block : _blocks)
+	{
+		*value = std::max(*value, block.maxPrice);
+	}
+	return true;
+}
+
+// binary search on the last time of each block.
+size_t CompressedSeries::firstBlockFrom(int unix) const
+{
+	auto block = std::lower_bound(_blocks.begin(), _blocks.end(), unix, [](const Block& b, int time) { return b.lastTime < time; });
+	return std::distance(_blocks.begin(), block);
+}
+
+template <typename BlockFunction, typename PointFunction>
+void CompressedSeries::scanBetween(int from, int to, BlockFunction onBlock, PointFunction onPoint) const
+{
+	if (from > to)
+	{
+		return;
+	}
+
+	std::vector<int> time;
+	std::vector<double> price;
+	for (size_t b = firstBlockFrom(from); b < _blocks.size() && _blocks[b].firstTime <= to; b++)
+	{
+		const Block& block = _blocks[b];
+		if (block.firstTime >= from && block.lastTime <= to)
+		{
+			// the whole block is in range: its summary is enough.
+			onBlock(block);
+		}
+		else
+		{
+			decodeBlock((int)b, &time, &price);
+			for (size_t i = 0; i < time.size(); i++)
+			{
+				if (time[i] >= from && time[i] <= to)
+				{
+					onPoint(price[i]);
+				}
+			}
+		}
+	}
+}
+
+int CompressedSeries::countBetween(int from, int to) const
+{
+	int n = 0;
+	scanBetween(from, to, [&n](const Block& block) { n += block.count; }, [&n](double) { n++; });
+	return n;
+}
+
+bool CompressedSeries::sumBetween(int from, int to, double* value) const
+{
+	int n = 0;
+	double cumSum = 0.0;
+	scanBetween(from, to, [&](const Block& block) { n += block.count; cumSum += block.sum; }, [&](double price) { n++; cumSum += price; });
+
+	if (n == 0)
+	{
+		*value = std::numeric_limits<double>::quiet_NaN();
+		return false;
+	}
+	*value = cumSum;
+	return true;
+}
+
+bool CompressedSeries::meanBetween(int from, int to, double* value) const
+{
+	// the count and the sum come from the same scan, so the blocks at the edges are decoded once.
+	int n = 0;
+	double cumSum = 0.0;
+	scanBetween(from, to, [&](const Block& block) { n += block.count; cumSum += block.sum; }, [&](double price) { n++; cumSum += price; });
+
+	*value = (n == 0 ? std::numeric_limits<double>::quiet_NaN() : cumSum / n);
+	return n != 0;
+}
+
+bool CompressedSeries::minBetween(int from, int to, double* value) const
+{
+	double lowest = std::numeric_limits<double>::infinity();
+	int n = 0;
+	scanBetween(from, to, [&](const Block& block) { n += block.count; lowest = std::min(lowest, block.minPrice); }, [&](double price) { n++; lowest = std::min(lowest, price); });
+
+	*value = (n == 0 ? std::numeric_limits<double>::quiet_NaN() : lowest);
+	return n != 0;
+}
+
+bool CompressedSeries::maxBetween(int from, int to, double* value) const
+{
+	double highest = -std::numeric_limits<double>::infinity();
+	int n = 0;
+	scanBetween(from, to, [&](const Block& block) { n += block.count; highest = std::max(highest, block.maxPrice); }, [&](double price) { n++; highest = std::max(highest, price); });
+
+	*value = (n == 0 ? std::numeric_limits<double>::quiet_NaN() : highest);
+	return n != 0;
+}
+
+// only the block that may hold the time is decoded.
+bool CompressedSeries::getPriceAtTime(int unix, double* value) const
+{
+	size_t b = firstBlockFrom(unix);
+	if (b < _blocks.size() && _blocks[b].firstTime <= unix)
+	{
+		std::vector<int> time;
+		std::vector<double> price;
+		decodeBlock((int)b, &time, &price);
+
+		auto element = std::lower_bound(time.begin(), time.end(), unix);
+		if (element != time.end() && *element == unix)
+		{
+			*value = price[std::distance(time.begin(), element)];
+			return true;
+		}
+	}
+	*value = std::numeric_limits<double>::quiet_NaN();
+	return false;
+}
+
+size_t CompressedSeries::memoryUsage() const
+{
+	return sizeof(*this) + _bits.capacity() * sizeof(uint64_t) + _blocks.capacity() * sizeof(Block) + _name.capacity();
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+class TimeSeriesTransformations;
+
+// compressed, read-only copy of a TimeSeriesTransformations object.
+// the points are stored in fixed-size blocks: timestamps are delta-of-delta encoded and prices are XOR encoded against
+// the previous price (Gorilla style). every block keeps a small summary (time bounds, min, max, sum) so that many queries never decode it.
+class CompressedSeries
+{
+
+private:
+    // summary of a block of points.
+    struct Block
+    {
+        size_t bitOffset;   // position of the first bit of the block in the bit stream.
+        int count;          // number of points in the block.
+        int firstTime;      // first timestamp of the block.
+        int lastTime;       // last timestamp of the block.
+        double minPrice;    // lowest price of the block.
+        double maxPrice;    // highest price of the block.
+        double sum;         // sum of the prices of the block.
+    };
+
+    // the encoded points of all the blocks, stored one after the other.
+    std::vector<uint64_t> _bits{};
+
+    // number of bits used in _bits.
+    size_t _bitCount = 0;
+
+    // the block summaries, ordered by time.
+    std::vector<Block> _blocks{};
+
+    // name of the compressed series.
+    std::string _name{};
+
+    // total number of points.
+    int _count = 0;
+
+    // encodes count sorted points as a new block.
+    void appendBlock(const std::pair<int, double>* points, int count);
+
+    // index of the first block that may hold a time greater or equal to the given one.
+    size_t firstBlockFrom(int unix) const;
+
+    // visits the points of the blocks overlapping [from, to]. Fully covered blocks are passed to onBlock, the others are decoded and their points in range are passed to onPoint.
+    template <typename BlockFunction, typename PointFunction>
+    void scanBetween(int from, int to, BlockFunction onBlock, PointFunction onPoint) const;
+
+public:
+
+    // default number of points stored in a block.
+    static const int defaultBlockSize = 1024;
+
+    // default constructor.
+    CompressedSeries() = default;
+
+    // compresses the data of a TimeSeriesTransformations object using blocks of blockSize points.
+    explicit CompressedSeries(const TimeSeriesTransformations& t, int blockSize = defaultBlockSize);
+
+    // decodes every block back into a TimeSeriesTransformations object.
+    TimeSeriesTransformations decompress() const;
+
+    // number of points stored.
+    int count() const;
+
+    // name of the compressed series.
+    std::string getName() const;
+
+    // number of blocks.
+    int blockCount() const;
+
+    // decodes a single block into the given time and price vectors (which are overwritten).
+    void decodeBlock(int block, std::vector<int>* time, std::vector<double>* price) const;
+
+    // mean of the prices, answered from the block summaries alone.
+    bool mean(double* meanValue) const;
+
+    // sample standard deviation of the prices, decoding one block at a time.
+    bool standardDeviation(double* standardDeviationValue) const;
+
+    // lowest and highest price, answered from the block summaries alone.
+    bool minPrice(double* value) const;
+    bool maxPrice(double* value) const;
+
+    // number of points with from <= time <= to.
+    int countBetween(int from, int to) const;
+
+    // sum, mean, lowest and highest price of the points with from <= time <= to. Only the blocks at the edges of the range are decoded.
+    bool sumBetween(int from, int to, double* value) const;
+    bool meanBetween(int from, int to, double* value) const;
+    bool minBetween(int from, int to, double* value) const;
+    bool maxBetween(int from, int to, double* value) const;
+
+    // price at a given UNIX time (the first one if the time is repeated).
+    bool getPriceAtTime(int unix, double* value) const;
+
+    // number of bytes used by the compressed representation.
+    size_t memoryUsage() const;
+
+};
@@ -0,0 +1,89 @@
+// DurableSeries.cpp : a series kept durable by a write-ahead log.
+#include "DurableSeries.h"
+
+DurableSeries::DurableSeries(const std::string& filenameandpath, const std::string& name, DuplicatePolicy duplicates, size_t groupSize)
+	: _log(filenameandpath, name, groupSize), _series(WriteAheadLog::recover(filenameandpath, duplicates))
+{
+}
+
+const TimeSeriesTransformations& DurableSeries::series() const
+{
+	return _series;
+}
+
+// the change is applied first, so that a change the series refuses (e.g. an invalid date, which throws) is never logged.
+void DurableSeries::addASharePrice(std::string datetime, double price)
+{
+	_series.addASharePrice(datetime, price);
+	_log.append(LogOperation::Insert, TimeSeriesTransformations::convertToUnix(datetime), price);
+}
+
+void DurableSeries::addSharePrices(const std::vector<int>& time, const std::vector<double>& price)
+{
+	_series.addSharePrices(time, price);
+	for (size_t i = 0; i < time.size(); i++)
+	{
+		_log.append(LogOperation::Insert, time[i], price[i]);
+	}
+}
+
+// the removals that remove nothing are not logged.
+bool DurableSeries::removeEntryAtTime(std::string time)
+{
+	if (!_series.removeEntryAtTime(time))
+	{
+		return false;
+	}
+	_log.append(LogOperation::RemoveEntryAtTime, TimeSeriesTransformations::convertToUnix(time));
+	return true;
+}
+
+bool DurableSeries::removePricesGreaterThan(double price)
+{
+	if (!_series.removePricesGreaterThan(price))
+	{
+		return false;
+	}
+	_log.append(LogOperation::RemovePricesGreaterThan, 0, price);
+	return true;
+}
+
+bool DurableSeries::removePricesLowerThan(double price)
+{
+	if (!_series.removePricesLowerThan(price))
+	{
+		return false;
+	}
+	_log.append(LogOperation::RemovePricesLowerThan, 0, price);
+	return true;
+}
+
+bool DurableSeries::removePricesBefore(std::string date)
+{
+	if (!_series.removePricesBefore(date))
+	{
+		return false;
+	}
+	_log.append(LogOperation::RemovePricesBefore, TimeSeriesTransformations::convertToUnix(date));
+	return true;
+}
+
+bool DurableSeries::removePricesAfter(std::string date)
+{
+	if (!_series.removePricesAfter(date))
+	{
+		return false;
+	}
+	_log.append(LogOperation::RemovePricesAfter, TimeSeriesTransformations::convertToUnix(date));
+	return true;
+}
+
+void DurableSeries::commit()
+{
+	_log.commit();
+}
+
+void DurableSeries::checkpoint()
+{
+	_log.checkpoint(_series);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "TimeSeriesTransformations.h"
+#include "WriteAheadLog.h"
+
+// a series whose changes are recorded in a WriteAheadLog, so that it survives a crash without being saved again as a whole.
+// it is recovered from its log when it is opened. Each change is applied to the series and, if it changed something, appended to the log;
+// commit makes the changes so far durable at the cost of one sequential write and one sync (the log also commits on its own every
+// groupSize changes). checkpoint writes the whole series as the new snapshot and empties the log, which keeps the next recovery short.
+class DurableSeries
+{
+
+private:
+    WriteAheadLog _log;
+    TimeSeriesTransformations _series;
+
+public:
+
+    // opens the series logged in the given file, or starts an empty series called name if the file does not exist.
+    explicit DurableSeries(const std::string& filenameandpath, const std::string& name = "", DuplicatePolicy duplicates = DuplicatePolicy::KeepAll,
+        size_t groupSize = 4096);
+
+    DurableSeries(const DurableSeries&) = delete;
+    DurableSeries& operator=(const DurableSeries&) = delete;
+
+    // the series, to be read.
+    const TimeSeriesTransformations& series() const;
+
+    // the changes below behave as those of TimeSeriesTransformations, and are logged.
+    void addASharePrice(std::string datetime, double price);
+    void addSharePrices(const std::vector<int>& time, const std::vector<double>& price);
+    bool removeEntryAtTime(std::string time);
+    bool removePricesGreaterThan(double price);
+    bool removePricesLowerThan(double price);
+    bool removePricesBefore(std::string date);
+    bool removePricesAfter(std::string date);
+
+    // waits until every change made so far is on the disk.
+    void commit();
+
+    // writes the series as the new snapshot of the log, and empties the log.
+    void checkpoint();
+
+};
@@ -0,0 +1,181 @@
+// ExtremumIndex.cpp : blocked sparse table for constant-time range extremum queries.
+#include <algorithm>
+#include <cmath>
+#include "ExtremumIndex.h"
+
+namespace
+{
+	// number of values per block (a power of two).
+	const size_t blockBits = 6;
+	const size_t blockSize = size_t(1) << blockBits;
+
+	// floor of the base 2 logarithm of n > 0.
+	int floorLog2(size_t n)
+	{
+		int log = 0;
+		while (n >>= 1)
+		{
+			log++;
+		}
+		return log;
+	}
+}
+
+double ExtremumIndex::Column::value(const std::vector<std::pair<int, double>>& data, size_t i) const
+{
+	return (increments ? data[i + 1].second - data[i].second : data[i].second);
+}
+
+// a missing price (NaN, as left by a reindex) is never the extremum if there is a price.
+bool ExtremumIndex::Column::better(double candidate, double best) const
+{
+	if (std::isnan(best))
+	{
+		return !std::isnan(candidate);
+	}
+	return (greatest ? candidate > best : candidate < best);
+}
+
+// each new whole block adds its best value and, on each level k, the best of the 2^k blocks it ends, from two entries of the level below.
+void ExtremumIndex::Column::extend(const std::vector<std::pair<int, double>>& data)
+{
+	size = (increments ? std::max(data.size(), size_t(1)) - 1 : data.size());
+	for (size_t b = blockValues.size(); (b + 1) * blockSize <= size; b++)
+	{
+		double bestValue = value(data, b * blockSize);
+		for (size_t i = b * blockSize + 1; i < (b + 1) * blockSize; i++)
+		{
+			double candidate = value(data, i);
+			if (better(candidate, bestValue))
+			{
+				bestValue = candidate;
+			}
+		}
+		blockValues.push_back(bestValue);
+
+		if (levels.empty())
+		{
+			levels.emplace_back();
+		}
+		levels[0].push_back((uint32_t)b);
+		for (size_t k = 1; (size_t(1) << k) <= b + 1; k++)
+		{
+			if (levels.size() == k)
+			{
+				levels.emplace_back();
+			}
+			size_t first = b + 1 - (size_t(1) << k);
+			uint32_t left = levels[k - 1][first];
+			uint32_t right = levels[k - 1][first + (size_t(1) << (k - 1))];
+			levels[k].push_back(better(blockValues[right], blockValues[left]) ? right : left);
+		}
+	}
+}
+
+size_t ExtremumIndex::Column::best(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const
+{
+	size_t bestIndex = begin;
+	double bestValue = value(data, begin);
+	auto scan = [&](size_t from, size_t to)
+	{
+		for (size_t i = from; i < to; i++)
+		{
+			double candidate = value(data, i);
+			if (better(candidate, bestValue))
+			{
+				bestValue = candidate;
+				bestIndex = i;
+			}
+		}
+	};
+
+	// the whole blocks of the range, if any, are those from the first block boundary at or after begin to the last one at or before end.
+	size_t firstBlock = (begin + blockSize - 1) >> blockBits;
+	size_t lastBlock = std::min(end >> blockBits, blockValues.size());
+	if (firstBlock >= lastBlock)
+	{
+		scan(begin + 1, end);
+		return bestIndex;
+	}
+
+	scan(begin + 1, firstBlock * blockSize);
+	int k = floorLog2(lastBlock - firstBlock);
+	uint32_t left = levels[k][firstBlock];
+	uint32_t right = levels[k][lastBlock - (size_t(1) << k)];
+	uint32_t block = (better(blockValues[right], blockValues[left]) ? right : left);
+	if (better(blockValues[block], bestValue))
+	{
+		// the position of the best value is found again in its block.
+		bestValue = blockValues[block];
+		bestIndex = block * blockSize;
+		while (value(data, bestIndex) != bestValue)
+		{
+			bestIndex++;
+		}
+	}
+	scan(lastBlock * blockSize, end);
+	return bestIndex;
+}
+
+ExtremumIndex::ExtremumIndex()
+{
+	clear();
+}
+
+bool ExtremumIndex::built() const
+{
+	return _built;
+}
+
+void ExtremumIndex::build(const std::vector<std::pair<int, double>>& data)
+{
+	clear();
+	_built = true;
+	append(data);
+}
+
+void ExtremumIndex::append(const std::vector<std::pair<int, double>>& data)
+{
+	if (!_built)
+	{
+		return;
+	}
+
+	_lowestPrice.extend(data);
+	_highestPrice.extend(data);
+	_smallestIncrement.extend(data);
+	_greatestIncrement.extend(data);
+}
+
+void ExtremumIndex::clear()
+{
+	_lowestPrice = Column();
+	_highestPrice = Column();
+	_smallestIncrement = Column();
+	_greatestIncrement = Column();
+	_highestPrice.greatest = true;
+	_smallestIncrement.increments = true;
+	_greatestIncrement.increments = true;
+	_greatestIncrement.greatest = true;
+	_built = false;
+}
+
+size_t ExtremumIndex::lowestPrice(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const
+{
+	return _lowestPrice.best(data, begin, end);
+}
+
+size_t ExtremumIndex::highestPrice(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const
+{
+	return _highestPrice.best(data, begin, end);
+}
+
+size_t ExtremumIndex::smallestIncrement(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const
+{
+	return _smallestIncrement.best(data, begin, end);
+}
+
+size_t ExtremumIndex::greatestIncrement(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const
+{
+	return _greatestIncrement.best(data, begin, end);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// index of the lowest and highest prices and of the smallest and greatest increments of a series, answering "where is the extremum
+// between positions begin and end" in constant time. The values are grouped in blocks of 64; a sparse table over the blocks gives the
+// best block of any run of whole blocks from two overlapping powers of two, and the partial blocks at the ends of the run are scanned.
+// the table takes less than a tenth of the memory of the data per extremum. Appending values completes blocks, which only adds entries
+// at the end of each level of the table, so the index can follow a series that grows at the end.
+class ExtremumIndex
+{
+
+private:
+    // the extremum of one kind of value (prices or increments, lowest or highest).
+    struct Column
+    {
+        bool increments = false;
+        bool greatest = false;
+
+        // number of values indexed (the prices, or the increments between them).
+        size_t size = 0;
+
+        // best value of each whole block, and levels[k][b] the best of the blocks b to b + 2^k - 1 (the first one in case of ties).
+        std::vector<double> blockValues{};
+        std::vector<std::vector<uint32_t>> levels{};
+
+        double value(const std::vector<std::pair<int, double>>& data, size_t i) const;
+        bool better(double candidate, double best) const;
+
+        // indexes the values of data not indexed yet.
+        void extend(const std::vector<std::pair<int, double>>& data);
+
+        // position of the best value between begin and end - 1 (the first one in case of ties), begin < end.
+        size_t best(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const;
+    };
+
+    Column _lowestPrice{};
+    Column _highestPrice{};
+    Column _smallestIncrement{};
+    Column _greatestIncrement{};
+    bool _built = false;
+
+public:
+
+    ExtremumIndex();
+
+    // true once the index was built, and until it is cleared.
+    bool built() const;
+
+    // indexes all the prices of a series.
+    void build(const std::vector<std::pair<int, double>>& data);
+
+    // indexes the prices added at the end of the series since it was last indexed (does nothing if it is not built).
+    void append(const std::vector<std::pair<int, double>>& data);
+
+    // drops the index and frees its memory.
+    void clear();
+
+    // positions of the lowest and highest prices between the positions begin and end - 1 (the first one in case of ties), begin < end.
+    size_t lowestPrice(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const;
+    size_t highestPrice(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const;
+
+    // positions i of the smallest and greatest increments price[i + 1] - price[i] between the positions begin and end - 1, begin < end.
+    size_t smallestIncrement(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const;
+    size_t greatestIncrement(const std::vector<std::pair<int, double>>& data, size_t begin, size_t end) const;
+
+};
@@ -0,0 +1,366 @@
+// LoadCache.cpp : binary sidecars of parsed files, reused while the files do not change.
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <atomic>
+#include "LoadCache.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace
+{
+	const char sidecarMagic[8] = { 'T', 'S', 'T', 'C', 'A', 'C', 'H', '2' };
+	const char* const indexName = "cache.csv";
+
+	// numbers the temporary sidecars written by this process.
+	std::atomic<uint64_t> temporaryCount{ 0 };
+
+	size_t roundUpTo8(size_t size)
+	{
+		return (size + 7) / 8 * 8;
+	}
+
+	uint64_t readUint64(const char* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	// size and modification time (in nanoseconds where the system gives them) of a file.
+	bool fileStatus(const std::string& filenameandpath, uint64_t* size, int64_t* modified)
+	{
+#ifdef _WIN32
+		struct _stat64 status;
+		if (_stat64(filenameandpath.c_str(), &status) != 0)
+		{
+			return false;
+		}
+		*modified = (int64_t)status.st_mtime * 1000000000;
+#else
+		struct stat status;
+		if (stat(filenameandpath.c_str(), &status) != 0)
+		{
+			return false;
+		}
+#ifdef __linux__
+		*modified = (int64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+#else
+		*modified = (int64_t)status.st_mtime * 1000000000;
+#endif
+#endif
+		*size = (uint64_t)status.st_size;
+		return true;
+	}
+
+	// the header of a sidecar: what it was made from, and the name of the series.
+	struct SidecarHeader
+	{
+		uint64_t sourceSize;
+		int64_t sourceModified;
+		uint32_t duplicates;
+		uint32_t separator;
+		uint32_t hasHeader;
+		std::string path;
+		std::string name;
+		uint64_t rows;
+	};
+
+	void appendBytes(std::string& buffer, const void* data, size_t size)
+	{
+		buffer.append(static_cast<const char*>(data), size);
+		buffer.append(roundUpTo8(size) - size, '\0');
+	}
+
+	void appendString(std::string& buffer, const std::string& text)
+	{
+		uint64_t length = text.size();
+		appendBytes(buffer, &length, sizeof(length));
+		appendBytes(buffer, text.data(), text.size());
+	}
+
+	// reads a length-prefixed string at the offset, moving the offset past it.
+	bool readString(const char* data, size_t size, size_t* offset, std::string* text)
+	{
+		if (*offset + 8 > size)
+		{
+			return false;
+		}
+		uint64_t length = readUint64(data + *offset);
+		if (length > size || *offset + 8 + roundUpTo8(length) > size)
+		{
+			return false;
+		}
+		text->assign(data + *offset + 8, length);
+		*offset += 8 + roundUpTo8(length);
+		return true;
+	}
+
+	// reads the header of a sidecar and checks that the file holds all its rows. Returns the offset of the times (0 if invalid).
+	size_t readHeader(const char* data, size_t size, SidecarHeader* header)
+	{
+		const size_t fixedSize = sizeof(sidecarMagic) + 32;
+		if (size < fixedSize || memcmp(data, sidecarMagic, sizeof(sidecarMagic)) != 0)
+		{
+			return 0;
+		}
+		memcpy(&header->sourceSize, data + 8, 8);
+		memcpy(&header->sourceModified, data + 16, 8);
+		memcpy(&header->duplicates, data + 24, 4);
+		memcpy(&header->separator, data + 28, 4);
+		memcpy(&header->hasHeader, data + 32, 4);
+		size_t offset = fixedSize;
+		if (!readString(data, size, &offset, &header->path) || !readString(data, size, &offset, &header->name) || offset + 8 > size)
+		{
+			return 0;
+		}
+		header->rows = readUint64(data + offset);
+		offset += 8;
+		if (header->rows > size / 12 || offset + roundUpTo8(header->rows * sizeof(int32_t)) + header->rows * sizeof(double) != size)
+		{
+			return 0;
+		}
+		return offset;
+	}
+}
+
+LoadCache::LoadCache(const std::string& directory, uint64_t sizeLimit)
+	: _directory(directory), _sizeLimit(sizeLimit)
+{
+	// the directory is created if needed (an existing one is fine).
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	std::ifstream index(_directory + "/" + indexName);
+	std::string line;
+	while (getline(index, line))
+	{
+		std::stringstream ss(line);
+		Entry entry;
+		std::string bytes, lastUsed;
+		if (getline(ss, entry.file, ',') && getline(ss, bytes, ',') && getline(ss, lastUsed))
+		{
+			entry.bytes = strtoull(bytes.c_str(), nullptr, 10);
+			entry.lastUsed = strtoull(lastUsed.c_str(), nullptr, 10);
+			_clock = std::max(_clock, entry.lastUsed);
+			_entries.push_back(entry);
+		}
+	}
+}
+
+// FNV-1a hash of the path and the policy.
+std::string LoadCache::sidecarName(const std::string& filenameandpath, DuplicatePolicy duplicates)
+{
+	uint64_t hash = 14695981039346656037ull;
+	std::string key = filenameandpath + '\0' + std::to_string((int)duplicates);
+	for (char c : key)
+	{
+		hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tsc", (unsigned long long)hash);
+	return name;
+}
+
+bool LoadCache::lookup(const std::string& filenameandpath, DuplicatePolicy duplicates, TimeSeriesTransformations* t, FileVersion* version, bool headerRequired)
+{
+	uint64_t sourceSize = 0;
+	int64_t sourceModified = 0;
+	std::string file = sidecarName(filenameandpath, duplicates);
+	std::string sidecar = _directory + "/" + file;
+	bool known = fileStatus(filenameandpath, &sourceSize, &sourceModified);
+	if (version != nullptr)
+	{
+		version->known = known;
+		version->size = sourceSize;
+		version->modified = sourceModified;
+	}
+	if (!known || !std::ifstream(sidecar).good())
+	{
+		return false;
+	}
+
+	// another process may have removed the sidecar meanwhile.
+	MappedFile map;
+	try
+	{
+		map = MappedFile(sidecar);
+	}
+	catch (const std::runtime_error&)
+	{
+		return false;
+	}
+	const char* data = map.data();
+	SidecarHeader header;
+	size_t offset = readHeader(data, map.size(), &header);
+
+	// a sidecar of another version of the file (or of another file with the same hash) is not used, and is replaced by the next store.
+	if (offset == 0 || header.sourceSize != sourceSize || header.sourceModified != sourceModified
+		|| header.duplicates != (uint32_t)duplicates || header.path != filenameandpath)
+	{
+		return false;
+	}
+
+	// the file constructor refuses a file without a header, which load reads; it must not get such a file from a sidecar load stored.
+	if (headerRequired && header.hasHeader == 0)
+	{
+		return false;
+	}
+
+	const int32_t* times = reinterpret_cast<const int32_t*>(data + offset);
+	const double* prices = reinterpret_cast<const double*>(data + offset + roundUpTo8(header.rows * sizeof(int32_t)));
+	t->_data.resize(header.rows);
+	for (size_t i = 0; i < header.rows; i++)
+	{
+		t->_data[i] = { times[i], prices[i] };
+	}
+	t->_name = header.name;
+	t->_separator = (char)header.separator;
+	t->_duplicatePolicy = duplicates;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	touch(file, map.size());
+	return true;
+}
+
+void LoadCache::store(const std::string& filenameandpath, DuplicatePolicy duplicates, const FileVersion& version, const TimeSeriesTransformations& t,
+	bool hasHeader)
+{
+	// the rows were parsed from the version seen before parsing; if the file changed since, they may not match either version.
+	uint64_t sourceSize;
+	int64_t sourceModified;
+	if (!version.known || !fileStatus(filenameandpath, &sourceSize, &sourceModified) || sourceSize != version.size || sourceModified != version.modified)
+	{
+		return;
+	}
+
+	const std::vector<std::pair<int, double>>& data = t._data;
+	std::vector<int32_t> times(data.size());
+	std::vector<double> prices(data.size());
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		times[i] = data[i].first;
+		prices[i] = data[i].second;
+	}
+
+	std::string buffer(sidecarMagic, sizeof(sidecarMagic));
+	uint32_t policy = (uint32_t)duplicates;
+	uint32_t separator = (unsigned char)t._separator;
+	uint32_t header = (hasHeader ? 1 : 0);
+	buffer.append(reinterpret_cast<const char*>(&sourceSize), 8);
+	buffer.append(reinterpret_cast<const char*>(&sourceModified), 8);
+	buffer.append(reinterpret_cast<const char*>(&policy), 4);
+	buffer.append(reinterpret_cast<const char*>(&separator), 4);
+	appendBytes(buffer, &header, 4);
+	appendString(buffer, filenameandpath);
+	appendString(buffer, t._name);
+	uint64_t rows = data.size();
+	buffer.append(reinterpret_cast<const char*>(&rows), 8);
+	appendBytes(buffer, times.data(), times.size() * sizeof(int32_t));
+	appendBytes(buffer, prices.data(), prices.size() * sizeof(double));
+	if (buffer.size() > _sizeLimit)
+	{
+		return;
+	}
+
+	// the sidecar is written aside and renamed, so that a reader never sees it half written. The temporary file is named after the
+	// process and a counter, so that several threads or processes storing the same file at once never write the same one.
+	std::string file = sidecarName(filenameandpath, duplicates);
+	std::string sidecar = _directory + "/" + file;
+	std::string temporary = sidecar + "." + std::to_string((long long)getpid()) + "." + std::to_string(temporaryCount++) + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary);
+		out.write(buffer.data(), buffer.size());
+		if (!out.good())
+		{
+			out.close();
+			std::remove(temporary.c_str());
+			return;
+		}
+	}
+#ifdef _WIN32
+	std::remove(sidecar.c_str());
+#endif
+	if (std::rename(temporary.c_str(), sidecar.c_str()) != 0)
+	{
+		std::remove(temporary.c_str());
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	touch(file, buffer.size());
+}
+
+void LoadCache::touch(const std::string& file, uint64_t bytes)
+{
+	auto entry = std::find_if(_entries.begin(), _entries.end(), [&file](const Entry& e) { return e.file == file; });
+	if (entry == _entries.end())
+	{
+		_entries.push_back({ file, bytes, ++_clock });
+	}
+	else
+	{
+		entry->bytes = bytes;
+		entry->lastUsed = ++_clock;
+	}
+	evict();
+	writeIndex();
+}
+
+// the sidecar just used is the most recent one, so it is the last to go.
+void LoadCache::evict()
+{
+	uint64_t total = 0;
+	for (const Entry& entry : _entries)
+	{
+		total += entry.bytes;
+	}
+	while (total > _sizeLimit && _entries.size() > 1)
+	{
+		auto oldest = std::min_element(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+		std::remove((_directory + "/" + oldest->file).c_str());
+		total -= oldest->bytes;
+		_entries.erase(oldest);
+	}
+}
+
+void LoadCache::writeIndex() const
+{
+	std::ofstream index(_directory + "/" + indexName);
+	for (const Entry& entry : _entries)
+	{
+		index << entry.file << ',' << entry.bytes << ',' << entry.lastUsed << '\n';
+	}
+}
+
+size_t LoadCache::entryCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entries.size();
+}
+
+uint64_t LoadCache::size()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	uint64_t total = 0;
+	for (const Entry& entry : _entries)
+	{
+		total += entry.bytes;
+	}
+	return total;
+}
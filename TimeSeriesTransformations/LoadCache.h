@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include "TimeSeriesTransformations.h"
+
+// cache of parsed files, used by the file constructor and by load once it is set with TimeSeriesTransformations::setLoadCache.
+// the first load of a file stores the parsed series in a binary sidecar file of the cache directory, named after a hash of the path.
+// the sidecar records the path, size and modification time of the source file, whether it had a header and the duplicate policy of
+// the load; a later load of the same file with the same policy maps the sidecar and copies its columns instead of parsing, rounding and
+// sorting the file again, as long as the source has not changed. Beyond the size limit the least recently used sidecars are removed.
+// the sidecars are written aside and then renamed, so that several processes may share a cache directory; the usage index
+// (cache.csv) is only kept exact for the processes using the same LoadCache object.
+class LoadCache
+{
+
+private:
+    struct Entry
+    {
+        std::string file;
+        uint64_t bytes;
+        uint64_t lastUsed;
+    };
+
+    std::string _directory;
+    uint64_t _sizeLimit;
+
+    // the sidecars of the cache, with their sizes and a counter telling when they were last used.
+    std::vector<Entry> _entries{};
+    uint64_t _clock = 0;
+    std::mutex _mutex;
+
+    // name of the sidecar of a source file loaded with the given policy.
+    static std::string sidecarName(const std::string& filenameandpath, DuplicatePolicy duplicates);
+
+    // marks a sidecar as the most recently used one, removes the least recently used ones beyond the size limit and saves the index.
+    void touch(const std::string& file, uint64_t bytes);
+    void evict();
+    void writeIndex() const;
+
+public:
+
+    // size and modification time of a source file, as seen by lookup before the file is parsed (known is false if it could not be read).
+    struct FileVersion
+    {
+        bool known = false;
+        uint64_t size = 0;
+        int64_t modified = 0;
+    };
+
+    // opens (or creates) a cache in the given directory. sizeLimit is the total size of the sidecars kept.
+    explicit LoadCache(const std::string& directory, uint64_t sizeLimit = uint64_t(1) << 30);
+
+    LoadCache(const LoadCache&) = delete;
+    LoadCache& operator=(const LoadCache&) = delete;
+
+    // copies the series cached for the file into t and returns true, if there is one for this duplicate policy and the file is unchanged.
+    // the version of the file seen is written to version (if not null), to be given to store once the file is parsed. With headerRequired,
+    // a sidecar of a file without a header is not used (the file constructor refuses such a file).
+    bool lookup(const std::string& filenameandpath, DuplicatePolicy duplicates, TimeSeriesTransformations* t, FileVersion* version = nullptr,
+        bool headerRequired = false);
+
+    // stores the series parsed from the file, recorded as made from the given version of it, with or without a header. Nothing is stored if
+    // the file changed since (it may have been written while it was parsed), or if the series is larger than the size limit on its own.
+    void store(const std::string& filenameandpath, DuplicatePolicy duplicates, const FileVersion& version, const TimeSeriesTransformations& t,
+        bool hasHeader);
+
+    // number of sidecars and their total size in bytes.
+    size_t entryCount();
+    uint64_t size();
+
+};
@@ -0,0 +1,140 @@
+// MappedFile.cpp : read-only memory maps of files.
+#include <stdexcept>
+#include <utility>
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filenameandpath)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filenameandpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Could not open file.");
+	}
+	_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		close();
+		throw std::runtime_error("Could not open file.");
+	}
+	_size = (size_t)size.QuadPart;
+
+	// an empty file cannot be mapped, and has nothing to map anyway.
+	if (_size > 0)
+	{
+		_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		_data = (_mapping == nullptr ? nullptr : static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)));
+		if (_data == nullptr)
+		{
+			close();
+			throw std::runtime_error("Could not open file.");
+		}
+	}
+#else
+	_descriptor = open(filenameandpath.c_str(), O_RDONLY);
+	if (_descriptor < 0)
+	{
+		throw std::runtime_error("Could not open file.");
+	}
+
+	struct stat status;
+	if (fstat(_descriptor, &status) != 0)
+	{
+		close();
+		throw std::runtime_error("Could not open file.");
+	}
+	_size = (size_t)status.st_size;
+
+	if (_size > 0)
+	{
+		void* address = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _descriptor, 0);
+		if (address == MAP_FAILED)
+		{
+			close();
+			throw std::runtime_error("Could not open file.");
+		}
+		_data = static_cast<const char*>(address);
+	}
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (_data != nullptr)
+	{
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping != nullptr)
+	{
+		CloseHandle(_mapping);
+	}
+	if (_file != nullptr)
+	{
+		CloseHandle(_file);
+	}
+	_mapping = nullptr;
+	_file = nullptr;
+#else
+	if (_data != nullptr)
+	{
+		munmap(const_cast<char*>(_data), _size);
+	}
+	if (_descriptor >= 0)
+	{
+		::close(_descriptor);
+	}
+	_descriptor = -1;
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		std::swap(_data, other._data);
+		std::swap(_size, other._size);
+#ifdef _WIN32
+		std::swap(_file, other._file);
+		std::swap(_mapping, other._mapping);
+#else
+		std::swap(_descriptor, other._descriptor);
+#endif
+	}
+	return *this;
+}
+
+const char* MappedFile::data() const
+{
+	return _data;
+}
+
+size_t MappedFile::size() const
+{
+	return _size;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// read-only memory map of a whole file (mmap on POSIX systems, MapViewOfFile on Windows).
+// the pages are only read from the disk when they are touched, so reading a small part of a large file costs only that part.
+class MappedFile
+{
+
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#else
+    int _descriptor = -1;
+#endif
+
+    // unmaps and closes the file.
+    void close();
+
+public:
+
+    // an empty map.
+    MappedFile() = default;
+
+    // maps the given file. Throws std::runtime_error("Could not open file.") if it cannot be opened or mapped.
+    explicit MappedFile(const std::string& filenameandpath);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // first byte of the file (null for an empty file).
+    const char* data() const;
+
+    // size of the file in bytes.
+    size_t size() const;
+
+};
@@ -0,0 +1,173 @@
+// OutlierFilter.cpp : streaming rejection of bad ticks.
+#include <algorithm>
+#include <cmath>
+#include "OutlierFilter.h"
+
+OutlierFilter OutlierFilter::zScore(double threshold, size_t warmup)
+{
+	OutlierFilter filter;
+	filter._method = Method::ZScore;
+	filter._threshold = threshold;
+	filter._warmup = std::max<size_t>(warmup, 2);
+	return filter;
+}
+
+OutlierFilter OutlierFilter::rollingMAD(size_t window, double threshold)
+{
+	OutlierFilter filter;
+	filter._method = Method::RollingMAD;
+	filter._threshold = threshold;
+	filter._window = std::max<size_t>(window, 3);
+
+	// the median of fewer than half a window of prices is too noisy to judge by.
+	filter._warmup = std::max<size_t>(filter._window / 2, 3);
+	return filter;
+}
+
+OutlierFilter OutlierFilter::incrementSpike(double threshold, size_t warmup)
+{
+	OutlierFilter filter;
+	filter._method = Method::IncrementSpike;
+	filter._threshold = threshold;
+	filter._warmup = std::max<size_t>(warmup, 3);
+	return filter;
+}
+
+// Welford update of the running moments.
+void OutlierFilter::addMoment(double value)
+{
+	_count++;
+	double delta = value - _mean;
+	_mean += delta / _count;
+	_m2 += delta * (value - _mean);
+}
+
+// the window is kept sorted, so the median is read directly and the MAD is found by walking outwards from the median, taking the
+// nearest of the two neighbours each time: the k-th step gives the k-th smallest absolute deviation, in O(window).
+bool OutlierFilter::acceptRolling(double price)
+{
+	size_t n = _sorted.size();
+	bool keep = true;
+	if (n >= _warmup)
+	{
+		double median = (n % 2 == 1 ? _sorted[n / 2] : (_sorted[n / 2 - 1] + _sorted[n / 2]) / 2);
+
+		size_t right = std::lower_bound(_sorted.begin(), _sorted.end(), median) - _sorted.begin();
+		size_t left = right;
+		double lower = 0, upper = 0;
+		for (size_t k = 0; k <= n / 2; k++)
+		{
+			double deviation;
+			if (left > 0 && (right == n || median - _sorted[left - 1] <= _sorted[right] - median))
+			{
+				deviation = median - _sorted[--left];
+			}
+			else
+			{
+				deviation = _sorted[right++] - median;
+			}
+			lower = upper;
+			upper = deviation;
+		}
+		double mad = (n % 2 == 1 ? upper : (lower + upper) / 2);
+
+		// a flat window has no scale to compare with, so nothing is rejected until the prices move.
+		keep = (mad == 0 || std::abs(price - median) <= _threshold * 1.4826 * mad);
+	}
+
+	// every price enters the window, rejected or not, so that the median follows a lasting change of level.
+	_sorted.insert(std::upper_bound(_sorted.begin(), _sorted.end(), price), price);
+	_recent.push_back(price);
+	if (_recent.size() > _window)
+	{
+		_sorted.erase(std::lower_bound(_sorted.begin(), _sorted.end(), _recent.front()));
+		_recent.pop_front();
+	}
+	return keep;
+}
+
+bool OutlierFilter::accept(double price)
+{
+	bool keep = true;
+	switch (_method)
+	{
+	case Method::None:
+		break;
+
+	case Method::ZScore:
+		if (_seen >= _warmup && _count > 1)
+		{
+			double sd = std::sqrt(_m2 / (_count - 1));
+			keep = (std::abs(price - _mean) <= _threshold * sd);
+		}
+		if (keep)
+		{
+			addMoment(price);
+		}
+		break;
+
+	case Method::RollingMAD:
+		keep = acceptRolling(price);
+		break;
+
+	case Method::IncrementSpike:
+		if (_seen > 0)
+		{
+			double increment = price - _lastAccepted;
+			if (_seen >= _warmup && _count > 1)
+			{
+				double limit = _threshold * std::sqrt(_m2 / (_count - 1));
+				keep = (std::abs(increment - _mean) <= limit);
+
+				// a level shift is kept, but its jump is left out of the increment statistics.
+				if (!keep && _previousRejected && std::abs(price - _previousPrice - _mean) <= limit)
+				{
+					keep = true;
+					increment = price - _previousPrice;
+				}
+			}
+			if (keep)
+			{
+				addMoment(increment);
+			}
+		}
+		_previousRejected = !keep;
+		_previousPrice = price;
+		if (keep)
+		{
+			_lastAccepted = price;
+		}
+		break;
+	}
+
+	_seen++;
+	if (!keep)
+	{
+		_rejected++;
+	}
+	return keep;
+}
+
+void OutlierFilter::reset()
+{
+	_seen = 0;
+	_rejected = 0;
+	_count = 0;
+	_mean = 0;
+	_m2 = 0;
+	_lastAccepted = 0;
+	_previousRejected = false;
+	_previousPrice = 0;
+	_recent.clear();
+	_sorted.clear();
+}
+
+OutlierFilter::Method OutlierFilter::method() const
+{
+	return _method;
+}
+
+size_t OutlierFilter::rejected() const
+{
+	return _rejected;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+// streaming filter of bad ticks, which decides on each price as it arrives from the prices accepted (or seen) before it.
+// it is used by TimeSeriesTransformations::load to drop bad rows before they are stored, and by removeOutliersMAD on a series in memory.
+// the methods are:
+//   ZScore          rejects a price more than threshold running standard deviations away from the running mean of the accepted prices.
+//   RollingMAD      rejects a price more than threshold * 1.4826 * MAD away from the median of the last "window" prices (a Hampel filter).
+//   IncrementSpike  rejects a price whose increment from the last accepted price is more than threshold running standard deviations of
+//                   the accepted increments. When the price after a rejected one is close to it, the move was a level shift and not a
+//                   spike, so that price is accepted (only the first price of a lasting jump is lost).
+// the first "warmup" prices are always accepted, as the statistics need some values before they mean anything.
+class OutlierFilter
+{
+
+public:
+    enum class Method { None, ZScore, RollingMAD, IncrementSpike };
+
+private:
+    Method _method = Method::None;
+    double _threshold = 0;
+    size_t _window = 0;
+    size_t _warmup = 0;
+
+    // number of prices seen and rejected.
+    size_t _seen = 0;
+    size_t _rejected = 0;
+
+    // running count, mean and sum of squared differences of the accepted prices (ZScore) or increments (IncrementSpike).
+    double _count = 0;
+    double _mean = 0;
+    double _m2 = 0;
+
+    // last accepted price, and the price rejected just before the current one (IncrementSpike).
+    double _lastAccepted = 0;
+    bool _previousRejected = false;
+    double _previousPrice = 0;
+
+    // the last "window" prices in arrival order and in increasing order (RollingMAD).
+    std::deque<double> _recent{};
+    std::vector<double> _sorted{};
+
+    void addMoment(double value);
+
+    // decision of the rolling filter for a price, before the price enters the window.
+    bool acceptRolling(double price);
+
+public:
+
+    // a filter that accepts everything.
+    OutlierFilter() = default;
+
+    // the three kinds of filters.
+    static OutlierFilter zScore(double threshold, size_t warmup = 30);
+    static OutlierFilter rollingMAD(size_t window, double threshold);
+    static OutlierFilter incrementSpike(double threshold, size_t warmup = 30);
+
+    // true if the price is kept. Prices have to be given in time order.
+    bool accept(double price);
+
+    // forgets the prices seen so far (the settings are kept).
+    void reset();
+
+    Method method() const;
+
+    // number of prices rejected since the filter was created or reset.
+    size_t rejected() const;
+
+};
@@ -0,0 +1,391 @@
+// PartitionedStore.cpp : series stored as one binary file per day or month.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "PartitionedStore.h"
+#include "MappedFile.h"
+#include "TimeSeriesTransformations.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+const char* const PartitionedStore::manifestName = "manifest.csv";
+
+namespace
+{
+	const char partitionMagic[8] = { 'T', 'S', 'T', 'P', 'A', 'R', 'T', '1' };
+
+	// size of the magic and of the number of rows.
+	const size_t partitionHeaderSize = 16;
+
+	// offset of the prices in a partition file of the given number of rows (the times are padded to 8 bytes).
+	size_t pricesOffset(size_t rows)
+	{
+		return partitionHeaderSize + (rows * sizeof(int32_t) + 7) / 8 * 8;
+	}
+
+	// UTC calendar date of a number of days since 1970-01-01 (H. Hinnant's civil_from_days), which unlike gmtime works for any time.
+	void civilFromDays(long long z, int* year, int* month, int* day)
+	{
+		z += 719468;
+		long long era = (z >= 0 ? z : z - 146096) / 146097;
+		long long doe = z - era * 146097;
+		long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		long long mp = (5 * doy + 2) / 153;
+		*day = (int)(doy - (153 * mp + 2) / 5 + 1);
+		*month = (int)(mp < 10 ? mp + 3 : mp - 9);
+		*year = (int)(yoe + era * 400 + (*month <= 2 ? 1 : 0));
+	}
+
+	// UTC day of a UNIX time, as days since 1970-01-01 (rounded down for times before the epoch).
+	long long daysSinceEpoch(int unix)
+	{
+		return ((long long)unix - (unix < 0 ? 86399 : 0)) / 86400;
+	}
+
+	// file name of the partition holding a UTC day (YYYY-MM-DD.tsp) or month (YYYY-MM.tsp), given as days since the epoch.
+	std::string partitionFile(long long days, PartitionPeriod period)
+	{
+		int year, month, day;
+		civilFromDays(days, &year, &month, &day);
+		char name[32];
+		if (period == PartitionPeriod::Day)
+		{
+			snprintf(name, sizeof(name), "%04d-%02d-%02d.tsp", year, month, day);
+		}
+		else
+		{
+			snprintf(name, sizeof(name), "%04d-%02d.tsp", year, month);
+		}
+		return name;
+	}
+
+	// key of the partition holding a UNIX time: days since the epoch, or months since year 0.
+	long long partitionKey(int unix, PartitionPeriod period)
+	{
+		long long days = daysSinceEpoch(unix);
+		if (period == PartitionPeriod::Day)
+		{
+			return days;
+		}
+		int year, month, day;
+		civilFromDays(days, &year, &month, &day);
+		return (long long)year * 12 + month - 1;
+	}
+
+	// replaces a file by a complete temporary one, so that a reader sees either the old file or the new one.
+	void replaceFile(const std::string& temporary, const std::string& path)
+	{
+#ifdef _WIN32
+		std::remove(path.c_str());
+#endif
+		if (std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+			throw std::runtime_error("Could not write file.");
+		}
+	}
+
+	// a mapped partition file and the columns inside it.
+	struct PartitionView
+	{
+		MappedFile file;
+		const int32_t* times = nullptr;
+		const double* prices = nullptr;
+		size_t rows = 0;
+	};
+
+	// maps a partition file and checks its header and size against the manifest.
+	PartitionView openPartition(const std::string& path, size_t rows)
+	{
+		PartitionView view;
+		view.file = MappedFile(path);
+		const char* data = view.file.data();
+
+		uint64_t stored = 0;
+		if (view.file.size() >= partitionHeaderSize)
+		{
+			memcpy(&stored, data + sizeof(partitionMagic), sizeof(stored));
+		}
+		if (view.file.size() < partitionHeaderSize || memcmp(data, partitionMagic, sizeof(partitionMagic)) != 0 || stored != rows
+			|| view.file.size() != pricesOffset(rows) + rows * sizeof(double))
+		{
+			throw std::runtime_error("Corrupt partition file.");
+		}
+
+		// the map is page aligned, and the columns start at multiples of 8 bytes.
+		view.times = reinterpret_cast<const int32_t*>(data + partitionHeaderSize);
+		view.prices = reinterpret_cast<const double*>(data + pricesOffset(rows));
+		view.rows = rows;
+		return view;
+	}
+}
+
+void PartitionedStore::write(const TimeSeriesTransformations& t, const std::string& directory, PartitionPeriod period)
+{
+	const std::vector<std::pair<int, double>>& data = t._data;
+
+	// the directory is created if needed (an existing one is fine).
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	// the partitions of the store already there, whose files are removed at the end if the new store does not use them.
+	std::vector<std::string> oldFiles;
+	try
+	{
+		for (const Partition& partition : PartitionedStore(directory)._partitions)
+		{
+			oldFiles.push_back(partition.file);
+		}
+	}
+	catch (const std::runtime_error&)
+	{
+		// no store (or an unreadable one): nothing to clean up.
+	}
+
+	std::stringstream manifest;
+	manifest << "name," << t._name << '\n';
+	manifest << "period," << (period == PartitionPeriod::Day ? "day" : "month") << '\n';
+
+	// the data is sorted, so each partition is a run of consecutive rows. The partitions are written before the manifest, so that the
+	// manifest never lists a partition that is not there yet.
+	std::vector<std::string> files;
+	size_t begin = 0;
+	while (begin < data.size())
+	{
+		long long key = partitionKey(data[begin].first, period);
+		size_t end = begin + 1;
+		while (end < data.size() && partitionKey(data[end].first, period) == key)
+		{
+			end++;
+		}
+		size_t rows = end - begin;
+
+		std::string file = partitionFile(daysSinceEpoch(data[begin].first), period);
+		std::string path = directory + "/" + file;
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream out(temporary, std::ios::binary);
+			if (!out.is_open())
+			{
+				throw std::runtime_error("Could not open file.");
+			}
+
+			// the columns are written in one go each from a copy of the rows.
+			std::vector<int32_t> times(rows);
+			std::vector<double> prices(rows);
+			for (size_t i = 0; i < rows; i++)
+			{
+				times[i] = data[begin + i].first;
+				prices[i] = data[begin + i].second;
+			}
+			uint64_t storedRows = rows;
+			const char padding[8] = {};
+			out.write(partitionMagic, sizeof(partitionMagic));
+			out.write(reinterpret_cast<const char*>(&storedRows), sizeof(storedRows));
+			out.write(reinterpret_cast<const char*>(times.data()), rows * sizeof(int32_t));
+			out.write(padding, pricesOffset(rows) - partitionHeaderSize - rows * sizeof(int32_t));
+			out.write(reinterpret_cast<const char*>(prices.data()), rows * sizeof(double));
+			if (!out.good())
+			{
+				out.close();
+				std::remove(temporary.c_str());
+				throw std::runtime_error("Could not write file.");
+			}
+		}
+		replaceFile(temporary, path);
+
+		manifest << file << ',' << data[begin].first << ',' << data[end - 1].first << ',' << rows << '\n';
+		files.push_back(file);
+		begin = end;
+	}
+
+	// the manifest is written aside and renamed over the old one, so that it is never read half written.
+	std::string manifestPath = directory + "/" + manifestName;
+	std::string temporary = manifestPath + ".tmp";
+	{
+		std::ofstream out(temporary);
+		if (!out.is_open())
+		{
+			throw std::runtime_error("Could not open file.");
+		}
+		out << manifest.str();
+		if (!out.good())
+		{
+			out.close();
+			std::remove(temporary.c_str());
+			throw std::runtime_error("Could not write file.");
+		}
+	}
+	replaceFile(temporary, manifestPath);
+
+	// the partitions of the old store that the new one does not list. Only names of partition files are removed, whatever the old
+	// manifest holds.
+	for (const std::string& file : oldFiles)
+	{
+		bool partitionName = file.size() > 4 && file.compare(file.size() - 4, 4, ".tsp") == 0 && file.find_first_of("/\\") == std::string::npos;
+		if (partitionName && std::find(files.begin(), files.end(), file) == files.end())
+		{
+			std::remove((directory + "/" + file).c_str());
+		}
+	}
+}
+
+PartitionedStore::PartitionedStore(const std::string& directory)
+	: _directory(directory)
+{
+	std::ifstream manifest(directory + "/" + manifestName);
+	if (!manifest.is_open())
+	{
+		throw std::runtime_error("Could not open file.");
+	}
+
+	std::string line;
+	while (getline(manifest, line))
+	{
+		std::stringstream ss(line);
+		std::string field;
+		getline(ss, field, ',');
+		if (field == "name")
+		{
+			getline(ss, _name);
+		}
+		else if (field == "period")
+		{
+			getline(ss, field);
+			_period = (field == "month" ? PartitionPeriod::Month : PartitionPeriod::Day);
+		}
+		else if (!field.empty())
+		{
+			Partition partition;
+			partition.file = field;
+			char comma;
+			long long rows;
+			if (!(ss >> partition.firstTime >> comma >> partition.lastTime >> comma >> rows) || rows < 0)
+			{
+				throw std::runtime_error("Corrupt manifest.");
+			}
+			partition.rows = (size_t)rows;
+			_partitions.push_back(partition);
+		}
+	}
+}
+
+void PartitionedStore::overlapping(int from, int to, size_t* first, size_t* last) const
+{
+	// the partitions are disjoint and ordered, so their last times are increasing and their first times too.
+	*first = std::lower_bound(_partitions.begin(), _partitions.end(), from, [](const Partition& p, int unix) { return p.lastTime < unix; }) - _partitions.begin();
+	*last = std::upper_bound(_partitions.begin(), _partitions.end(), to, [](int unix, const Partition& p) { return unix < p.firstTime; }) - _partitions.begin();
+	if (from > to || *last < *first)
+	{
+		*last = *first;
+	}
+}
+
+TimeSeriesTransformations PartitionedStore::load() const
+{
+	if (_partitions.empty())
+	{
+		TimeSeriesTransformations t;
+		t._name = _name;
+		t._separator = ',';
+		return t;
+	}
+	return loadBetween(_partitions.front().firstTime, _partitions.back().lastTime);
+}
+
+TimeSeriesTransformations PartitionedStore::loadBetween(int from, int to) const
+{
+	TimeSeriesTransformations t;
+	t._name = _name;
+	t._separator = ',';
+
+	size_t first, last;
+	overlapping(from, to, &first, &last);
+
+	size_t rows = 0;
+	for (size_t p = first; p < last; p++)
+	{
+		rows += _partitions[p].rows;
+	}
+	t._data.reserve(rows);
+
+	for (size_t p = first; p < last; p++)
+	{
+		PartitionView view = openPartition(_directory + "/" + _partitions[p].file, _partitions[p].rows);
+
+		// only the partitions at the edges of the range are cut, by binary search on their times.
+		size_t begin = std::lower_bound(view.times, view.times + view.rows, from) - view.times;
+		size_t end = std::upper_bound(view.times, view.times + view.rows, to) - view.times;
+		for (size_t i = begin; i < end; i++)
+		{
+			t._data.push_back({ view.times[i], view.prices[i] });
+		}
+	}
+	return t;
+}
+
+size_t PartitionedStore::countBetween(int from, int to) const
+{
+	size_t first, last;
+	overlapping(from, to, &first, &last);
+
+	size_t count = 0;
+	for (size_t p = first; p < last; p++)
+	{
+		const Partition& partition = _partitions[p];
+		if (from <= partition.firstTime && partition.lastTime <= to)
+		{
+			count += partition.rows;
+		}
+		else
+		{
+			PartitionView view = openPartition(_directory + "/" + partition.file, partition.rows);
+			count += (std::upper_bound(view.times, view.times + view.rows, to) - view.times) - (std::lower_bound(view.times, view.times + view.rows, from) - view.times);
+		}
+	}
+	return count;
+}
+
+size_t PartitionedStore::partitionCount() const
+{
+	return _partitions.size();
+}
+
+size_t PartitionedStore::partitionsBetween(int from, int to) const
+{
+	size_t first, last;
+	overlapping(from, to, &first, &last);
+	return last - first;
+}
+
+size_t PartitionedStore::count() const
+{
+	size_t count = 0;
+	for (const Partition& partition : _partitions)
+	{
+		count += partition.rows;
+	}
+	return count;
+}
+
+std::string PartitionedStore::getName() const
+{
+	return _name;
+}
+
+PartitionPeriod PartitionedStore::period() const
+{
+	return _period;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class TimeSeriesTransformations;
+
+// length of the partitions of a PartitionedStore (UTC days or UTC calendar months).
+enum class PartitionPeriod { Day, Month };
+
+// on-disk store of a series split by time into one binary file per day or per month, plus a manifest with the time bounds and
+// row count of every partition. A time range is loaded by memory-mapping only the partitions that overlap it, so looking at one
+// week of a long history reads about one week of data.
+// a partition file holds the magic "TSTPART1", the number of rows (8 bytes), the times (4 bytes each, padded to 8 bytes) and then
+// the prices (8 bytes each), so that the times can be binary searched in the mapped file.
+class PartitionedStore
+{
+
+private:
+    // a partition as described in the manifest.
+    struct Partition
+    {
+        std::string file;   // file name, relative to the directory of the store.
+        int firstTime;      // first and last time of the partition.
+        int lastTime;
+        size_t rows;        // number of rows of the partition.
+    };
+
+    std::string _directory{};
+    std::string _name{};
+    PartitionPeriod _period = PartitionPeriod::Day;
+
+    // the partitions, ordered by time.
+    std::vector<Partition> _partitions{};
+
+    // indexes [first, last) of the partitions that overlap [from, to].
+    void overlapping(int from, int to, size_t* first, size_t* last) const;
+
+public:
+
+    // name of the manifest file in the directory of a store.
+    static const char* const manifestName;
+
+    // writes a series as a store in a directory (created if needed), replacing any store already there: the partitions are written
+    // first, then the manifest is renamed over the old one, and the partition files of the old store that the new one does not use are
+    // removed. Throws std::runtime_error if a file cannot be written.
+    static void write(const TimeSeriesTransformations& t, const std::string& directory, PartitionPeriod period = PartitionPeriod::Day);
+
+    // opens the store of a directory by reading its manifest. Throws std::runtime_error if the manifest cannot be read.
+    explicit PartitionedStore(const std::string& directory);
+
+    // loads the whole series.
+    TimeSeriesTransformations load() const;
+
+    // loads the prices with from <= time <= to, opening only the partitions that overlap the range.
+    TimeSeriesTransformations loadBetween(int from, int to) const;
+
+    // number of prices with from <= time <= to. Only the partitions at the edges of the range are opened.
+    size_t countBetween(int from, int to) const;
+
+    // number of partitions, and number of partitions overlapping [from, to].
+    size_t partitionCount() const;
+    size_t partitionsBetween(int from, int to) const;
+
+    // total number of prices.
+    size_t count() const;
+
+    // name of the stored series.
+    std::string getName() const;
+
+    PartitionPeriod period() const;
+
+};
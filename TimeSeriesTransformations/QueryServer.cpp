@@ -0,0 +1,544 @@
+// QueryServer.cpp : server answering queries on series kept in memory, over a Unix domain socket.
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "QueryServer.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	// ids of the listener and of the eventfd in epoll; the clients are numbered from 2.
+	const uint64_t listenerId = 0;
+	const uint64_t wakeId = 1;
+
+	// a client sending a line longer than this is dropped.
+	const size_t maxRequestSize = size_t(1) << 20;
+
+	// a client is no longer read while this much of its input is waiting for a worker, or this much of its answers for room to be
+	// written; a worker is handed at most maxBatchSize bytes of requests at a time (or a single longer request).
+	const size_t maxInputSize = size_t(4) << 20;
+	const size_t maxOutputSize = size_t(4) << 20;
+	const size_t maxBatchSize = size_t(64) << 10;
+
+	// the local midnight of the calendar day after a date, read as convertToUnix reads dates. mktime carries day 32 into the next month,
+	// so the end of a day is found without assuming that it lasts 86400 seconds, which it does not on the days the clocks change.
+	int nextMidnight(const std::string& date)
+	{
+		int year = 0, month = 0, day = 0;
+		sscanf(date.c_str(), "%d-%d-%d", &year, &month, &day);
+		return TimeSeriesTransformations::convertToUnix(std::to_string(year) + "-" + std::to_string(month) + "-" + std::to_string(day + 1));
+	}
+
+	const char* statusName(Status status)
+	{
+		switch (status)
+		{
+		case Status::EmptySeries: return "EmptySeries";
+		case Status::NotEnoughPrices: return "NotEnoughPrices";
+		case Status::InvalidDate: return "InvalidDate";
+		case Status::DateNotFound: return "DateNotFound";
+		case Status::NothingRemoved: return "NothingRemoved";
+		case Status::InvalidArgument: return "InvalidArgument";
+		default: return "Ok";
+		}
+	}
+
+	// writes a number after a space, with enough digits to read back the same double.
+	void appendNumber(std::string& answer, double value)
+	{
+		if (std::isnan(value))
+		{
+			answer += " nan";
+			return;
+		}
+		char digits[32];
+		snprintf(digits, sizeof(digits), " %.17g", value);
+		answer += digits;
+	}
+
+	// the rest of a request after the words already read, without the spaces around it.
+	std::string remainder(std::istringstream& ss)
+	{
+		std::string rest;
+		getline(ss, rest);
+		size_t first = rest.find_first_not_of(' ');
+		size_t last = rest.find_last_not_of(' ');
+		return (first == std::string::npos ? std::string() : rest.substr(first, last - first + 1));
+	}
+}
+
+QueryServer::QueryServer(const std::string& socketPath, unsigned workers) : _path(socketPath), _workers(workers)
+{
+}
+
+QueryServer::~QueryServer()
+{
+	stop();
+}
+
+void QueryServer::add(const std::string& name, TimeSeriesTransformations series)
+{
+	// the indexes are built before the series is shared, so that the workers never build them at the same time.
+	auto served = std::make_shared<TimeSeriesTransformations>(std::move(series));
+	served->buildRangeIndex();
+
+	std::lock_guard<std::mutex> lock(_seriesMutex);
+	_series[name] = std::move(served);
+}
+
+bool QueryServer::remove(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(_seriesMutex);
+	return _series.erase(name) > 0;
+}
+
+std::shared_ptr<const TimeSeriesTransformations> QueryServer::find(const std::string& name) const
+{
+	std::lock_guard<std::mutex> lock(_seriesMutex);
+	auto series = _series.find(name);
+	return (series == _series.end() ? nullptr : series->second);
+}
+
+std::string QueryServer::query(const std::string& request) const
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	std::istringstream ss(request);
+	std::string command, name;
+	ss >> command;
+
+	if (command == "LIST")
+	{
+		std::lock_guard<std::mutex> lock(_seriesMutex);
+		std::string answer = "OK " + std::to_string(_series.size());
+		for (const auto& series : _series)
+		{
+			answer += ' ' + series.first;
+		}
+		return answer;
+	}
+	if (command != "STATS" && command != "PRICE" && command != "RANGE" && command != "DAY")
+	{
+		return "ERR UnknownCommand";
+	}
+
+	ss >> name;
+	std::shared_ptr<const TimeSeriesTransformations> t = find(name);
+	if (!t)
+	{
+		return "ERR UnknownSeries";
+	}
+
+	std::string answer = "OK";
+	if (command == "STATS")
+	{
+		answer += ' ' + std::to_string(t->count());
+		appendNumber(answer, t->tryMean().valueOr(nan));
+		appendNumber(answer, t->tryStandardDeviation().valueOr(nan));
+		appendNumber(answer, t->tryIncrementMean().valueOr(nan));
+		appendNumber(answer, t->tryIncrementStandardDeviation().valueOr(nan));
+	}
+	else if (command == "PRICE")
+	{
+		Result<double> price = t->tryGetPriceAtDate(remainder(ss));
+		if (!price)
+		{
+			return std::string("ERR ") + statusName(price.error());
+		}
+		appendNumber(answer, *price);
+	}
+	else if (command == "RANGE")
+	{
+		int from = 0, to = 0;
+		if (!(ss >> from >> to))
+		{
+			return "ERR InvalidRange";
+		}
+
+		// the range functions leave the values untouched when the range holds no price.
+		double mean = nan, standardDeviation = nan, min = nan, max = nan;
+		t->meanBetween(from, to, &mean);
+		t->standardDeviationBetween(from, to, &standardDeviation);
+		t->minBetween(from, to, &min);
+		t->maxBetween(from, to, &max);
+		answer += ' ' + std::to_string(t->countBetween(from, to));
+		appendNumber(answer, mean);
+		appendNumber(answer, standardDeviation);
+		appendNumber(answer, min);
+		appendNumber(answer, max);
+	}
+	else
+	{
+		std::string date = remainder(ss);
+		if (!TimeSeriesTransformations::isValidDate(date))
+		{
+			return "ERR InvalidDate";
+		}
+
+		// the prices from the local midnight of the date to that of the next day, found by binary search.
+		int end = nextMidnight(date);
+		int start = TimeSeriesTransformations::truncDate(date);
+		auto byTime = [](const std::pair<int, double>& pair, int time) { return pair.first < time; };
+		auto first = std::lower_bound(t->_data.begin(), t->_data.end(), start, byTime);
+		auto last = std::lower_bound(first, t->_data.end(), end, byTime);
+		answer += ' ' + std::to_string(last - first);
+		for (auto element = first; element != last; ++element)
+		{
+			appendNumber(answer, element->second);
+		}
+	}
+	return answer;
+}
+
+#ifdef __linux__
+
+void QueryServer::start()
+{
+	if (_running)
+	{
+		return;
+	}
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (_path.empty() || _path.size() >= sizeof(address.sun_path))
+	{
+		throw std::runtime_error("Could not open socket.");
+	}
+	memcpy(address.sun_path, _path.c_str(), _path.size());
+
+	// a socket file left by a server that did not stop cleanly would make bind fail; anything else at the path is left alone.
+	struct stat status;
+	if (lstat(_path.c_str(), &status) == 0)
+	{
+		if (!S_ISSOCK(status.st_mode))
+		{
+			throw std::runtime_error("Could not open socket.");
+		}
+		unlink(_path.c_str());
+	}
+	_listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+	_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	epoll_event listenerEvent{}, wakeEvent{};
+	listenerEvent.events = EPOLLIN;
+	listenerEvent.data.u64 = listenerId;
+	wakeEvent.events = EPOLLIN;
+	wakeEvent.data.u64 = wakeId;
+	if (_listener < 0 || _epoll < 0 || _wake < 0
+		|| bind(_listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(_listener, SOMAXCONN) != 0
+		|| epoll_ctl(_epoll, EPOLL_CTL_ADD, _listener, &listenerEvent) != 0 || epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &wakeEvent) != 0)
+	{
+		for (int* descriptor : { &_listener, &_epoll, &_wake })
+		{
+			if (*descriptor >= 0)
+			{
+				close(*descriptor);
+			}
+			*descriptor = -1;
+		}
+		throw std::runtime_error("Could not open socket.");
+	}
+
+	_pool.reset(new ThreadPool(_workers));
+	_running = true;
+	_loop = std::thread(&QueryServer::run, this);
+}
+
+void QueryServer::stop()
+{
+	if (!_running.exchange(false))
+	{
+		return;
+	}
+	uint64_t one = 1;
+	(void)!write(_wake, &one, sizeof(one));
+	_loop.join();
+
+	// the workers finish the requests they hold before the eventfd they signal is closed; their answers are dropped.
+	_pool.reset();
+	for (auto& connection : _connections)
+	{
+		close(connection.second.socket);
+	}
+	_connections.clear();
+	_answers.clear();
+	close(_listener);
+	close(_epoll);
+	close(_wake);
+	_listener = _epoll = _wake = -1;
+	unlink(_path.c_str());
+}
+
+void QueryServer::run()
+{
+	epoll_event events[64];
+	while (_running)
+	{
+		int ready = epoll_wait(_epoll, events, 64, -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		for (int i = 0; i < ready && _running; i++)
+		{
+			uint64_t id = events[i].data.u64;
+			if (id == listenerId)
+			{
+				acceptClients();
+			}
+			else if (id == wakeId)
+			{
+				uint64_t count;
+				(void)!read(_wake, &count, sizeof(count));
+				deliverAnswers();
+			}
+			else
+			{
+				// a client closed earlier in this batch may still have events in it.
+				if (_connections.count(id) > 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+				{
+					readClient(id);
+				}
+				if (_connections.count(id) > 0 && (events[i].events & EPOLLOUT))
+				{
+					writeClient(id);
+				}
+			}
+		}
+	}
+}
+
+void QueryServer::acceptClients()
+{
+	for (;;)
+	{
+		int client = accept4(_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client < 0)
+		{
+			return;
+		}
+		uint64_t id = _nextConnection++;
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u64 = id;
+		if (epoll_ctl(_epoll, EPOLL_CTL_ADD, client, &event) != 0)
+		{
+			close(client);
+			continue;
+		}
+		_connections[id] = Connection{ client, std::string(), std::string(), false, true, false, false };
+	}
+}
+
+void QueryServer::readClient(uint64_t id)
+{
+	Connection& connection = _connections[id];
+	char buffer[65536];
+	while (connection.input.size() < maxInputSize)
+	{
+		ssize_t received = recv(connection.socket, buffer, sizeof(buffer), 0);
+		if (received > 0)
+		{
+			connection.input.append(buffer, (size_t)received);
+			continue;
+		}
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			break;
+		}
+		if (received < 0)
+		{
+			closeClient(id);
+			return;
+		}
+
+		// the client sent all its requests: the last one may lack its line break, and the answers are still written.
+		if (!connection.input.empty() && connection.input.back() != '\n')
+		{
+			connection.input += '\n';
+		}
+		connection.finished = true;
+		break;
+	}
+
+	// the bytes after the last line break are a request still being sent.
+	if (connection.input.size() - (connection.input.rfind('\n') + 1) > maxRequestSize)
+	{
+		closeClient(id);
+		return;
+	}
+	dispatch(id);
+	writeClient(id);
+}
+
+void QueryServer::writeClient(uint64_t id)
+{
+	Connection& connection = _connections[id];
+	size_t written = 0;
+	while (written < connection.output.size())
+	{
+		ssize_t sent = send(connection.socket, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+		if (sent > 0)
+		{
+			written += (size_t)sent;
+			continue;
+		}
+		if (sent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			break;
+		}
+		closeClient(id);
+		return;
+	}
+	connection.output.erase(0, written);
+
+	// the requests held back while the answers were over their limit are handed over once they are written.
+	dispatch(id);
+	if (connection.finished && !connection.busy && connection.output.empty())
+	{
+		closeClient(id);
+		return;
+	}
+	watchClient(id);
+}
+
+void QueryServer::watchClient(uint64_t id)
+{
+	// a client that shut down its side would always be readable, so it is no longer watched for reading. The socket is watched for
+	// room to write only while some answer is left to write.
+	Connection& connection = _connections[id];
+	bool reading = !connection.finished && connection.input.size() < maxInputSize && connection.output.size() < maxOutputSize;
+	bool writing = !connection.output.empty();
+	if (reading == connection.reading && writing == connection.writing)
+	{
+		return;
+	}
+	connection.reading = reading;
+	connection.writing = writing;
+	epoll_event event{};
+	event.events = (reading ? (uint32_t)EPOLLIN : 0u) | (writing ? (uint32_t)EPOLLOUT : 0u);
+	event.data.u64 = id;
+	epoll_ctl(_epoll, EPOLL_CTL_MOD, connection.socket, &event);
+}
+
+void QueryServer::closeClient(uint64_t id)
+{
+	auto connection = _connections.find(id);
+	epoll_ctl(_epoll, EPOLL_CTL_DEL, connection->second.socket, nullptr);
+	close(connection->second.socket);
+	_connections.erase(connection);
+}
+
+void QueryServer::dispatch(uint64_t id)
+{
+	// a client has at most one batch of requests with the workers at a time, so that its answers come back in order, and none while
+	// its answers are over their limit.
+	Connection& connection = _connections[id];
+	if (connection.busy || connection.output.size() >= maxOutputSize)
+	{
+		return;
+	}
+	size_t end = connection.input.rfind('\n', maxBatchSize);
+	if (end == std::string::npos)
+	{
+		end = connection.input.find('\n');
+	}
+	if (end == std::string::npos)
+	{
+		return;
+	}
+	std::string requests = connection.input.substr(0, end + 1);
+	connection.input.erase(0, end + 1);
+	connection.busy = true;
+
+	_pool->submit([this, id, requests]()
+	{
+		std::string answers;
+		size_t begin = 0;
+		for (size_t lineEnd = requests.find('\n'); lineEnd != std::string::npos; begin = lineEnd + 1, lineEnd = requests.find('\n', begin))
+		{
+			size_t length = lineEnd - begin;
+			if (length > 0 && requests[lineEnd - 1] == '\r')
+			{
+				length--;
+			}
+			try
+			{
+				answers += query(requests.substr(begin, length));
+			}
+			catch (const std::exception&)
+			{
+				answers += "ERR Internal";
+			}
+			answers += '\n';
+		}
+		{
+			std::lock_guard<std::mutex> lock(_answersMutex);
+			_answers.emplace_back(id, std::move(answers));
+		}
+		uint64_t one = 1;
+		(void)!write(_wake, &one, sizeof(one));
+	});
+}
+
+void QueryServer::deliverAnswers()
+{
+	std::vector<std::pair<uint64_t, std::string>> answers;
+	{
+		std::lock_guard<std::mutex> lock(_answersMutex);
+		answers.swap(_answers);
+	}
+	for (auto& answer : answers)
+	{
+		if (_connections.count(answer.first) == 0)
+		{
+			continue;
+		}
+		Connection& connection = _connections[answer.first];
+		connection.output += answer.second;
+		connection.busy = false;
+
+		// the requests that arrived while the worker was busy are handed over by writeClient.
+		writeClient(answer.first);
+	}
+}
+
+#else
+
+void QueryServer::start()
+{
+	throw std::runtime_error("The query server needs epoll (Linux).");
+}
+
+void QueryServer::stop()
+{
+}
+
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include "TimeSeriesTransformations.h"
+#include "ThreadPool.h"
+
+// server keeping a set of named series in memory and answering queries on them over a Unix domain socket, so that a script asks for
+// the statistics it needs instead of loading the files again. The protocol is made of lines: each request is a line, and each answer is
+// a line starting with "OK" followed by the values separated by spaces, or "ERR" followed by the reason. Requests:
+//   LIST                          the names of the series: OK count name...
+//   STATS name                    OK count mean standardDeviation incrementMean incrementStandardDeviation
+//   PRICE name Y-M-D H:M:S        the price at a date: OK price
+//   RANGE name from to            the prices at the unix times from to to (both included): OK count mean standardDeviation min max
+//   DAY name Y-M-D                the prices of a day, in time order: OK count price...
+// the dates are read as convertToUnix reads them, in the local time of the server, so that PRICE and DAY agree with the dates the series
+// was built from: a day runs from its local midnight to the local midnight of the next calendar day. printSharePricesOnDate takes the
+// day of each time in UTC (as convertToDate does), so it gives the same prices as DAY when the server runs in UTC. The values that
+// cannot be computed (such as the increments of a single price) are written nan. A client may send several requests without waiting; the answers come back in the
+// same order.
+// a single thread waits on the sockets with epoll, reads the requests and writes the answers; the requests are answered on a pool of
+// workers. The series are indexed when they are added, so that the range queries only read them. The socket needs Linux.
+class QueryServer
+{
+
+private:
+    // a client: the bytes read and not answered yet, the answers not written yet, whether its requests are with a worker, whether
+    // the socket is watched for reading and for room to write, and whether the client shut down its side (it is closed once answered).
+    struct Connection
+    {
+        int socket;
+        std::string input;
+        std::string output;
+        bool busy;
+        bool reading;
+        bool writing;
+        bool finished;
+    };
+
+    std::string _path;
+    unsigned _workers;
+
+    // the series served, which are never changed once added (a series added again under the same name replaces the old one).
+    mutable std::mutex _seriesMutex;
+    std::map<std::string, std::shared_ptr<const TimeSeriesTransformations>> _series{};
+
+    // the listening socket, the epoll instance and the eventfd waking the event loop when answers are ready or the server stops.
+    int _listener = -1;
+    int _epoll = -1;
+    int _wake = -1;
+
+    std::unique_ptr<ThreadPool> _pool{};
+    std::thread _loop{};
+    std::atomic<bool> _running{ false };
+
+    // the answers computed by the workers, by connection, waiting for the event loop to write them.
+    std::mutex _answersMutex;
+    std::vector<std::pair<uint64_t, std::string>> _answers{};
+
+    // the clients, owned by the event loop thread and known by a number (0 and 1 stand for the listener and the eventfd in epoll).
+    std::unordered_map<uint64_t, Connection> _connections{};
+    uint64_t _nextConnection = 2;
+
+    // the series of a given name, or nullptr.
+    std::shared_ptr<const TimeSeriesTransformations> find(const std::string& name) const;
+
+    // run by the event loop thread.
+    void run();
+    void acceptClients();
+    void readClient(uint64_t id);
+    void writeClient(uint64_t id);
+    void closeClient(uint64_t id);
+
+    // sets the events epoll watches for a client from its state: it is not read while its input or its unwritten answers are over
+    // their limits, so that a client sending requests without reading the answers is slowed down instead of filling the memory.
+    void watchClient(uint64_t id);
+
+    // hands the complete requests of an idle client to a worker.
+    void dispatch(uint64_t id);
+
+    // appends the answers of the workers to the output of their clients.
+    void deliverAnswers();
+
+public:
+
+    // a server listening on socketPath once started, answering with the given number of workers.
+    explicit QueryServer(const std::string& socketPath, unsigned workers = std::thread::hardware_concurrency());
+
+    // stops the server.
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // serves a series under a name (from any thread, before or after start).
+    void add(const std::string& name, TimeSeriesTransformations series);
+
+    // stops serving a series. Returns false if there is none of that name.
+    bool remove(const std::string& name);
+
+    // creates the socket (replacing a socket file left at its path) and starts answering.
+    // throws std::runtime_error("Could not open socket.") if it cannot be created or if something other than a socket is at its path,
+    // and std::runtime_error on systems without epoll.
+    void start();
+
+    // closes the clients and the socket, and removes the socket file. Does nothing if the server is not running.
+    void stop();
+
+    // the answer to a request line (without the line break), as sent to a client.
+    std::string query(const std::string& request) const;
+
+};
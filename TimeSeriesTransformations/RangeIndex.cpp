@@ -0,0 +1,115 @@
+// RangeIndex.cpp : prefix sums for constant-time statistics over ranges of a series.
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "RangeIndex.h"
+
+namespace
+{
+	// adds a value to the unevaluated sum high + low without losing its low-order bits (Knuth's two-sum).
+	void addCompensated(double& high, double& low, double value)
+	{
+		double sum = high + value;
+		double rounded = sum - high;
+		low += (high - (sum - rounded)) + (value - rounded);
+		high = sum;
+	}
+}
+
+void RangeIndex::Column::clear()
+{
+	reference = 0;
+	sumHigh = sumLow = squareHigh = squareLow = 0;
+	sumHighs.assign(1, 0.0);
+	sumLows.assign(1, 0.0);
+	squareHighs.assign(1, 0.0);
+	squareLows.assign(1, 0.0);
+}
+
+void RangeIndex::Column::add(double value)
+{
+	double centred = value - reference;
+	addCompensated(sumHigh, sumLow, centred);
+	addCompensated(squareHigh, squareLow, centred * centred);
+	sumHighs.push_back(sumHigh);
+	sumLows.push_back(sumLow);
+	squareHighs.push_back(squareHigh);
+	squareLows.push_back(squareLow);
+}
+
+// the sums of the range are differences of prefix sums, high and low parts apart. The variance is then (sum of squares - n * mean^2) / (n - 1)
+// relative to the reference, which loses accuracy only when the range is far from the reference compared to its spread.
+bool RangeIndex::Column::moments(size_t begin, size_t end, double* meanValue, double* standardDeviationValue) const
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	if (end <= begin)
+	{
+		*meanValue = nan;
+		*standardDeviationValue = nan;
+		return false;
+	}
+
+	double n = (double)(end - begin);
+	double sum = (sumHighs[end] - sumHighs[begin]) + (sumLows[end] - sumLows[begin]);
+	double squares = (squareHighs[end] - squareHighs[begin]) + (squareLows[end] - squareLows[begin]);
+	*meanValue = reference + sum / n;
+	*standardDeviationValue = (end - begin < 2 ? nan : std::sqrt(std::max(squares - sum * sum / n, 0.0) / (n - 1)));
+	return true;
+}
+
+bool RangeIndex::built() const
+{
+	return _built;
+}
+
+void RangeIndex::build(const std::vector<std::pair<int, double>>& data)
+{
+	_prices.clear();
+	_increments.clear();
+	_prices.sumHighs.reserve(data.size() + 1);
+	_prices.sumLows.reserve(data.size() + 1);
+	_prices.squareHighs.reserve(data.size() + 1);
+	_prices.squareLows.reserve(data.size() + 1);
+	_built = true;
+	append(data, 0);
+}
+
+void RangeIndex::append(const std::vector<std::pair<int, double>>& data, size_t from)
+{
+	if (!_built)
+	{
+		return;
+	}
+
+	for (size_t i = from; i < data.size(); i++)
+	{
+		if (i == 0)
+		{
+			// the prices are summed relative to the first one; the increments are small already.
+			_prices.reference = data[0].second;
+		}
+		else
+		{
+			_increments.add(data[i].second - data[i - 1].second);
+		}
+		_prices.add(data[i].second);
+	}
+}
+
+void RangeIndex::clear()
+{
+	_prices = Column();
+	_increments = Column();
+	_built = false;
+}
+
+bool RangeIndex::priceMoments(size_t begin, size_t end, double* meanValue, double* standardDeviationValue) const
+{
+	return _prices.moments(begin, end, meanValue, standardDeviationValue);
+}
+
+// increment i is price i + 1 minus price i, so the prices begin to end - 1 hold the increments begin to end - 2.
+bool RangeIndex::incrementMoments(size_t begin, size_t end, double* meanValue, double* standardDeviationValue) const
+{
+	return _increments.moments(begin, std::max(end, begin + 1) - 1, meanValue, standardDeviationValue);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// prefix sums of the prices and of the increments of a series, and of their squares, so that the mean and standard deviation of any
+// run of consecutive prices take a constant time. Each prefix sum is kept as an unevaluated sum high + low (compensated summation),
+// so that the difference of two prefix sums far apart in a long series stays accurate. The prices are summed relative to the first
+// price of the series, which keeps the squares small and limits the cancellation when the variance is derived from them.
+class RangeIndex
+{
+
+private:
+    // prefix sums of one column of values: entry i sums the first i values.
+    struct Column
+    {
+        double reference = 0;
+        double sumHigh = 0;
+        double sumLow = 0;
+        double squareHigh = 0;
+        double squareLow = 0;
+        std::vector<double> sumHighs{};
+        std::vector<double> sumLows{};
+        std::vector<double> squareHighs{};
+        std::vector<double> squareLows{};
+
+        void clear();
+        void add(double value);
+
+        // mean and sample standard deviation of the values begin to end - 1. Returns false, with both set to NaN, if there are none
+        // (the standard deviation of a single value is NaN).
+        bool moments(size_t begin, size_t end, double* meanValue, double* standardDeviationValue) const;
+    };
+
+    Column _prices{};
+    Column _increments{};
+    bool _built = false;
+
+public:
+
+    // true once the index was built, and until it is cleared.
+    bool built() const;
+
+    // indexes all the prices of a series.
+    void build(const std::vector<std::pair<int, double>>& data);
+
+    // indexes the prices data[from] onwards, added at the end of the series since it was last indexed (does nothing if it is not built).
+    void append(const std::vector<std::pair<int, double>>& data, size_t from);
+
+    // drops the index and frees its memory.
+    void clear();
+
+    // mean and sample standard deviation of the prices begin to end - 1, as for Column::moments.
+    bool priceMoments(size_t begin, size_t end, double* meanValue, double* standardDeviationValue) const;
+
+    // mean and sample standard deviation of the increments between the prices begin to end - 1.
+    bool incrementMoments(size_t begin, size_t end, double* meanValue, double* standardDeviationValue) const;
+
+};
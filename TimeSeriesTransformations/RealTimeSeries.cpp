@@ -0,0 +1,296 @@
+// RealTimeSeries.cpp : lock-free ingestion of live ticks into a TimeSeriesTransformations object.
+#include <algorithm>
+#include "RealTimeSeries.h"
+
+const size_t RealTimeSeries::chunkRows;
+
+RealTimeSeries::RealTimeSeries(const TimeSeriesTransformations& initial, size_t capacity, std::chrono::milliseconds publishInterval, size_t batchSize)
+	: _series(initial), _batchSize(std::max<size_t>(batchSize, 1)), _publishInterval(publishInterval)
+{
+	// round the capacity up to a power of two so that the cell of a position is a mask away.
+	size_t size = 2;
+	while (size < capacity)
+	{
+		size *= 2;
+	}
+	_mask = size - 1;
+
+	// cell i is first free for the producer of position i.
+	_slots.reset(new Slot[size]);
+	for (size_t i = 0; i < size; i++)
+	{
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	publish();
+	_epoch = 0;
+	_merger = std::thread(&RealTimeSeries::merge, this);
+}
+
+RealTimeSeries::~RealTimeSeries()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_wake.notify_all();
+	_merger.join();
+}
+
+bool RealTimeSeries::push(int unix, double price)
+{
+	if (!enqueue(unix, price))
+	{
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+void RealTimeSeries::pushOrWait(int unix, double price)
+{
+	while (!enqueue(unix, price))
+	{
+		// the merger may be idle between two polls: it is woken (through the mutex, so that the wake-up cannot be lost) to drain the ring.
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+		}
+		_wake.notify_all();
+		std::this_thread::yield();
+	}
+}
+
+uint64_t RealTimeSeries::dropped() const
+{
+	return _dropped.load(std::memory_order_relaxed);
+}
+
+// bounded multi-producer queue (D. Vyukov): a producer claims a position with a compare-and-swap, writes the tick in its cell
+// and then releases the cell by advancing its sequence, which is what the merger waits for.
+bool RealTimeSeries::enqueue(int unix, double price)
+{
+	size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+	Slot* slot;
+	while (true)
+	{
+		slot = &_slots[position & _mask];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+		if (difference == 0)
+		{
+			// the cell is free for this position: try to claim it.
+			if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// the cell still holds a tick from one lap ago: the ring is full.
+			return false;
+		}
+		else
+		{
+			// another producer took this position.
+			position = _enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->time = unix;
+	slot->price = price;
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+// only the merger thread pops, so the read position needs no synchronisation.
+bool RealTimeSeries::pop(std::pair<int, double>* tick)
+{
+	Slot& slot = _slots[_dequeuePosition & _mask];
+	if (slot.sequence.load(std::memory_order_acquire) != _dequeuePosition + 1)
+	{
+		// empty, or the producer of this position has not finished writing.
+		return false;
+	}
+
+	*tick = { slot.time, slot.price };
+
+	// the cell becomes free for the producer of the same cell on the next lap.
+	slot.sequence.store(_dequeuePosition + _mask + 1, std::memory_order_release);
+	_dequeuePosition++;
+	return true;
+}
+
+void RealTimeSeries::mergeBatch(std::vector<std::pair<int, double>>& batch)
+{
+	// the rows from the first one at or after the oldest tick on may move or change; the chunks holding them are unsealed.
+	int oldest = std::min_element(batch.begin(), batch.end())->first;
+	size_t changed = std::lower_bound(_series._data.begin(), _series._data.end(), oldest,
+		[](const std::pair<int, double>& pair, int time) { return pair.first < time; }) - _series._data.begin();
+	_series.insertPrices(batch);
+	_sealed.resize(std::min(_sealed.size(), changed / chunkRows));
+}
+
+void RealTimeSeries::publish()
+{
+	const std::vector<std::pair<int, double>>& data = _series._data;
+	while ((_sealed.size() + 1) * chunkRows <= data.size())
+	{
+		auto begin = data.begin() + _sealed.size() * chunkRows;
+		_sealed.push_back(std::make_shared<const Chunk>(begin, begin + chunkRows));
+	}
+
+	// the snapshot shares the sealed chunks and copies the rows after them, and what describes the series apart from its rows.
+	auto snapshot = std::make_shared<Snapshot>();
+	snapshot->_chunks = _sealed;
+	if (data.size() > _sealed.size() * chunkRows)
+	{
+		snapshot->_chunks.push_back(std::make_shared<const Chunk>(data.begin() + _sealed.size() * chunkRows, data.end()));
+	}
+	snapshot->_count = data.size();
+	auto header = std::make_shared<TimeSeriesTransformations>();
+	header->_name = _series._name;
+	header->_separator = _series._separator;
+	header->_duplicatePolicy = _series._duplicatePolicy;
+	header->_sketchesEnabled = _series._sketchesEnabled;
+	if (_series._sketchesEnabled)
+	{
+		header->_priceSketch = _series._priceSketch;
+		header->_incrementSketch = _series._incrementSketch;
+	}
+	snapshot->_header = std::move(header);
+
+	std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_publishedPosition = _dequeuePosition;
+		_epoch++;
+	}
+	_published.notify_all();
+}
+
+// the merger drains the ring in batches. Each batch is sorted and merged into the series, which is an append for ticks that arrive
+// in time order. A snapshot is published once the publish interval has passed since the last one, or straight away on flush.
+void RealTimeSeries::merge()
+{
+	std::vector<std::pair<int, double>> batch;
+	batch.reserve(_batchSize);
+	auto lastPublish = std::chrono::steady_clock::now();
+	bool pending = false;
+
+	while (true)
+	{
+		std::pair<int, double> tick;
+		while (batch.size() < _batchSize && pop(&tick))
+		{
+			batch.push_back(tick);
+		}
+
+		if (!batch.empty())
+		{
+			mergeBatch(batch);
+			batch.clear();
+			pending = true;
+		}
+
+		bool running, flushRequested;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			running = _running;
+			flushRequested = _flushRequested;
+			_flushRequested = false;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (pending && (flushRequested || !running || now - lastPublish >= _publishInterval))
+		{
+			publish();
+			lastPublish = now;
+			pending = false;
+		}
+		else if (flushRequested)
+		{
+			// nothing new to publish, but the caller of flush may still be waiting for ticks that are not visible yet.
+			_published.notify_all();
+		}
+
+		// keep merging while the ring has ticks; stop once it is drained after the destructor was called.
+		if (_slots[_dequeuePosition & _mask].sequence.load(std::memory_order_acquire) == _dequeuePosition + 1)
+		{
+			continue;
+		}
+		if (!running && _enqueuePosition.load() == _dequeuePosition)
+		{
+			return;
+		}
+
+		// the producers never block on the merger, so it polls the ring when idle.
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wake.wait_for(lock, std::chrono::milliseconds(1), [this]()
+		{
+			return _flushRequested || !_running || _slots[_dequeuePosition & _mask].sequence.load(std::memory_order_acquire) == _dequeuePosition + 1;
+		});
+	}
+}
+
+std::shared_ptr<const RealTimeSeries::Snapshot> RealTimeSeries::view() const
+{
+	return std::atomic_load(&_snapshot);
+}
+
+std::shared_ptr<const TimeSeriesTransformations> RealTimeSeries::snapshot() const
+{
+	return view()->series();
+}
+
+std::shared_ptr<const TimeSeriesTransformations> RealTimeSeries::materialize(const Snapshot& snapshot)
+{
+	auto series = std::make_shared<TimeSeriesTransformations>(*snapshot._header);
+	series->_data.reserve(snapshot._count);
+	for (const std::shared_ptr<const Chunk>& chunk : snapshot._chunks)
+	{
+		series->_data.insert(series->_data.end(), chunk->begin(), chunk->end());
+	}
+	return series;
+}
+
+size_t RealTimeSeries::Snapshot::count() const
+{
+	return _count;
+}
+
+const std::pair<int, double>& RealTimeSeries::Snapshot::row(size_t position) const
+{
+	// every chunk but the last one is full.
+	return (*_chunks[position / chunkRows])[position % chunkRows];
+}
+
+const std::vector<std::shared_ptr<const RealTimeSeries::Chunk>>& RealTimeSeries::Snapshot::chunks() const
+{
+	return _chunks;
+}
+
+std::shared_ptr<const TimeSeriesTransformations> RealTimeSeries::Snapshot::series() const
+{
+	std::call_once(_materialized, [this]() { _series = RealTimeSeries::materialize(*this); });
+	return _series;
+}
+
+uint64_t RealTimeSeries::epoch() const
+{
+	return _epoch;
+}
+
+void RealTimeSeries::flush()
+{
+	// every position claimed before now has to be merged and published.
+	size_t target = _enqueuePosition.load();
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (_publishedPosition < target)
+	{
+		_flushRequested = true;
+		_wake.notify_all();
+		_published.wait_for(lock, std::chrono::milliseconds(1));
+	}
+}
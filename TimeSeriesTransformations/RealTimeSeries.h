@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "TimeSeriesTransformations.h"
+
+// a TimeSeriesTransformations object fed with live ticks.
+// producers push (time, price) ticks into a bounded lock-free ring buffer (any number of producer threads). A background merger
+// thread takes the ticks off the ring in batches, merges them into its own copy of the series and regularly publishes an immutable
+// snapshot of it. Readers take the latest snapshot without blocking the producers or the merger, and keep using it for as long as they
+// hold it (the old snapshots are freed when their last reader lets them go).
+// a snapshot does not copy the series: its rows are cut into chunks of chunkRows rows that are sealed once full and shared by all the
+// later snapshots, so that publishing only copies the rows after the last full chunk. A tick older than a sealed chunk unseals the
+// chunks from its position on, which are sealed again from the series.
+class RealTimeSeries
+{
+
+public:
+    class Snapshot;
+
+    // rows of a snapshot, and the number of rows of a sealed chunk.
+    typedef std::vector<std::pair<int, double>> Chunk;
+    static const size_t chunkRows = size_t(1) << 14;
+
+private:
+    // a cell of the ring. sequence tells whether the cell is free for the producer of a given position or holds the tick of that position.
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        int time;
+        double price;
+    };
+
+    // the ring itself and the mask giving the cell of a position (the capacity is a power of two).
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+
+    // next position to be claimed by a producer, and next position to be read by the merger.
+    std::atomic<size_t> _enqueuePosition{ 0 };
+    size_t _dequeuePosition = 0;
+
+    // the series owned by the merger thread, and the full chunks of its rows sealed so far.
+    TimeSeriesTransformations _series;
+    std::vector<std::shared_ptr<const Chunk>> _sealed{};
+
+    // the latest published snapshot (read and written with the atomic shared_ptr functions).
+    std::shared_ptr<const Snapshot> _snapshot;
+
+    // number of ticks dropped by push because the ring was full.
+    std::atomic<uint64_t> _dropped{ 0 };
+
+    // number of ticks included in the latest snapshot, and number of snapshots published.
+    std::atomic<size_t> _publishedPosition{ 0 };
+    std::atomic<uint64_t> _epoch{ 0 };
+
+    // largest number of ticks merged at once, and the longest time a merged tick waits before being published.
+    size_t _batchSize;
+    std::chrono::milliseconds _publishInterval;
+
+    // wakes the merger (on flush and on destruction) and tells the callers of flush that a snapshot was published.
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _published;
+    bool _running = true;
+    bool _flushRequested = false;
+
+    std::thread _merger;
+
+    // puts a tick on the ring. Returns false if the ring is full.
+    bool enqueue(int unix, double price);
+
+    // takes one tick off the ring, if there is one ready.
+    bool pop(std::pair<int, double>* tick);
+
+    // loop run by the merger thread.
+    void merge();
+
+    // merges a batch of ticks into the series and unseals the chunks it changed.
+    void mergeBatch(std::vector<std::pair<int, double>>& batch);
+
+    // seals the full chunks of the series and publishes them, with a copy of the rows after them, as the new snapshot.
+    void publish();
+
+    // the series made of the rows of a snapshot (called once per snapshot, by Snapshot::series).
+    static std::shared_ptr<const TimeSeriesTransformations> materialize(const Snapshot& snapshot);
+
+public:
+
+    // starts a real-time series from the given initial data. The capacity of the ring is rounded up to a power of two.
+    explicit RealTimeSeries(const TimeSeriesTransformations& initial = TimeSeriesTransformations(), size_t capacity = size_t(1) << 16,
+        std::chrono::milliseconds publishInterval = std::chrono::milliseconds(10), size_t batchSize = size_t(1) << 16);
+
+    // merges and publishes the ticks still in the ring, then stops the merger.
+    ~RealTimeSeries();
+
+    RealTimeSeries(const RealTimeSeries&) = delete;
+    RealTimeSeries& operator=(const RealTimeSeries&) = delete;
+
+    // adds a tick without locking. Returns false (and drops the tick, which is counted by dropped) if the ring is full.
+    bool push(int unix, double price);
+
+    // same but waits for room in the ring instead of dropping the tick, so that the producers slow down to the pace of the merger.
+    void pushOrWait(int unix, double price);
+
+    // number of ticks dropped by push so far.
+    uint64_t dropped() const;
+
+    // the latest published snapshot, as shared chunks of rows (publishing one costs at most chunkRows rows whatever the size of the series).
+    std::shared_ptr<const Snapshot> view() const;
+
+    // the latest published snapshot as a series. The series is built from the chunks by the first call for a snapshot, in O(n), and
+    // shared by the later calls until the next snapshot is published.
+    std::shared_ptr<const TimeSeriesTransformations> snapshot() const;
+
+    // number of snapshots published so far.
+    uint64_t epoch() const;
+
+    // waits until every tick pushed before the call is part of a published snapshot.
+    void flush();
+
+};
+
+// an immutable snapshot of a real-time series: its rows in time order, in full chunks of RealTimeSeries::chunkRows rows followed by
+// the last rows, which may be fewer. Several threads may read a snapshot at once.
+class RealTimeSeries::Snapshot
+{
+
+private:
+    std::vector<std::shared_ptr<const Chunk>> _chunks{};
+    size_t _count = 0;
+
+    // the series without its rows (name, separator, duplicate policy and sketches), and the series with them once built.
+    std::shared_ptr<const TimeSeriesTransformations> _header{};
+    mutable std::once_flag _materialized{};
+    mutable std::shared_ptr<const TimeSeriesTransformations> _series{};
+
+    friend class RealTimeSeries;
+
+public:
+
+    // number of rows.
+    size_t count() const;
+
+    // the row at a position (time, price), position < count().
+    const std::pair<int, double>& row(size_t position) const;
+
+    // the chunks of rows, e.g. to go through them without building the series.
+    const std::vector<std::shared_ptr<const Chunk>>& chunks() const;
+
+    // the snapshot as a series, built by the first call (see RealTimeSeries::snapshot).
+    std::shared_ptr<const TimeSeriesTransformations> series() const;
+
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <utility>
+
+// outcome of the non-throwing functions of TimeSeriesTransformations (the try... functions).
+enum class Status
+{
+    Ok,
+    EmptySeries,        // the series holds no price.
+    NotEnoughPrices,    // the series holds too few prices for the result (e.g. no increment).
+    InvalidDate,        // the date given does not exist (e.g. 2021-02-30) or cannot be read.
+    DateNotFound,       // no price at the date given.
+    NothingRemoved,     // no price matched the removal.
+    InvalidArgument     // an argument is out of its range (e.g. a threshold that is not positive or a lag below 1).
+};
+
+// a value or the status telling why there is none, in the spirit of std::expected (which needs C++23).
+// ordinary failures are returned rather than thrown, and nothing is written to the console.
+template <typename T>
+class Result
+{
+
+private:
+    T _value{};
+    Status _status = Status::Ok;
+
+public:
+
+    // a successful result.
+    Result(T value) : _value(std::move(value)) {}
+
+    // a failed result.
+    Result(Status status) : _status(status) {}
+
+    // true if the result holds a value.
+    bool hasValue() const { return _status == Status::Ok; }
+    explicit operator bool() const { return hasValue(); }
+
+    // the value (only meaningful if hasValue()).
+    const T& value() const { return _value; }
+    const T& operator*() const { return _value; }
+    const T* operator->() const { return &_value; }
+
+    // the status (Status::Ok if the result holds a value).
+    Status error() const { return _status; }
+
+    // moves the value out, leaving the result empty-valued (a default T on failure), to avoid copying large vectors.
+    T take() { return std::move(_value); }
+
+    // the value, or the fallback if there is none.
+    T valueOr(T fallback) const { return hasValue() ? _value : fallback; }
+
+};
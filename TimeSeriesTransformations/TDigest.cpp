@@ -0,0 +1,223 @@
+// TDigest.cpp : mergeable quantile sketch.
+#include <algorithm>
+#include <limits>
+#include "TDigest.h"
+
+TDigest::TDigest(double compression)
+{
+	_compression = std::max(compression, 10.0);
+}
+
+void TDigest::add(double value, double weight)
+{
+	if (_totalWeight == 0)
+	{
+		_min = value;
+		_max = value;
+	}
+	else
+	{
+		_min = std::min(_min, value);
+		_max = std::max(_max, value);
+	}
+
+	_buffer.push_back({ value, weight });
+	_totalWeight += weight;
+
+	// the buffer is merged once it holds a few times as many values as there are centroids, so that sorting it stays cheap.
+	if (_buffer.size() >= (size_t)(5 * _compression))
+	{
+		compress();
+	}
+}
+
+void TDigest::merge(const TDigest& other)
+{
+	if (other._totalWeight == 0)
+	{
+		return;
+	}
+
+	double lowest = (_totalWeight == 0 ? other._min : std::min(_min, other._min));
+	double highest = (_totalWeight == 0 ? other._max : std::max(_max, other._max));
+
+	// the centroids of the other sketch are added as weighted values.
+	for (const Centroid& centroid : other._centroids)
+	{
+		add(centroid.mean, centroid.weight);
+	}
+	for (const Centroid& centroid : other._buffer)
+	{
+		add(centroid.mean, centroid.weight);
+	}
+	_min = lowest;
+	_max = highest;
+}
+
+// function that merges neighbouring centroids as long as the merged centroid stays below the size bound 4 * W * q * (1 - q) / compression,
+// where q is the fraction of the weight on its left. The bound is small near q = 0 and q = 1, which keeps the tails accurate.
+std::vector<TDigest::Centroid> TDigest::mergeCentroids(std::vector<Centroid>& sorted, double compression)
+{
+	std::vector<Centroid> result;
+	if (sorted.empty())
+	{
+		return result;
+	}
+
+	double total = 0;
+	for (const Centroid& centroid : sorted)
+	{
+		total += centroid.weight;
+	}
+
+	Centroid current = sorted[0];
+	double before = 0;
+	for (size_t i = 1; i < sorted.size(); i++)
+	{
+		double proposed = current.weight + sorted[i].weight;
+		double q0 = before / total;
+		double q2 = (before + proposed) / total;
+		double limit = 4 * total * std::min(q0 * (1 - q0), q2 * (1 - q2)) / compression;
+
+		if (proposed <= limit)
+		{
+			current.mean += (sorted[i].mean - current.mean) * sorted[i].weight / proposed;
+			current.weight = proposed;
+		}
+		else
+		{
+			result.push_back(current);
+			before += current.weight;
+			current = sorted[i];
+		}
+	}
+	result.push_back(current);
+	return result;
+}
+
+std::vector<TDigest::Centroid> TDigest::mergedCentroids() const
+{
+	if (_buffer.empty())
+	{
+		return _centroids;
+	}
+
+	std::vector<Centroid> all(_centroids);
+	all.insert(all.end(), _buffer.begin(), _buffer.end());
+	std::sort(all.begin(), all.end(), [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+	return mergeCentroids(all, _compression);
+}
+
+void TDigest::compress()
+{
+	if (!_buffer.empty())
+	{
+		_centroids = mergedCentroids();
+		_buffer.clear();
+	}
+}
+
+void TDigest::clear()
+{
+	_centroids.clear();
+	_buffer.clear();
+	_totalWeight = 0;
+	_min = 0;
+	_max = 0;
+}
+
+// the quantile is interpolated linearly between the centres of the two centroids around q * W, and between the extreme
+// centroids and the smallest and largest values at the tails.
+double TDigest::quantile(double q) const
+{
+	if (_totalWeight == 0)
+	{
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	q = std::min(std::max(q, 0.0), 1.0);
+
+	std::vector<Centroid> centroids = mergedCentroids();
+	double index = q * _totalWeight;
+
+	// left of the centre of the first centroid.
+	double half = centroids[0].weight / 2;
+	if (index <= half)
+	{
+		return _min + (half == 0 ? 0 : index / half) * (centroids[0].mean - _min);
+	}
+
+	// weight up to the centre of centroid i.
+	double cumulative = half;
+	for (size_t i = 0; i + 1 < centroids.size(); i++)
+	{
+		double step = (centroids[i].weight + centroids[i + 1].weight) / 2;
+		if (index <= cumulative + step)
+		{
+			return centroids[i].mean + (index - cumulative) / step * (centroids[i + 1].mean - centroids[i].mean);
+		}
+		cumulative += step;
+	}
+
+	// right of the centre of the last centroid.
+	half = centroids.back().weight / 2;
+	return centroids.back().mean + std::min(1.0, (index - cumulative) / half) * (_max - centroids.back().mean);
+}
+
+// inverse of quantile.
+double TDigest::cdf(double x) const
+{
+	if (_totalWeight == 0)
+	{
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	if (x < _min)
+	{
+		return 0;
+	}
+	if (x >= _max)
+	{
+		return 1;
+	}
+
+	std::vector<Centroid> centroids = mergedCentroids();
+
+	double half = centroids[0].weight / 2;
+	if (x < centroids[0].mean)
+	{
+		return half * (x - _min) / (centroids[0].mean - _min) / _totalWeight;
+	}
+
+	double cumulative = half;
+	for (size_t i = 0; i + 1 < centroids.size(); i++)
+	{
+		double step = (centroids[i].weight + centroids[i + 1].weight) / 2;
+		if (x < centroids[i + 1].mean)
+		{
+			return (cumulative + step * (x - centroids[i].mean) / (centroids[i + 1].mean - centroids[i].mean)) / _totalWeight;
+		}
+		cumulative += step;
+	}
+
+	half = centroids.back().weight / 2;
+	return (cumulative + half * (x - centroids.back().mean) / (_max - centroids.back().mean)) / _totalWeight;
+}
+
+double TDigest::count() const
+{
+	return _totalWeight;
+}
+
+size_t TDigest::centroidCount() const
+{
+	return mergedCentroids().size();
+}
+
+double TDigest::min() const
+{
+	return _min;
+}
+
+double TDigest::max() const
+{
+	return _max;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// mergeable sketch of a distribution (merging t-digest, Dunning & Ertl).
+// values are summarised by at most a few times "compression" centroids, which are small near the tails, so that extreme quantiles
+// such as p1 and p99 stay accurate. Adding a value and asking for a quantile take a time that depends on the compression only.
+class TDigest
+{
+
+private:
+    // a cluster of values summarised by their mean and their number.
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    // the merged centroids, ordered by mean.
+    std::vector<Centroid> _centroids{};
+
+    // values added since the last merge.
+    std::vector<Centroid> _buffer{};
+
+    // controls the number of centroids (and so the accuracy and the size of the sketch).
+    double _compression = 100;
+
+    // total weight of the centroids and of the buffer.
+    double _totalWeight = 0;
+
+    // smallest and largest values seen.
+    double _min = 0;
+    double _max = 0;
+
+    // merges the given centroids (sorted by mean) into as few centroids as the size bound allows.
+    static std::vector<Centroid> mergeCentroids(std::vector<Centroid>& sorted, double compression);
+
+    // the centroids including those still in the buffer.
+    std::vector<Centroid> mergedCentroids() const;
+
+public:
+
+    // creates an empty sketch. A larger compression gives more accurate quantiles and a larger sketch.
+    explicit TDigest(double compression = 100);
+
+    // adds a value with the given weight.
+    void add(double value, double weight = 1);
+
+    // adds all the values summarised by another sketch.
+    void merge(const TDigest& other);
+
+    // merges the buffered values into the centroids.
+    void compress();
+
+    // removes all the values.
+    void clear();
+
+    // the value below which a fraction q of the values lie (NaN if the sketch is empty).
+    double quantile(double q) const;
+
+    // the fraction of the values that are lower or equal to x (NaN if the sketch is empty).
+    double cdf(double x) const;
+
+    // number of values added.
+    double count() const;
+
+    // number of centroids once the buffer is merged.
+    size_t centroidCount() const;
+
+    // smallest and largest values added.
+    double min() const;
+    double max() const;
+
+};
@@ -0,0 +1,131 @@
+// ThreadPool.cpp : worker threads used by the parallel functions of the library.
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	// hardware_concurrency may return 0 when it cannot tell.
+	threads = std::max(threads, 1u);
+	for (unsigned i = 0; i < threads; i++)
+	{
+		_workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_condition.notify_all();
+	for (std::thread& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned ThreadPool::size() const
+{
+	return (unsigned)_workers.size();
+}
+
+void ThreadPool::work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+
+			// the queue is drained before stopping.
+			if (_tasks.empty())
+			{
+				return;
+			}
+			task = std::move(_tasks.front());
+			_tasks.pop();
+		}
+		task();
+	}
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push(std::move(task));
+	}
+	_condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// state shared by the calling thread and the helpers. A helper that starts after all the indices are taken simply returns.
+	struct State
+	{
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared<State>();
+	const std::function<void(size_t)>* function = &body;
+
+	auto run = [state, count, function]()
+	{
+		size_t i;
+		while ((i = state->next++) < count)
+		{
+			try
+			{
+				(*function)(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (!state->error)
+				{
+					state->error = std::current_exception();
+				}
+			}
+
+			if (++state->done == count)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min<size_t>(size(), count - 1);
+	for (size_t h = 0; h < helpers; h++)
+	{
+		enqueue(run);
+	}
+
+	// the calling thread works too, so the loop completes even when every worker is busy.
+	run();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state, count]() { return state->done == count; });
+	if (state->error)
+	{
+		std::rethrow_exception(state->error);
+	}
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
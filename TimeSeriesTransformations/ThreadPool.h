@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+// fixed-size pool of worker threads shared by the parallel parts of the library.
+class ThreadPool
+{
+
+private:
+    // the worker threads.
+    std::vector<std::thread> _workers{};
+
+    // the tasks waiting for a worker.
+    std::queue<std::function<void()>> _tasks{};
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+
+    // set by the destructor to tell the workers to finish.
+    bool _stopping = false;
+
+    // loop run by every worker: takes tasks off the queue until the pool is destroyed.
+    void work();
+
+    // puts a task on the queue and wakes a worker.
+    void enqueue(std::function<void()> task);
+
+public:
+
+    // creates a pool with the given number of workers (at least one).
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+
+    // waits for the queued tasks to finish and joins the workers.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // number of workers.
+    unsigned size() const;
+
+    // runs a task on the pool and returns a future for its result.
+    template <typename Function>
+    std::future<typename std::result_of<Function()>::type> submit(Function function)
+    {
+        typedef typename std::result_of<Function()>::type Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+        std::future<Result> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // calls body(i) for every i in [0, count) using the workers and the calling thread, and returns once all calls are done.
+    // the calling thread takes part in the work, so it is safe to call from a task already running on the pool.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // pool shared by the library, with one worker per hardware thread.
+    static ThreadPool& shared();
+
+};
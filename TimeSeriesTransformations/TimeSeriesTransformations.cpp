@@ -13,11 +13,259 @@
 #include<cmath>
 #include<chrono>
 #include<ctype.h>
+#include<atomic>
+#include<future>
+#include<cstring>
+#include<cstdlib>
+#include<complex>
+#include<cstdint>
+#include<mutex>
 #include "TimeSeriesTransformations.h"
+#include "ThreadPool.h"
+#include "ArrowSeries.h"
+#include "LoadCache.h"
 
+namespace
+{
+	// execution mode used when a statistic is called with Execution::Default.
+	std::atomic<Execution> defaultExecution{ Execution::Serial };
+
+	// below this number of values the parallel statistics run serially, as splitting them is not worth it.
+	std::atomic<size_t> parallelThreshold{ size_t(1) << 17 };
+
+	// cache of parsed files used by the loads (read and written with the atomic shared_ptr functions).
+	std::shared_ptr<LoadCache> loadCache{};
+
+	// smallest chunk handed to a thread.
+	const size_t minimumChunkSize = size_t(1) << 14;
+
+	// below this number of pairs a comparison sort is faster than the radix sort.
+	const size_t radixSortThreshold = size_t(1) << 12;
+
+	// above this number of ascending runs the runs are not merged but radix sorted.
+	const size_t maximumRunsMerged = 16;
+
+	bool lessByTime(const std::pair<int, double>& a, const std::pair<int, double>& b)
+	{
+		return a.first < b.first;
+	}
+
+	// stable LSD radix sort of pairs on their time, in three passes of 11 bits over the time with its sign bit flipped (so that negative
+	// times come first). Passes whose digit is the same for every pair, such as the high bits of nearby UNIX times, are skipped.
+	void radixSortByTime(std::vector<std::pair<int, double>>& data)
+	{
+		const int bits = 11;
+		const size_t buckets = size_t(1) << bits;
+		const size_t n = data.size();
+
+		std::vector<size_t> counts(3 * buckets, 0);
+		for (const std::pair<int, double>& pair : data)
+		{
+			uint32_t key = (uint32_t)pair.first ^ 0x80000000u;
+			counts[key & (buckets - 1)]++;
+			counts[buckets + ((key >> bits) & (buckets - 1))]++;
+			counts[2 * buckets + (key >> (2 * bits))]++;
+		}
+
+		std::vector<std::pair<int, double>> buffer(n);
+		for (int pass = 0; pass < 3; pass++)
+		{
+			size_t* count = &counts[pass * buckets];
+			uint32_t firstDigit = (((uint32_t)data[0].first ^ 0x80000000u) >> (pass * bits)) & (buckets - 1);
+			if (count[firstDigit] == n)
+			{
+				continue;
+			}
+
+			// counts become the first index of each digit.
+			size_t total = 0;
+			for (size_t d = 0; d < buckets; d++)
+			{
+				size_t c = count[d];
+				count[d] = total;
+				total += c;
+			}
+			for (const std::pair<int, double>& pair : data)
+			{
+				uint32_t digit = (((uint32_t)pair.first ^ 0x80000000u) >> (pass * bits)) & (buckets - 1);
+				buffer[count[digit]++] = pair;
+			}
+			data.swap(buffer);
+		}
+	}
+
+	// sorts pairs by time (stable) or by time and then price (byTimeOnly false, the order of std::sort on pairs). Data that is
+	// already sorted is detected in one pass and left alone, a few ascending runs are merged, and anything else is radix sorted
+	// on the time, after which the pairs of each time are ordered by price if needed.
+	void adaptiveSort(std::vector<std::pair<int, double>>& data, bool byTimeOnly)
+	{
+		const size_t n = data.size();
+		auto less = [byTimeOnly](const std::pair<int, double>& a, const std::pair<int, double>& b) { return byTimeOnly ? a.first < b.first : a < b; };
+
+		// starts of the ascending runs, counted up to one more than can be merged.
+		std::vector<size_t> runs = { 0 };
+		for (size_t i = 1; i < n && runs.size() <= maximumRunsMerged; i++)
+		{
+			if (less(data[i], data[i - 1]))
+			{
+				runs.push_back(i);
+			}
+		}
+		if (runs.size() == 1)
+		{
+			return;
+		}
+
+		if (runs.size() <= maximumRunsMerged)
+		{
+			// merges neighbouring runs pairwise until one is left (inplace_merge is stable).
+			runs.push_back(n);
+			while (runs.size() > 2)
+			{
+				std::vector<size_t> merged;
+				for (size_t r = 0; r + 2 < runs.size(); r += 2)
+				{
+					std::inplace_merge(data.begin() + runs[r], data.begin() + runs[r + 1], data.begin() + runs[r + 2], less);
+					merged.push_back(runs[r]);
+				}
+				if (runs.size() % 2 == 0)
+				{
+					merged.push_back(runs[runs.size() - 2]);
+				}
+				merged.push_back(n);
+				runs.swap(merged);
+			}
+			return;
+		}
+
+		if (n < radixSortThreshold)
+		{
+			if (byTimeOnly)
+			{
+				std::stable_sort(data.begin(), data.end(), lessByTime);
+			}
+			else
+			{
+				std::sort(data.begin(), data.end());
+			}
+			return;
+		}
+
+		radixSortByTime(data);
+		if (!byTimeOnly)
+		{
+			for (size_t i = 0; i < n;)
+			{
+				size_t end = i + 1;
+				while (end < n && data[end].first == data[i].first)
+				{
+					end++;
+				}
+				if (end - i > 1)
+				{
+					std::sort(data.begin() + i, data.begin() + end);
+				}
+				i = end;
+			}
+		}
+	}
+
+	// parses a CSV file given in chunks of any size, keeping the end of a line cut by a chunk until the next chunk arrives.
+	// as in the file constructor, a first line starting with a letter is a header whose second column is the name of the series.
+	class CsvChunkParser
+	{
+	private:
+		std::string _carry;
+		bool _firstLine = true;
+
+	public:
+		std::string name = "No name provided";
+		bool hasHeader = false;
+		char separator = ',';
+
+		// parses the complete lines of a chunk and calls onRow(time, price) for each data line.
+		template <typename Row>
+		void feed(const char* data, size_t size, Row onRow)
+		{
+			const char* end = data + size;
+			const char* line = data;
+			while (true)
+			{
+				const char* newline = static_cast<const char*>(memchr(line, '\n', end - line));
+				if (newline == nullptr)
+				{
+					_carry.append(line, end);
+					return;
+				}
+				if (!_carry.empty())
+				{
+					_carry.append(line, newline);
+					parseLine(_carry.data(), _carry.data() + _carry.size(), onRow);
+					_carry.clear();
+				}
+				else
+				{
+					parseLine(line, newline, onRow);
+				}
+				line = newline + 1;
+			}
+		}
+
+		// parses the last line if the file does not end with a new line.
+		template <typename Row>
+		void finish(Row onRow)
+		{
+			if (!_carry.empty())
+			{
+				parseLine(_carry.data(), _carry.data() + _carry.size(), onRow);
+				_carry.clear();
+			}
+		}
 
-TimeSeriesTransformations::TimeSeriesTransformations(const std::string& filenameandpath)
+		template <typename Row>
+		void parseLine(const char* begin, const char* end, Row onRow)
+		{
+			if (_firstLine && begin != end && isalpha((unsigned char)*begin))
+			{
+				// the name is the word after the first comma.
+				_firstLine = false;
+				hasHeader = true;
+				const char* comma = std::find(begin, end, ',');
+				std::stringstream ss(std::string(comma == end ? end : comma + 1, end));
+				ss >> name;
+				return;
+			}
+			_firstLine = false;
+
+			// lines without digits (empty lines, a trailing carriage return) carry no data.
+			std::string text(begin, end);
+			char* after;
+			long time = strtol(text.c_str(), &after, 10);
+			if (after == text.c_str())
+			{
+				return;
+			}
+			separator = *after;
+			double price = strtod(*after == '\0' ? after : after + 1, nullptr);
+			onRow((int)time, price);
+		}
+	};
+}
+
+
+TimeSeriesTransformations::TimeSeriesTransformations(const std::string& filenameandpath, DuplicatePolicy duplicates)
 {
+	_duplicatePolicy = duplicates;
+
+	// a file parsed before and unchanged since is read from the cache, if there is one (but not from a sidecar load stored for a file
+	// without a header, which this constructor refuses).
+	std::shared_ptr<LoadCache> cache = std::atomic_load(&loadCache);
+	LoadCache::FileVersion version;
+	if (cache && cache->lookup(filenameandpath, duplicates, this, &version, true))
+	{
+		return;
+	}
+
 	// we create an ifstream object in order to open, read and act upon the file of interest.
 	std::ifstream user_file;
 
@@ -31,12 +279,15 @@ TimeSeriesTransformations::TimeSeriesTransformations(const std::string& filename
 	}
 
 	// if the file is good (has not raised any errors) then proceed.
+	bool hasHeader = false;
 	if (user_file.good())
 	{
 		// HEADER CASE
 		// if the first element is a letter, we know there is a header.
 		if (isalpha(user_file.peek())) 
 		{
+			hasHeader = true;
+
 			// get the name of the asset
 			std::string header;
 			getline(user_file, header);
@@ -91,11 +342,120 @@ TimeSeriesTransformations::TimeSeriesTransformations(const std::string& filename
 			}
 		}
 	}
-	// finally, we sort the data in the case that the file received is not ordered.
-	std::sort(_data.begin(), _data.end()); 
+	// finally, we sort the data in the case that the file received is not ordered (and apply the duplicate policy).
+	sortData();
 
 	// close the file.
     user_file.close(); 
+
+	if (cache)
+	{
+		cache->store(filenameandpath, duplicates, version, *this, hasHeader);
+	}
+}
+
+// function that loads a file in chunks. Two buffers are used: while the parser works on one, the next chunk of the file is read into the other
+// on another thread, so the disk and the parsing overlap. Cancellation is checked and progress reported between chunks.
+TimeSeriesTransformations TimeSeriesTransformations::load(const std::string& filenameandpath, const LoadOptions& options)
+{
+	// the cache holds the series as parsed without filter.
+	std::shared_ptr<LoadCache> cache = (options.filter.method() == OutlierFilter::Method::None ? std::atomic_load(&loadCache) : nullptr);
+	TimeSeriesTransformations t;
+	LoadCache::FileVersion version;
+	if (cache && cache->lookup(filenameandpath, options.duplicates, &t, &version))
+	{
+		if (options.progress)
+		{
+			size_t totalBytes = (size_t)std::ifstream(filenameandpath, std::ios::binary | std::ios::ate).tellg();
+			options.progress(totalBytes, totalBytes);
+		}
+		return t;
+	}
+
+	std::ifstream user_file(filenameandpath, std::ios::binary);
+	if (!user_file.is_open())
+	{
+		throw std::runtime_error("Could not open file.");
+	}
+
+	// size of the file, for the progress reports.
+	user_file.seekg(0, std::ios::end);
+	size_t totalBytes = (size_t)user_file.tellg();
+	user_file.seekg(0, std::ios::beg);
+
+	size_t chunkSize = std::max<size_t>(options.chunkSize, 1);
+	std::vector<char> buffers[2];
+	auto readChunk = [&user_file, &buffers, chunkSize](int b)
+	{
+		buffers[b].resize(chunkSize);
+		user_file.read(buffers[b].data(), chunkSize);
+		buffers[b].resize((size_t)user_file.gcount());
+		return buffers[b].size();
+	};
+
+	CsvChunkParser parser;
+	OutlierFilter filter = options.filter;
+	filter.reset();
+	auto onRow = [&t, &filter](int time, double price)
+	{
+		// rejected rows are dropped before they are stored.
+		if (filter.accept(price))
+		{
+			t._data.push_back({ time , t.roundTo(price) });
+		}
+	};
+
+	// the future is declared after the buffers so that, if parsing throws, the read in flight finishes before the buffers are freed.
+	std::future<size_t> pending = std::async(std::launch::async, readChunk, 0);
+	size_t bytesRead = 0;
+	int current = 0;
+	while (true)
+	{
+		size_t size = pending.get();
+		if (size == 0)
+		{
+			break;
+		}
+		if (options.cancel && *options.cancel)
+		{
+			throw std::runtime_error("Loading cancelled.");
+		}
+
+		// read the next chunk while this one is parsed.
+		pending = std::async(std::launch::async, readChunk, 1 - current);
+		parser.feed(buffers[current].data(), size, onRow);
+		current = 1 - current;
+
+		bytesRead += size;
+		if (options.progress)
+		{
+			options.progress(bytesRead, totalBytes);
+		}
+	}
+	parser.finish(onRow);
+
+	// a file with neither header nor data is an error. A file with data but no header is read under the name "No name provided",
+	// where the file constructor refuses it; the cache records which one it was (see LoadCache::lookup).
+	if (!parser.hasHeader && t._data.empty())
+	{
+		throw std::runtime_error("File is empty.");
+	}
+
+	t._name = parser.name;
+	t._separator = parser.separator;
+	t._duplicatePolicy = options.duplicates;
+	t.sortData();
+	if (cache)
+	{
+		cache->store(filenameandpath, options.duplicates, version, t, parser.hasHeader);
+	}
+	return t;
+}
+
+// function that loads a file on another thread.
+std::future<TimeSeriesTransformations> TimeSeriesTransformations::loadAsync(const std::string& filenameandpath, LoadOptions options)
+{
+	return std::async(std::launch::async, [filenameandpath, options]() { return load(filenameandpath, options); });
 }
 
 // this function rounds a double into 5 decimal places.
@@ -107,8 +467,10 @@ double TimeSeriesTransformations::roundTo(double& value_to_round)
 
 // we now create the second constructor which, unlike the first one, does not feed on external file, but takes in 3 inputs from the user. The object TimeSeriesTransformations is hence 
 // created by a given int vector of timestamps in UNIX, a given double vector of data points representing the price of the asset and finally a name which will be the header of the price column.
-TimeSeriesTransformations::TimeSeriesTransformations(const std::vector<int>& time, const std::vector<double>& price, std::string name)
+TimeSeriesTransformations::TimeSeriesTransformations(const std::vector<int>& time, const std::vector<double>& price, std::string name, DuplicatePolicy duplicates)
 {
+	_duplicatePolicy = duplicates;
+
 	// if the time and price vector fed do not match, throw an error.
 	if (size(time) != size(price)) 
 	{
@@ -119,13 +481,14 @@ TimeSeriesTransformations::TimeSeriesTransformations(const std::vector<int>& tim
 	_name = name;
 
 	// push the data back into the vector of pairs.
+	_data.reserve(time.size());
 	for (int i = 0; i < time.size(); i++)
 	{
 		_data.push_back({ time[i], price[i] });
 	}
 
-	// sort the data in case the latter is unsorted.
-	std::sort(_data.begin(), _data.end());
+	// sort the data in case the latter is unsorted (and apply the duplicate policy).
+	sortData();
 
 	// set the separator.
 	_separator = ',';
@@ -134,8 +497,7 @@ TimeSeriesTransformations::TimeSeriesTransformations(const std::vector<int>& tim
 // we create the copy constructor.
 TimeSeriesTransformations::TimeSeriesTransformations(const TimeSeriesTransformations& t)
 {
-	_data = t._data;
-	_name = t._name;
+	*this = t;
 }
 
 // overload the = operator.
@@ -143,6 +505,44 @@ TimeSeriesTransformations& TimeSeriesTransformations::operator=(const TimeSeries
 {
 	_data = t._data;
 	_name = t._name;
+	_separator = t._separator;
+	_priceSketch = t._priceSketch;
+	_incrementSketch = t._incrementSketch;
+	_sketchesEnabled = t._sketchesEnabled;
+	_duplicatePolicy = t._duplicatePolicy;
+
+	// another thread may be building the indexes of t in a const range query.
+	std::lock_guard<std::mutex> lock(t._indexMutex);
+	_rangeIndex = t._rangeIndex;
+	_extremumIndex = t._extremumIndex;
+	_rangeIndexReady.store(_rangeIndex.built(), std::memory_order_release);
+	_extremumIndexReady.store(_extremumIndex.built(), std::memory_order_release);
+	return *this;
+}
+
+// the move constructor takes over the data instead of copying it.
+TimeSeriesTransformations::TimeSeriesTransformations(TimeSeriesTransformations&& t) noexcept
+{
+	*this = std::move(t);
+}
+
+TimeSeriesTransformations& TimeSeriesTransformations::operator=(TimeSeriesTransformations&& t) noexcept
+{
+	_data = std::move(t._data);
+	_name = std::move(t._name);
+	_separator = t._separator;
+	_priceSketch = std::move(t._priceSketch);
+	_incrementSketch = std::move(t._incrementSketch);
+	_sketchesEnabled = t._sketchesEnabled;
+	_duplicatePolicy = t._duplicatePolicy;
+	_rangeIndex = std::move(t._rangeIndex);
+	_extremumIndex = std::move(t._extremumIndex);
+	t._rangeIndex.clear();
+	t._extremumIndex.clear();
+	_rangeIndexReady.store(_rangeIndex.built(), std::memory_order_release);
+	_extremumIndexReady.store(_extremumIndex.built(), std::memory_order_release);
+	t._rangeIndexReady.store(false, std::memory_order_release);
+	t._extremumIndexReady.store(false, std::memory_order_release);
 	return *this;
 }
 
@@ -214,8 +614,15 @@ int TimeSeriesTransformations::count() const
 // function that converts a UNIX timestamp into human readable date (HRD).
 std::string TimeSeriesTransformations::convertToDate(const time_t& unix)
 {
-	// convert time_t type (UNIX) to time structure (tm) using gmtime which returns GMT/UTC time.
-	tm* timeStruct = gmtime(&unix); 
+	// convert time_t type (UNIX) to time structure (tm) using gmtime which returns GMT/UTC time (the reentrant version, as the query server
+	// converts dates from several threads).
+	tm timeBuffer;
+#ifdef _WIN32
+	gmtime_s(&timeBuffer, &unix);
+#else
+	gmtime_r(&unix, &timeBuffer);
+#endif
+	tm* timeStruct = &timeBuffer;
 	
 	// create int year and get the year from the timeStrcut variable (adjust by adding 1900). 
 	int year = 1900 + timeStruct->tm_year; 
@@ -269,9 +676,14 @@ int TimeSeriesTransformations::convertToUnix(const std::string& date)
 
 	// here we are basically inverting the convertToDate function.
 	time_t unix; // we create a type time_t variable which represents the unix which we will soon fill.
-	tm* timeStruct; // we create a time structure pointer.
+	tm timeBuffer; // we create a time structure, filled in place so that several threads may convert dates at once.
+	tm* timeStruct = &timeBuffer;
 	time(&unix); // we get the time of the unix.
-	timeStruct = gmtime(&unix); // convert time_t type to time structure.
+#ifdef _WIN32
+	gmtime_s(timeStruct, &unix); // convert time_t type to time structure.
+#else
+	gmtime_r(&unix, timeStruct);
+#endif
 	timeStruct->tm_year = year - 1900; // get the year (after adjustment) from the time structure.
 	// proceed in the same way for the rest of the variables.
 	timeStruct->tm_mon = month - 1; 
@@ -300,6 +712,12 @@ void TimeSeriesTransformations::displayData() const
 	return;
 }
 
+// the long series are reduced before they are displayed, so that only what can be seen is converted and printed.
+void TimeSeriesTransformations::displayData(size_t points, DownsampleMethod method) const
+{
+	downsampled(points, method).displayData();
+}
+
 // I also wrote a function to only display the price in case needed by the user.
 void TimeSeriesTransformations::displayPrice() const
 {
@@ -342,71 +760,175 @@ double TimeSeriesTransformations::getSD(const std::vector<double>& vector)
 }
 
 // function that computes the mean of the TST object.
-bool TimeSeriesTransformations::mean(double* meanValue) const
+Result<double> TimeSeriesTransformations::tryMean(Execution execution) const
 {
+	if (_data.empty())
+	{
+		return Status::EmptySeries;
+	}
 
-	try
+	// large series can be split between the threads of the pool.
+	return (runInParallel(execution, _data.size()) ? parallelPriceMoments().mean : getMean(getPrice()));
+}
+
+bool TimeSeriesTransformations::mean(double* meanValue, Execution execution) const
+{
+	Result<double> result = tryMean(execution);
+
+	// in case of error, we print the error message and the mean value is set to nan.
+	if (!result)
 	{
-		// if the price vector of the TST has at least one element, then we compute the mean and return true.
-		if (getPrice().size() != 0)
-		{
-			*meanValue = getMean(getPrice()); 
-			return true;
-		}
-		else
-		{
-			// otherwise we throw an error.
-			throw std::runtime_error("Empty vector.");
-		}
+		std::cerr << "Empty vector." << '\n';
 	}
-	catch (const std::runtime_error& error)
+	*meanValue = result.valueOr(std::numeric_limits<double>::quiet_NaN());
+	return result.hasValue();
+}
+
+// function that computes the standard deviaation of teh TST object. The procedure is the same as in the mean function.
+Result<double> TimeSeriesTransformations::tryStandardDeviation(Execution execution) const
+{
+	if (_data.empty())
 	{
-		// we catch the error and print he error message.
-		std::cerr << error.what() << '\n';
+		return Status::EmptySeries;
+	}
 
-		// in case of error, the mean value is set to nan.
-		*meanValue = std::numeric_limits<double>::quiet_NaN();
+	// the sample standard deviation needs at least two prices.
+	if (_data.size() < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
 
-		return false;
+	if (runInParallel(execution, _data.size()))
+	{
+		Moments moments = parallelPriceMoments();
+		return sqrt(moments.m2 / (moments.count - 1));
 	}
+	return getSD(getPrice());
 }
 
-// function that computes the standard deviaation of teh TST object. The procedure is the same as in the mean function.
-bool TimeSeriesTransformations::standardDeviation(double* standardDeviationValue) const
+bool TimeSeriesTransformations::standardDeviation(double* standardDeviationValue, Execution execution) const
 {
-	try
+	Result<double> result = tryStandardDeviation(execution);
+	if (!result && result.error() == Status::EmptySeries)
+	{
+		std::cerr << "Empty vector." << '\n';
+	}
+
+	// a single price gives NaN without failing, as it always did here.
+	*standardDeviationValue = result.valueOr(std::numeric_limits<double>::quiet_NaN());
+	return result.error() != Status::EmptySeries;
+}
+
+// function that merges the moments of two disjoint sets of values. The mean is updated with the weighted difference of the two means
+// and the sums of squared differences are combined with a correction term, which is stable even when the means are far apart.
+TimeSeriesTransformations::Moments TimeSeriesTransformations::mergeMoments(const Moments& a, const Moments& b)
+{
+	if (a.count == 0)
+	{
+		return b;
+	}
+	if (b.count == 0)
+	{
+		return a;
+	}
+	double count = a.count + b.count;
+	double delta = b.mean - a.mean;
+	return { count, a.mean + delta * (b.count / count), a.m2 + b.m2 + delta * delta * (a.count * b.count / count) };
+}
+
+// function that computes the moments of n values in chunks on the shared thread pool.
+template <typename Value>
+TimeSeriesTransformations::Moments TimeSeriesTransformations::parallelMoments(size_t n, Value value)
+{
+	ThreadPool& pool = ThreadPool::shared();
+
+	// a few chunks per thread so that a slow thread does not hold the others back.
+	size_t chunks = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, n / minimumChunkSize));
+	size_t chunkSize = (n + chunks - 1) / chunks;
+	std::vector<Moments> partial(chunks);
+
+	pool.parallelFor(chunks, [&](size_t chunk)
 	{
-		if (getPrice().size() != 0)
+		size_t begin = chunk * chunkSize;
+		size_t end = std::min(n, begin + chunkSize);
+
+		// two passes over the chunk (which is still in cache): the mean, then the squared differences to it.
+		double cumSum = 0.0;
+		for (size_t i = begin; i < end; i++)
 		{
-			*standardDeviationValue = getSD(getPrice());
-			return true;
+			cumSum += value(i);
 		}
-		else
+		double chunkMean = cumSum / (end - begin);
+
+		double m2 = 0.0;
+		for (size_t i = begin; i < end; i++)
+		{
+			m2 += (value(i) - chunkMean) * (value(i) - chunkMean);
+		}
+		partial[chunk] = { double(end - begin), chunkMean, m2 };
+	});
+
+	// merge the chunks pairwise (as a tree) so that no partial result is much larger than the one it is merged with.
+	for (size_t step = 1; step < chunks; step *= 2)
+	{
+		for (size_t i = 0; i + step < chunks; i += 2 * step)
 		{
-			throw std::runtime_error("Empty vector.");
+			partial[i] = mergeMoments(partial[i], partial[i + step]);
 		}
 	}
-	catch (const std::runtime_error& error)
+	return partial[0];
+}
+
+// the moments of the price column.
+TimeSeriesTransformations::Moments TimeSeriesTransformations::parallelPriceMoments() const
+{
+	const std::pair<int, double>* data = _data.data();
+	return parallelMoments(_data.size(), [data](size_t i) { return data[i].second; });
+}
+
+// the moments of the increments. Increment i is price[i + 1] - price[i], so the increments that cross the edge of a chunk are
+// simply computed by the chunk that owns their index, reading the first price of the next chunk.
+TimeSeriesTransformations::Moments TimeSeriesTransformations::parallelIncrementMoments() const
+{
+	const std::pair<int, double>* data = _data.data();
+	return parallelMoments(_data.size() - 1, [data](size_t i) { return data[i + 1].second - data[i].second; });
+}
+
+bool TimeSeriesTransformations::runInParallel(Execution execution, size_t n)
+{
+	if (execution == Execution::Default)
 	{
-		std::cerr << error.what() << '\n';
-		*standardDeviationValue = std::numeric_limits<double>::quiet_NaN();
-		return false;
+		execution = defaultExecution;
 	}
+	return execution == Execution::Parallel && n >= std::max<size_t>(parallelThreshold, 2);
 }
 
-// I create a function to compute the increments of a double vector.
-std::vector<double> TimeSeriesTransformations::computeIncrements() const
+void TimeSeriesTransformations::setDefaultExecution(Execution execution)
+{
+	// the default cannot itself be Default.
+	defaultExecution = (execution == Execution::Default ? Execution::Serial : execution);
+}
+
+void TimeSeriesTransformations::setParallelThreshold(size_t threshold)
 {
-	// we create a vector to store the prices.
-	std::vector<double> increments = getPrice();
+	parallelThreshold = threshold;
+}
 
-	// we make use of the adjacent_difference function to calculate the differences between prices over the whole range.
-	std::adjacent_difference(increments.begin(), increments.end(), increments.begin());
+void TimeSeriesTransformations::setLoadCache(std::shared_ptr<LoadCache> cache)
+{
+	std::atomic_store(&loadCache, cache);
+}
 
-	// we erase the first observation for obvious reasons.
-	increments.erase(increments.begin());
+std::shared_ptr<LoadCache> TimeSeriesTransformations::getLoadCache()
+{
+	return std::atomic_load(&loadCache);
+}
 
-	return increments;
+// I create a function to compute the increments of a double vector.
+std::vector<double> TimeSeriesTransformations::computeIncrements() const
+{
+	// the increments are the differences at lag 1, written straight into a vector of the right size.
+	return computeReturns(ReturnType::Difference, 1);
 }
 
 // function to print the incrememts to the console.
@@ -415,397 +937,2234 @@ void TimeSeriesTransformations::displayIncrements() const
 	// add the header.
 	std::cout << "    Date     , " << _name << '\n';
 
+	// compute the increments once.
+	std::vector<double> increments = computeIncrements();
+
 	// print converting each UNIX to HRD.
-	for (int i = 0; i < computeIncrements().size(); i++)
+	for (int i = 0; i < increments.size(); i++)
 	{
 		// as advised by James, we set the date of the increments price[i+1] - price[i] to be i.
-		std::cout << convertToDate(_data[i].first) << ", " << computeIncrements()[i] << '\n';
+		std::cout << convertToDate(_data[i].first) << ", " << increments[i] << '\n';
 	}
 }
 
-// function that computes the mean of the increments. Same procedure as in the mean function.
-bool TimeSeriesTransformations::computeIncrementMean(double* meanValue) const
+// function that writes the returns at lag k into a caller buffer. There is one loop per kind of return, so that each loop is a plain
+// pass over the prices that the compiler can vectorize. As for the increments, return i is dated at the time of price i.
+Result<size_t> TimeSeriesTransformations::tryComputeReturns(ReturnType type, int lag, double* values, size_t size) const
 {
-	try
+	if (lag < 1)
 	{
-		if (_data.size() != 0)
-		{
-			*meanValue = getMean(computeIncrements());
-			return true;
-		}
-		else
-		{
-			throw std::runtime_error("Empty vector.");
-		}
+		return Status::InvalidArgument;
 	}
-	catch (const std::runtime_error& error)
+	if ((size_t)lag >= _data.size())
 	{
-		std::cerr << error.what() << '\n';
-		*meanValue = std::numeric_limits<double>::quiet_NaN();
-		return false;
-	}	
-}
+		return Status::NotEnoughPrices;
+	}
+	size_t m = _data.size() - lag;
+	if (size < m)
+	{
+		return Status::InvalidArgument;
+	}
 
-// function that computes the standard deviation of the increments. Same procedure as in the standard deviation function.
-bool TimeSeriesTransformations::computeIncrementStandardDeviation(double* standardDeviationValue) const
-{
-	try
+	const std::pair<int, double>* data = _data.data();
+	switch (type)
 	{
-		if (_data.size() != 0)
+	case ReturnType::Difference:
+		for (size_t i = 0; i < m; i++)
 		{
-			*standardDeviationValue = getSD(computeIncrements());
-			return true;
+			values[i] = data[i + lag].second - data[i].second;
 		}
-		else
+		break;
+	case ReturnType::Log:
+		for (size_t i = 0; i < m; i++)
+		{
+			values[i] = std::log(data[i + lag].second / data[i].second);
+		}
+		break;
+	case ReturnType::Percentage:
+		for (size_t i = 0; i < m; i++)
 		{
-			throw std::runtime_error("Empty vector.");
+			values[i] = data[i + lag].second / data[i].second - 1;
 		}
+		break;
+	case ReturnType::Cumulative:
+	{
+		double base = data[0].second;
+		for (size_t i = 0; i < m; i++)
+		{
+			values[i] = data[i + lag].second / base - 1;
+		}
+		break;
 	}
-	catch (const std::runtime_error& error)
+	}
+	return m;
+}
+
+bool TimeSeriesTransformations::computeReturns(ReturnType type, int lag, double* values, size_t size) const
+{
+	Result<size_t> result = tryComputeReturns(type, lag, values, size);
+	if (!result)
 	{
-		std::cerr << error.what() << '\n';
-		*standardDeviationValue = std::numeric_limits<double>::quiet_NaN();
-		return false;
+		bool badLag = result.error() == Status::NotEnoughPrices || lag < 1;
+		std::cerr << (badLag ? "The lag must be at least 1 and lower than the number of prices." : "The buffer is too small for the returns.") << '\n';
 	}
+	return result.hasValue();
 }
 
-// function that truncates a given date to only its Y-M-D component (i.e. from datetime to day).
-int TimeSeriesTransformations::truncDate(std::string& date)
+// same as above but returns a new vector (empty if there are not enough prices).
+std::vector<double> TimeSeriesTransformations::computeReturns(ReturnType type, int lag) const
 {
-	std::stringstream ss(date);
+	std::vector<double> values;
+	if (lag >= 1 && (size_t)lag < _data.size())
+	{
+		values.resize(_data.size() - lag);
+		tryComputeReturns(type, lag, values.data(), values.size());
+	}
+	return values;
+}
 
-	// parse the string such that the date Y-M-D H-m-S is broken by the space.
-	getline(ss, date, ' ');
+// function that builds a new series out of the returns, named after this one.
+TimeSeriesTransformations TimeSeriesTransformations::returnsSeries(ReturnType type, int lag) const
+{
+	TimeSeriesTransformations t;
+	t._name = _name;
+	t._separator = (_separator == '\0' ? ',' : _separator);
 
-	// we return the first part of the broken string by first converting it to UNIX.
-	return convertToUnix(date);
+	std::vector<double> values = computeReturns(type, lag);
+	t._data.resize(values.size());
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		t._data[i] = { _data[i].first, values[i] };
+	}
+	return t;
 }
 
-// function that truncate a UNIX timestamp.
+// function that projects the prices onto the grid start, start + step, ... of "size" points, writing the grid times (if times is not null)
+// and prices into caller buffers. Grid and data are both sorted, so a single index walks the data once as the grid advances: it stops on
+// the last price at or before the grid time, and the next price is the one after it.
+Result<size_t> TimeSeriesTransformations::tryReindex(int start, int step, FillMethod fill, int maxGap, int* times, double* prices, size_t size) const
+{
+	if (step <= 0 || maxGap < 0)
+	{
+		return Status::InvalidArgument;
+	}
+	if (size > 0 && (long long)start + (long long)(size - 1) * step > std::numeric_limits<int>::max())
+	{
+		return Status::InvalidArgument;
+	}
+
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const size_t n = _data.size();
+	size_t j = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		int time = (int)(start + (long long)i * step);
+		if (times != nullptr)
+		{
+			times[i] = time;
+		}
+
+		// after this loop, _data[j - 1] is the last price at or before the grid time and _data[j] the first one after it.
+		while (j < n && _data[j].first <= time)
+		{
+			j++;
+		}
+
+		double value = nan;
+		if (j > 0 && _data[j - 1].first == time)
+		{
+			value = _data[j - 1].second;
+		}
+		else if (j > 0)
+		{
+			const std::pair<int, double>& before = _data[j - 1];
+			if (fill == FillMethod::Forward && (maxGap == 0 || (long long)time - before.first <= maxGap))
+			{
+				value = before.second;
+			}
+			else if (fill == FillMethod::Linear && j < n && (maxGap == 0 || (long long)_data[j].first - before.first <= maxGap))
+			{
+				const std::pair<int, double>& after = _data[j];
+				value = before.second + (after.second - before.second) * ((double)time - before.first) / ((double)after.first - before.first);
+			}
+		}
+		prices[i] = value;
+	}
+	return size;
+}
+
+bool TimeSeriesTransformations::reindex(int start, int step, FillMethod fill, int maxGap, int* times, double* prices, size_t size) const
+{
+	Result<size_t> result = tryReindex(start, step, fill, maxGap, times, prices, size);
+	if (!result)
+	{
+		std::cerr << (step <= 0 || maxGap < 0 ? "The step must be positive and the maximum gap not negative." : "The grid goes beyond the largest UNIX time.") << '\n';
+	}
+	return result.hasValue();
+}
+
+// function that returns a new series on the grid going from the first time of the series to its last time in steps of "step" seconds.
+TimeSeriesTransformations TimeSeriesTransformations::reindexed(int step, FillMethod fill, int maxGap) const
+{
+	TimeSeriesTransformations t;
+	t._name = _name;
+	t._separator = (_separator == '\0' ? ',' : _separator);
+	if (_data.empty() || step <= 0)
+	{
+		return t;
+	}
+
+	size_t size = (size_t)(((long long)_data.back().first - _data.front().first) / step + 1);
+	std::vector<int> times(size);
+	std::vector<double> prices(size);
+	if (tryReindex(_data.front().first, step, fill, maxGap, times.data(), prices.data(), size))
+	{
+		t._data.resize(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			t._data[i] = { times[i], prices[i] };
+		}
+	}
+	return t;
+}
+
+size_t TimeSeriesTransformations::downsample(int from, int to, size_t points, DownsampleMethod method, int* times, double* prices) const
+{
+	size_t begin, end;
+	rangeBetween(from, to, &begin, &end);
+	size_t n = end - begin;
+	size_t written = 0;
+	auto keep = [&](size_t i)
+	{
+		if (times != nullptr)
+		{
+			times[written] = _data[i].first;
+		}
+		prices[written++] = _data[i].second;
+	};
+
+	// a range that already fits is copied as it is, and a single point stands for the range by its first price.
+	if (points == 0 || n == 0)
+	{
+		return 0;
+	}
+	if (n <= points || points == 1)
+	{
+		for (size_t i = begin; i < end && written < points; i++)
+		{
+			keep(i);
+		}
+		return written;
+	}
+
+	keep(begin);
+	if (method == DownsampleMethod::MinMax)
+	{
+		// the prices between the first and the last one are split into equal buckets, each giving its lowest and highest prices in time
+		// order (a NaN is never kept unless the whole bucket is NaN).
+		size_t buckets = (points - 2) / 2;
+		size_t m = n - 2;
+		for (size_t k = 0; k < buckets; k++)
+		{
+			size_t bucketBegin = begin + 1 + k * m / buckets;
+			size_t bucketEnd = begin + 1 + (k + 1) * m / buckets;
+			size_t lowest = bucketBegin, highest = bucketBegin;
+			for (size_t i = bucketBegin + 1; i < bucketEnd; i++)
+			{
+				double price = _data[i].second;
+				if (price < _data[lowest].second || std::isnan(_data[lowest].second))
+				{
+					lowest = i;
+				}
+				if (price > _data[highest].second || std::isnan(_data[highest].second))
+				{
+					highest = i;
+				}
+			}
+			keep(std::min(lowest, highest));
+			if (lowest != highest)
+			{
+				keep(std::max(lowest, highest));
+			}
+		}
+	}
+	else if (points > 2)
+	{
+		// Largest-Triangle-Three-Buckets: the prices between the first and the last one are split into points - 2 buckets; in each one we keep
+		// the price making the largest triangle with the price kept before it and the average point of the next bucket (the last price for
+		// the last bucket). Each price is read twice, once in the average and once as a candidate. The times are taken from the first one.
+		double every = (double)(n - 2) / (points - 2);
+		double origin = _data[begin].first;
+		size_t previous = begin;
+		for (size_t k = 0; k < points - 2; k++)
+		{
+			size_t bucketBegin = begin + 1 + (size_t)(k * every);
+			size_t bucketEnd = std::min(begin + 1 + (size_t)((k + 1) * every), end - 1);
+			size_t nextEnd = std::min(begin + 1 + (size_t)((k + 2) * every), end);
+
+			double averageTime = 0, averagePrice = 0;
+			size_t counted = 0;
+			for (size_t i = bucketEnd; i < nextEnd; i++)
+			{
+				if (!std::isnan(_data[i].second))
+				{
+					averageTime += _data[i].first - origin;
+					averagePrice += _data[i].second;
+					counted++;
+				}
+			}
+			averageTime = (counted > 0 ? averageTime / counted : _data[end - 1].first - origin);
+			averagePrice = (counted > 0 ? averagePrice / counted : std::numeric_limits<double>::quiet_NaN());
+
+			// twice the area of the triangle; a NaN area never wins, so a bucket of NaN keeps its first price.
+			double previousTime = _data[previous].first - origin, previousPrice = _data[previous].second;
+			double largestArea = -1;
+			size_t chosen = bucketBegin;
+			for (size_t i = bucketBegin; i < bucketEnd; i++)
+			{
+				double area = std::abs((previousTime - averageTime) * (_data[i].second - previousPrice)
+					- (previousTime - (_data[i].first - origin)) * (averagePrice - previousPrice));
+				if (area > largestArea)
+				{
+					largestArea = area;
+					chosen = i;
+				}
+			}
+			keep(chosen);
+			previous = chosen;
+		}
+	}
+	keep(end - 1);
+	return written;
+}
+
+TimeSeriesTransformations TimeSeriesTransformations::downsampledBetween(int from, int to, size_t points, DownsampleMethod method) const
+{
+	TimeSeriesTransformations t;
+	t._name = _name;
+	t._separator = (_separator == '\0' ? ',' : _separator);
+
+	size_t size = std::min(points, countBetween(from, to));
+	std::vector<int> times(size);
+	std::vector<double> prices(size);
+	size = downsample(from, to, size, method, times.data(), prices.data());
+	t._data.resize(size);
+	for (size_t i = 0; i < size; i++)
+	{
+		t._data[i] = { times[i], prices[i] };
+	}
+	return t;
+}
+
+TimeSeriesTransformations TimeSeriesTransformations::downsampled(size_t points, DownsampleMethod method) const
+{
+	return downsampledBetween(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), points, method);
+}
+
+namespace
+{
+	// mean and sample standard deviation of the m values value(i) in one pass. The sums are taken around the first value, which
+	// avoids the loss of precision of the plain sum of squares when the values are far from zero.
+	template <typename Value>
+	void shiftedMoments(size_t m, Value value, double* meanValue, double* standardDeviationValue)
+	{
+		double shift = value(0);
+		double sum = 0, sumOfSquares = 0;
+		for (size_t i = 0; i < m; i++)
+		{
+			double x = value(i) - shift;
+			sum += x;
+			sumOfSquares += x * x;
+		}
+		*meanValue = shift + sum / m;
+		*standardDeviationValue = sqrt(std::max(0.0, sumOfSquares - sum * sum / m) / (m - 1));
+	}
+}
+
+// function that computes the mean and standard deviation of the returns in the same pass that computes them, without storing them.
+Result<std::pair<double, double>> TimeSeriesTransformations::tryReturnStatistics(ReturnType type, int lag) const
+{
+	if (lag < 1)
+	{
+		return Status::InvalidArgument;
+	}
+
+	// the sample standard deviation needs at least two returns.
+	if ((size_t)lag + 1 >= _data.size())
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	size_t m = _data.size() - lag;
+	const std::pair<int, double>* data = _data.data();
+	double base = data[0].second;
+	double meanValue = 0, standardDeviationValue = 0;
+	switch (type)
+	{
+	case ReturnType::Difference:
+		shiftedMoments(m, [data, lag](size_t i) { return data[i + lag].second - data[i].second; }, &meanValue, &standardDeviationValue);
+		break;
+	case ReturnType::Log:
+		shiftedMoments(m, [data, lag](size_t i) { return std::log(data[i + lag].second / data[i].second); }, &meanValue, &standardDeviationValue);
+		break;
+	case ReturnType::Percentage:
+		shiftedMoments(m, [data, lag](size_t i) { return data[i + lag].second / data[i].second - 1; }, &meanValue, &standardDeviationValue);
+		break;
+	case ReturnType::Cumulative:
+		shiftedMoments(m, [data, lag, base](size_t i) { return data[i + lag].second / base - 1; }, &meanValue, &standardDeviationValue);
+		break;
+	}
+	return std::make_pair(meanValue, standardDeviationValue);
+}
+
+bool TimeSeriesTransformations::returnStatistics(ReturnType type, int lag, double* meanValue, double* standardDeviationValue) const
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	Result<std::pair<double, double>> result = tryReturnStatistics(type, lag);
+
+	// a single return still gives its mean, with a NaN standard deviation, as it always did here.
+	if (!result && lag >= 1 && (size_t)lag + 1 == _data.size())
+	{
+		double value;
+		tryComputeReturns(type, lag, &value, 1);
+		*meanValue = value;
+		*standardDeviationValue = nan;
+		return true;
+	}
+	if (!result)
+	{
+		std::cerr << "The lag must be at least 1 and lower than the number of prices." << '\n';
+	}
+	*meanValue = result.valueOr({ nan, nan }).first;
+	*standardDeviationValue = result.valueOr({ nan, nan }).second;
+	return result.hasValue();
+}
+
+namespace
+{
+	// in-place iterative radix-2 fast Fourier transform of a vector whose size is a power of two (inverse = true for the unscaled inverse).
+	void fft(std::vector<std::complex<double>>& a, bool inverse)
+	{
+		const double pi = 3.14159265358979323846;
+		size_t n = a.size();
+
+		// bit-reversal permutation.
+		for (size_t i = 1, j = 0; i < n; i++)
+		{
+			size_t bit = n >> 1;
+			for (; j & bit; bit >>= 1)
+			{
+				j ^= bit;
+			}
+			j ^= bit;
+			if (i < j)
+			{
+				std::swap(a[i], a[j]);
+			}
+		}
+
+		// the roots of unity are computed once with cos and sin (rather than by repeated multiplication, which drifts for long transforms)
+		// and each stage reads them with a stride.
+		std::vector<std::complex<double>> roots(n / 2);
+		for (size_t k = 0; k < n / 2; k++)
+		{
+			double angle = 2 * pi * k / n * (inverse ? 1 : -1);
+			roots[k] = std::complex<double>(cos(angle), sin(angle));
+		}
+
+		// one butterfly of the stage of the given length (the complex product is written out, as std::complex also checks for NaNs).
+		auto butterfly = [&a, &roots, n](size_t length, size_t start, size_t k)
+		{
+			const std::complex<double>& x = a[start + k + length / 2];
+			const std::complex<double>& w = roots[k * (n / length)];
+			std::complex<double> v(x.real() * w.real() - x.imag() * w.imag(), x.real() * w.imag() + x.imag() * w.real());
+			std::complex<double> u = a[start + k];
+			a[start + k] = u + v;
+			a[start + k + length / 2] = u - v;
+		};
+
+		// the first stages only mix points within blocks that fit in the cache, so each block goes through all of them at once
+		// rather than streaming the whole vector through memory once per stage. The blocks are independent and run on the thread pool.
+		const size_t block = std::min<size_t>(n, size_t(1) << 13);
+		ThreadPool::shared().parallelFor(n / block, [&](size_t b)
+		{
+			for (size_t length = 2; length <= block; length <<= 1)
+			{
+				for (size_t start = b * block; start < (b + 1) * block; start += length)
+				{
+					for (size_t k = 0; k < length / 2; k++)
+					{
+						butterfly(length, start, k);
+					}
+				}
+			}
+		});
+
+		// the later stages are split between the threads by butterfly index.
+		const size_t chunk = size_t(1) << 14;
+		for (size_t length = block * 2; length <= n; length <<= 1)
+		{
+			size_t half = length / 2;
+			ThreadPool::shared().parallelFor((n / 2 + chunk - 1) / chunk, [&](size_t c)
+			{
+				for (size_t j = c * chunk; j < std::min(n / 2, (c + 1) * chunk); j++)
+				{
+					butterfly(length, (j / half) * length, j % half);
+				}
+			});
+		}
+	}
+}
+
+// function that computes the autocovariances of a vector of values at lags 0 to maxLag. The direct method sums the lagged products;
+// the FFT method uses the fact that the autocovariance is the inverse transform of the power spectrum. The values are zero-padded to
+// at least n + maxLag points so that the circular correlation computed by the FFT does not wrap around for the lags asked.
+void TimeSeriesTransformations::autocovarianceOf(std::vector<double>& values, int maxLag, AutocorrelationMethod method, std::vector<double>* autocovariances)
+{
+	size_t n = values.size();
+	double mean = getMean(values);
+	for (double& value : values)
+	{
+		value -= mean;
+	}
+
+	size_t lags = (size_t)maxLag + 1;
+	size_t fftSize = 1;
+	while (fftSize < n + maxLag)
+	{
+		fftSize <<= 1;
+	}
+
+	if (method == AutocorrelationMethod::Automatic)
+	{
+		// a transform costs about 5 N log2 N operations against 2 per product for the direct sums, and two transforms are needed.
+		double directCost = (double)n * lags;
+		double fftCost = 5.0 * fftSize * log2((double)fftSize);
+		method = (directCost <= fftCost ? AutocorrelationMethod::Direct : AutocorrelationMethod::FFT);
+	}
+
+	autocovariances->assign(lags, 0.0);
+	if (method == AutocorrelationMethod::Direct)
+	{
+		for (size_t k = 0; k < lags; k++)
+		{
+			double cumSum = 0.0;
+			for (size_t i = 0; i + k < n; i++)
+			{
+				cumSum += values[i] * values[i + k];
+			}
+			(*autocovariances)[k] = cumSum / n;
+		}
+	}
+	else
+	{
+		std::vector<std::complex<double>> spectrum(fftSize);
+		for (size_t i = 0; i < n; i++)
+		{
+			spectrum[i] = values[i];
+		}
+		fft(spectrum, false);
+		for (std::complex<double>& value : spectrum)
+		{
+			value = std::norm(value);
+		}
+		fft(spectrum, true);
+
+		// the inverse transform is unscaled, hence the division by fftSize.
+		for (size_t k = 0; k < lags; k++)
+		{
+			(*autocovariances)[k] = spectrum[k].real() / fftSize / n;
+		}
+	}
+}
+
+// function that computes the autocovariance of the prices. maxLag is capped at the number of prices minus one.
+Result<std::vector<double>> TimeSeriesTransformations::tryAutocovariance(int maxLag, AutocorrelationMethod method) const
+{
+	if (maxLag < 0)
+	{
+		return Status::InvalidArgument;
+	}
+	if (_data.size() < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
+	std::vector<double> prices = getPrice();
+	std::vector<double> values;
+	autocovarianceOf(prices, std::min(maxLag, (int)prices.size() - 1), method, &values);
+	return values;
+}
+
+bool TimeSeriesTransformations::autocovariance(int maxLag, std::vector<double>* values, AutocorrelationMethod method) const
+{
+	Result<std::vector<double>> result = tryAutocovariance(maxLag, method);
+	if (!result)
+	{
+		std::cerr << "The autocovariance needs at least 2 prices and a positive number of lags." << '\n';
+	}
+	*values = result.take();
+	return result.hasValue();
+}
+
+// the autocorrelation is the autocovariance divided by the variance (the autocovariance at lag 0).
+Result<std::vector<double>> TimeSeriesTransformations::tryAutocorrelation(int maxLag, AutocorrelationMethod method) const
+{
+	Result<std::vector<double>> result = tryAutocovariance(maxLag, method);
+	if (!result)
+	{
+		return result;
+	}
+	std::vector<double> values = result.take();
+	double variance = values[0];
+	for (double& value : values)
+	{
+		value /= variance;
+	}
+	return values;
+}
+
+bool TimeSeriesTransformations::autocorrelation(int maxLag, std::vector<double>* values, AutocorrelationMethod method) const
+{
+	Result<std::vector<double>> result = tryAutocorrelation(maxLag, method);
+	if (!result)
+	{
+		std::cerr << "The autocovariance needs at least 2 prices and a positive number of lags." << '\n';
+	}
+	*values = result.take();
+	return result.hasValue();
+}
+
+// same as autocovariance for the increments.
+Result<std::vector<double>> TimeSeriesTransformations::tryIncrementAutocovariance(int maxLag, AutocorrelationMethod method) const
+{
+	if (maxLag < 0)
+	{
+		return Status::InvalidArgument;
+	}
+	if (_data.size() < 3)
+	{
+		return Status::NotEnoughPrices;
+	}
+	std::vector<double> increments = computeIncrements();
+	std::vector<double> values;
+	autocovarianceOf(increments, std::min(maxLag, (int)increments.size() - 1), method, &values);
+	return values;
+}
+
+bool TimeSeriesTransformations::incrementAutocovariance(int maxLag, std::vector<double>* values, AutocorrelationMethod method) const
+{
+	Result<std::vector<double>> result = tryIncrementAutocovariance(maxLag, method);
+	if (!result)
+	{
+		std::cerr << "The autocovariance needs at least 2 increments and a positive number of lags." << '\n';
+	}
+	*values = result.take();
+	return result.hasValue();
+}
+
+Result<std::vector<double>> TimeSeriesTransformations::tryIncrementAutocorrelation(int maxLag, AutocorrelationMethod method) const
+{
+	Result<std::vector<double>> result = tryIncrementAutocovariance(maxLag, method);
+	if (!result)
+	{
+		return result;
+	}
+	std::vector<double> values = result.take();
+	double variance = values[0];
+	for (double& value : values)
+	{
+		value /= variance;
+	}
+	return values;
+}
+
+bool TimeSeriesTransformations::incrementAutocorrelation(int maxLag, std::vector<double>* values, AutocorrelationMethod method) const
+{
+	Result<std::vector<double>> result = tryIncrementAutocorrelation(maxLag, method);
+	if (!result)
+	{
+		std::cerr << "The autocovariance needs at least 2 increments and a positive number of lags." << '\n';
+	}
+	*values = result.take();
+	return result.hasValue();
+}
+
+namespace
+{
+	// number of assets per side of a tile of the covariance matrix, and number of increments read at a time. A tile reads
+	// 2 * covarianceTileSize rows of covarianceDepth increments, which stay in the cache while all the dot products of the tile use them.
+	const size_t covarianceTileSize = 32;
+	const size_t covarianceDepth = 512;
+
+	// adds the dot products of rows a0, a1 with rows b0, b1 over [begin, end) to the four sums. Each loaded value is used twice and the
+	// four sums are independent, which keeps the floating point units busy (and lets the compiler vectorize the loop).
+	void dot2x2(const double* a0, const double* a1, const double* b0, const double* b1, size_t begin, size_t end, double* sums)
+	{
+		double s00 = 0, s01 = 0, s10 = 0, s11 = 0;
+		for (size_t k = begin; k < end; k++)
+		{
+			s00 += a0[k] * b0[k];
+			s01 += a0[k] * b1[k];
+			s10 += a1[k] * b0[k];
+			s11 += a1[k] * b1[k];
+		}
+		sums[0] += s00;
+		sums[1] += s01;
+		sums[2] += s10;
+		sums[3] += s11;
+	}
+}
+
+// function that computes the covariance (or correlation) matrix of the increments of several series tile by tile.
+// the series are sampled on the grid of "step" seconds over the time span they all cover (carrying the last price forward), and the
+// increments of each series are centred (and scaled to unit norm for correlations) into one row of a matrix X. The matrix is then
+// X X^T / (m - 1), computed in tiles of covarianceTileSize assets on the thread pool. Only the tiles on and above the diagonal are
+// computed, and each is handed to onTile (one call at a time) and then dropped, so the memory used is X plus one tile per thread.
+Result<size_t> TimeSeriesTransformations::tryIncrementCovarianceTiles(const std::vector<const TimeSeriesTransformations*>& series, int step, bool correlation,
+	const std::function<void(const MatrixTile&)>& onTile)
+{
+	if (series.empty() || step <= 0)
+	{
+		return Status::InvalidArgument;
+	}
+
+	// common span of the series.
+	int start = std::numeric_limits<int>::min();
+	int end = std::numeric_limits<int>::max();
+	for (const TimeSeriesTransformations* s : series)
+	{
+		if (s == nullptr)
+		{
+			return Status::InvalidArgument;
+		}
+		if (s->_data.empty())
+		{
+			return Status::EmptySeries;
+		}
+		start = std::max(start, s->_data.front().first);
+		end = std::min(end, s->_data.back().first);
+	}
+	if (end < start || ((long long)end - start) / step < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	const size_t points = (size_t)(((long long)end - start) / step + 1);
+	const size_t m = points - 1;
+	const size_t k = series.size();
+
+	// one row of increments per series, centred (and normalised).
+	std::vector<double> increments(k * m);
+	ThreadPool::shared().parallelFor(k, [&](size_t a)
+	{
+		std::vector<double> prices(points);
+		series[a]->tryReindex(start, step, FillMethod::Forward, 0, nullptr, prices.data(), points);
+		double* row = &increments[a * m];
+		double cumSum = 0.0;
+		for (size_t i = 0; i < m; i++)
+		{
+			row[i] = prices[i + 1] - prices[i];
+			cumSum += row[i];
+		}
+		double rowMean = cumSum / m;
+		double norm = 0.0;
+		for (size_t i = 0; i < m; i++)
+		{
+			row[i] -= rowMean;
+			norm += row[i] * row[i];
+		}
+		if (correlation)
+		{
+			// a flat series has no correlation with anything; its row is left at zero and its diagonal set to NaN below.
+			double scale = (norm > 0 ? 1 / std::sqrt(norm) : 0);
+			for (size_t i = 0; i < m; i++)
+			{
+				row[i] *= scale;
+			}
+		}
+	});
+
+	const size_t tiles = (k + covarianceTileSize - 1) / covarianceTileSize;
+	std::vector<std::pair<size_t, size_t>> pairs;
+	for (size_t ti = 0; ti < tiles; ti++)
+	{
+		for (size_t tj = ti; tj < tiles; tj++)
+		{
+			pairs.push_back({ ti, tj });
+		}
+	}
+
+	const double divisor = (correlation ? 1.0 : double(m - 1));
+	std::mutex tileMutex;
+	ThreadPool::shared().parallelFor(pairs.size(), [&](size_t p)
+	{
+		size_t firstRow = pairs[p].first * covarianceTileSize;
+		size_t firstColumn = pairs[p].second * covarianceTileSize;
+		size_t rows = std::min(covarianceTileSize, k - firstRow);
+		size_t columns = std::min(covarianceTileSize, k - firstColumn);
+		std::vector<double> tile(rows * columns, 0.0);
+
+		for (size_t depth = 0; depth < m; depth += covarianceDepth)
+		{
+			size_t depthEnd = std::min(m, depth + covarianceDepth);
+			for (size_t r = 0; r < rows; r += 2)
+			{
+				// with an odd number of rows or columns, the last one is paired with itself and its duplicate sums are dropped.
+				size_t r1 = std::min(r + 1, rows - 1);
+				const double* a0 = &increments[(firstRow + r) * m];
+				const double* a1 = &increments[(firstRow + r1) * m];
+				for (size_t c = 0; c < columns; c += 2)
+				{
+					size_t c1 = std::min(c + 1, columns - 1);
+					double sums[4] = { 0, 0, 0, 0 };
+					dot2x2(a0, a1, &increments[(firstColumn + c) * m], &increments[(firstColumn + c1) * m], depth, depthEnd, sums);
+					tile[r * columns + c] += sums[0];
+					if (c1 != c)
+					{
+						tile[r * columns + c1] += sums[1];
+					}
+					if (r1 != r)
+					{
+						tile[r1 * columns + c] += sums[2];
+						if (c1 != c)
+						{
+							tile[r1 * columns + c1] += sums[3];
+						}
+					}
+				}
+			}
+		}
+
+		for (size_t r = 0; r < rows; r++)
+		{
+			for (size_t c = 0; c < columns; c++)
+			{
+				double& value = tile[r * columns + c];
+				value /= divisor;
+				if (correlation && firstRow + r == firstColumn + c)
+				{
+					value = (value > 0 ? 1.0 : std::numeric_limits<double>::quiet_NaN());
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(tileMutex);
+		onTile({ firstRow, firstColumn, rows, columns, tile.data() });
+	});
+	return m;
+}
+
+bool TimeSeriesTransformations::incrementCovarianceTiles(const std::vector<const TimeSeriesTransformations*>& series, int step, bool correlation,
+	const std::function<void(const MatrixTile&)>& onTile)
+{
+	Result<size_t> result = tryIncrementCovarianceTiles(series, step, correlation, onTile);
+	if (!result)
+	{
+		const char* message = "The series do not share enough time for two increments on the grid.";
+		if (series.empty() || step <= 0)
+		{
+			message = "At least one series and a positive step are needed.";
+		}
+		else if (result.error() != Status::NotEnoughPrices)
+		{
+			message = "Every series must hold prices.";
+		}
+		std::cerr << message << '\n';
+	}
+	return result.hasValue();
+}
+
+// function that gathers the tiles into the full k x k matrix (row-major), mirroring the tiles above the diagonal.
+bool TimeSeriesTransformations::incrementCovarianceMatrix(const std::vector<const TimeSeriesTransformations*>& series, int step, std::vector<double>* matrix, bool correlation)
+{
+	const size_t k = series.size();
+	matrix->assign(k * k, std::numeric_limits<double>::quiet_NaN());
+	return incrementCovarianceTiles(series, step, correlation, [matrix, k](const MatrixTile& tile)
+	{
+		for (size_t r = 0; r < tile.rows; r++)
+		{
+			for (size_t c = 0; c < tile.columns; c++)
+			{
+				double value = tile.values[r * tile.columns + c];
+				(*matrix)[(tile.firstRow + r) * k + tile.firstColumn + c] = value;
+				(*matrix)[(tile.firstColumn + c) * k + tile.firstRow + r] = value;
+			}
+		}
+	});
+}
+
+bool TimeSeriesTransformations::incrementCorrelationMatrix(const std::vector<const TimeSeriesTransformations*>& series, int step, std::vector<double>* matrix)
+{
+	return incrementCovarianceMatrix(series, step, matrix, true);
+}
+
+// function that computes the mean of the increments. Same procedure as in the mean function.
+Result<double> TimeSeriesTransformations::tryIncrementMean(Execution execution) const
+{
+	if (_data.empty())
+	{
+		return Status::EmptySeries;
+	}
+
+	// a single price has no increment.
+	if (_data.size() < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	return (runInParallel(execution, _data.size()) ? parallelIncrementMoments().mean : getMean(computeIncrements()));
+}
+
+bool TimeSeriesTransformations::computeIncrementMean(double* meanValue, Execution execution) const
+{
+	Result<double> result = tryIncrementMean(execution);
+	if (!result && result.error() == Status::EmptySeries)
+	{
+		std::cerr << "Empty vector." << '\n';
+	}
+	*meanValue = result.valueOr(std::numeric_limits<double>::quiet_NaN());
+	return result.error() != Status::EmptySeries;
+}
+
+// function that computes the standard deviation of the increments. Same procedure as in the standard deviation function.
+Result<double> TimeSeriesTransformations::tryIncrementStandardDeviation(Execution execution) const
+{
+	if (_data.empty())
+	{
+		return Status::EmptySeries;
+	}
+
+	// the sample standard deviation of the increments needs at least two of them.
+	if (_data.size() < 3)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	if (runInParallel(execution, _data.size()))
+	{
+		Moments moments = parallelIncrementMoments();
+		return sqrt(moments.m2 / (moments.count - 1));
+	}
+	return getSD(computeIncrements());
+}
+
+bool TimeSeriesTransformations::computeIncrementStandardDeviation(double* standardDeviationValue, Execution execution) const
+{
+	Result<double> result = tryIncrementStandardDeviation(execution);
+	if (!result && result.error() == Status::EmptySeries)
+	{
+		std::cerr << "Empty vector." << '\n';
+	}
+	*standardDeviationValue = result.valueOr(std::numeric_limits<double>::quiet_NaN());
+	return result.error() != Status::EmptySeries;
+}
+
+// function that truncates a given date to only its Y-M-D component (i.e. from datetime to day).
+int TimeSeriesTransformations::truncDate(std::string& date)
+{
+	std::stringstream ss(date);
+
+	// parse the string such that the date Y-M-D H-m-S is broken by the space.
+	getline(ss, date, ' ');
+
+	// we return the first part of the broken string by first converting it to UNIX.
+	return convertToUnix(date);
+}
+
+// function that truncate a UNIX timestamp.
 int TimeSeriesTransformations::truncUnix(int& unix)
 {
-	// we first convert the UNIX to HRD.
-	std::string date = convertToDate(unix);
+	// we first convert the UNIX to HRD.
+	std::string date = convertToDate(unix);
+
+	// we then simply apply truncDate.
+	return truncDate(date);
+}
+
+// function that returns true if the given date is not tricky.
+bool TimeSeriesTransformations::trickyDate(std::string date) const
+{
+	// the old API reports an invalid date by throwing.
+	if (!isValidDate(date))
+	{
+		throw std::runtime_error("Tricky date! The given date is invalid.");
+	}
+	return true;
+}
+
+// function that checks that a date "YYYY-MM-DD", optionally followed by a space and the time "HH:MM" or "HH:MM:SS", exists (such as
+// 2020-02-29 but not 2021-02-29 or 2021-04-31) and that convertToUnix can represent it as an int in any time zone, which leaves the
+// days from 1901-12-15 to 2038-01-17. This is the format convertToDate writes and the old round trip through it accepted, checked by
+// parsing a few digits: no stream, no time conversion and no exception.
+bool TimeSeriesTransformations::isValidDate(const std::string& date)
+{
+	// reads a field of exactly the given number of digits and the character after it.
+	const char* position = date.c_str();
+	auto field = [&position](int digits, char separator, int* value)
+	{
+		*value = 0;
+		for (int d = 0; d < digits; d++, position++)
+		{
+			if (!isdigit((unsigned char)*position))
+			{
+				return false;
+			}
+			*value = *value * 10 + (*position - '0');
+		}
+		if (*position != separator)
+		{
+			return false;
+		}
+		position += (separator != '\0' ? 1 : 0);
+		return true;
+	};
+
+	int year, month, day, hour = 0, minute = 0, second = 0;
+	if (!field(4, '-', &year) || !field(2, '-', &month))
+	{
+		return false;
+	}
+	if (!field(2, '\0', &day))
+	{
+		// the day may only be followed by a space and the time.
+		if (*position != ' ' || !(position++, field(2, ':', &hour)))
+		{
+			return false;
+		}
+		bool seconds = isdigit((unsigned char)position[0]) && isdigit((unsigned char)position[1]) && position[2] == ':';
+		if (seconds ? !field(2, ':', &minute) || !field(2, '\0', &second) : !field(2, '\0', &minute))
+		{
+			return false;
+		}
+	}
+
+	if (month < 1 || month > 12 || day < 1 || hour > 23 || minute > 59 || second > 59)
+	{
+		return false;
+	}
+	static const int daysInMonth[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	if (day > daysInMonth[month - 1] + (month == 2 && leap ? 1 : 0))
+	{
+		return false;
+	}
+
+	// days since 1970-01-01 of the date (H. Hinnant's days_from_civil), then its time as if it were UTC: a time zone moves it by less
+	// than a day, so a day of margin on both sides keeps the result of mktime within an int.
+	int shifted = year - (month <= 2 ? 1 : 0);
+	int era = (shifted >= 0 ? shifted : shifted - 399) / 400;
+	int yearOfEra = shifted - era * 400;
+	int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	long long days = era * 146097LL + dayOfEra - 719468;
+	long long seconds = days * 86400 + hour * 3600 + minute * 60 + second;
+	return seconds - 86400 >= std::numeric_limits<int>::min() && seconds + 86400 <= std::numeric_limits<int>::max();
+}
+
+// function that adds a given share price at a given date.
+void TimeSeriesTransformations::addASharePrice(std::string datetime, double price)
+{
+	// check if the date is not a tricky date. If true, proceed.
+	if (trickyDate(datetime))
+	{
+		// convert HRD to UNIX.
+		int unix = convertToUnix(datetime);
+
+		// insert the pair at the correct place in the series.
+		std::vector<std::pair<int, double>> batch = { { unix , price } };
+		insertPrices(batch);
+	}
+}
+
+// function that adds several prices at once, given their UNIX times.
+void TimeSeriesTransformations::addSharePrices(const std::vector<int>& time, const std::vector<double>& price)
+{
+	if (time.size() != price.size())
+	{
+		throw std::runtime_error("Time and price vectors must be of the same size.");
+	}
+
+	std::vector<std::pair<int, double>> batch(time.size());
+	for (size_t i = 0; i < time.size(); i++)
+	{
+		batch[i] = { time[i], price[i] };
+	}
+	insertPrices(batch);
+}
+
+// function that inserts a batch of pairs. The batch is sorted on its own and merged into the data, which only costs O(batch)
+// when the batch starts after the last pair (the usual case for live data) instead of sorting the whole series again.
+// the result is the same as appending the batch and sorting everything.
+void TimeSeriesTransformations::insertPrices(std::vector<std::pair<int, double>>& batch)
+{
+	if (batch.empty())
+	{
+		return;
+	}
+
+	// with a duplicate policy, the pairs of a time stay in arrival order (stored prices first) so that the first and last can be told apart.
+	bool keepAll = (_duplicatePolicy == DuplicatePolicy::KeepAll);
+	adaptiveSort(batch, !keepAll);
+
+	size_t sizeBefore = _data.size();
+	bool atEnd = sizeBefore == 0 || (keepAll ? !(batch.front() < _data.back()) : batch.front().first >= _data.back().first);
+
+	// only the prices from the first time of the batch onwards can move or become duplicates.
+	size_t from = std::lower_bound(_data.begin(), _data.end(), batch.front(), lessByTime) - _data.begin();
+
+	_data.insert(_data.end(), batch.begin(), batch.end());
+	if (!atEnd)
+	{
+		if (keepAll)
+		{
+			std::inplace_merge(_data.begin() + from, _data.begin() + sizeBefore, _data.end());
+		}
+		else
+		{
+			std::inplace_merge(_data.begin() + from, _data.begin() + sizeBefore, _data.end(), lessByTime);
+		}
+	}
+	if (!keepAll)
+	{
+		collapseDuplicates(from);
+	}
+
+	// prices added at the end only add prices and increments to the sketches and to the range index, anything else changes the increments around them.
+	if (!atEnd || !(keepAll || from == sizeBefore))
+	{
+		dataChanged();
+		return;
+	}
+	if (_sketchesEnabled)
+	{
+		for (size_t i = sizeBefore; i < _data.size(); i++)
+		{
+			_priceSketch.add(_data[i].second);
+			if (i > 0)
+			{
+				_incrementSketch.add(_data[i].second - _data[i - 1].second);
+			}
+		}
+	}
+	_rangeIndex.append(_data, sizeBefore);
+	_extremumIndex.append(_data);
+}
+
+// function that sorts the data after it was read or given, applying the duplicate policy. Files are usually sorted already, in which case
+// this is a single check. With a duplicate policy the sort is by time only and stable, so the pairs of a time keep the order in which they were read.
+void TimeSeriesTransformations::sortData()
+{
+	adaptiveSort(_data, _duplicatePolicy != DuplicatePolicy::KeepAll);
+	collapseDuplicates(0);
+}
+
+// function that replaces each run of pairs with the same time, from index "from" on, by a single pair according to the duplicate policy.
+// this is a single unique-style pass that compacts the data in place.
+size_t TimeSeriesTransformations::collapseDuplicates(size_t from)
+{
+	size_t n = _data.size();
+	if (_duplicatePolicy == DuplicatePolicy::KeepAll || from >= n)
+	{
+		return 0;
+	}
+
+	size_t write = from;
+	size_t read = from;
+	while (read < n)
+	{
+		size_t end = read + 1;
+		double sum = _data[read].second;
+		while (end < n && _data[end].first == _data[read].first)
+		{
+			sum += _data[end].second;
+			end++;
+		}
+
+		switch (_duplicatePolicy)
+		{
+		case DuplicatePolicy::KeepFirst:
+			_data[write] = _data[read];
+			break;
+		case DuplicatePolicy::KeepLast:
+			_data[write] = _data[end - 1];
+			break;
+		default:
+			_data[write] = { _data[read].first, sum / (end - read) };
+			break;
+		}
+		write++;
+		read = end;
+	}
+	_data.resize(write);
+	return n - write;
+}
+
+// function that sets the duplicate policy and applies it to the data already stored.
+void TimeSeriesTransformations::setDuplicatePolicy(DuplicatePolicy policy)
+{
+	_duplicatePolicy = policy;
+	if (collapseDuplicates(0) > 0)
+	{
+		dataChanged();
+	}
+}
+
+DuplicatePolicy TimeSeriesTransformations::getDuplicatePolicy() const
+{
+	return _duplicatePolicy;
+}
+
+// funciton that removes a pair date-price at a given time.
+Result<size_t> TimeSeriesTransformations::tryRemoveEntryAtTime(const std::string& time)
+{
+	if (!isValidDate(time))
+	{
+		return Status::InvalidDate;
+	}
+	return tryRemoveEntryAtTime(convertToUnix(time));
+}
+
+Result<size_t> TimeSeriesTransformations::tryRemoveEntryAtTime(int unix)
+{
+	size_t size_before = _data.size();
+	_data.erase(std::remove_if(_data.begin(), _data.end(), [unix](const std::pair<int, double>& pair) { return pair.first == unix; }), _data.end());
+	if (size_before == _data.size())
+	{
+		return Status::NothingRemoved;
+	}
+	dataChanged();
+	return size_before - _data.size();
+}
+
+bool TimeSeriesTransformations::removeEntryAtTime(std::string time)
+{
+	// an invalid date still throws, as it always has.
+	trickyDate(time);
+
+	if (!tryRemoveEntryAtTime(time))
+	{
+		std::cerr << "The given time is missing." << '\n';
+		return false;
+	}
+	return true;
+}
+
+// function to remove all prices greater than a given double (exclusive). The procedure is the same as in remove entry at time, but with a change in the conditional statement (line 546).
+Result<size_t> TimeSeriesTransformations::tryRemovePricesGreaterThan(double price)
+{
+	size_t size_before = _data.size();
+	_data.erase(std::remove_if(_data.begin(), _data.end(), [price](const std::pair<int, double>& pair) { return pair.second > price; }), _data.end());
+	if (size_before == _data.size())
+	{
+		return Status::NothingRemoved;
+	}
+	dataChanged();
+	return size_before - _data.size();
+}
+
+bool TimeSeriesTransformations::removePricesGreaterThan(double price)
+{
+	if (!tryRemovePricesGreaterThan(price))
+	{
+		std::cerr << "The given price is lower than all prices in the series." << '\n';
+		return false;
+	}
+	return true;
+}
+
+// same as the previous function but for prices lower than a given double.
+Result<size_t> TimeSeriesTransformations::tryRemovePricesLowerThan(double price)
+{
+	size_t size_before = _data.size();
+	_data.erase(std::remove_if(_data.begin(), _data.end(), [price](const std::pair<int, double>& pair) { return pair.second < price; }), _data.end());
+	if (size_before == _data.size())
+	{
+		return Status::NothingRemoved;
+	}
+	dataChanged();
+	return size_before - _data.size();
+}
+
+bool TimeSeriesTransformations::removePricesLowerThan(double price)
+{
+	if (!tryRemovePricesLowerThan(price))
+	{
+		std::cerr << "The given price is greater than all prices in the series." << '\n';
+		return false;
+	}
+	return true;
+}
+
+// function to remove prices before a given string date. Same procedure as in the previous functions, but this time we are comparing the data time vector to the given date (converted to UNIX).
+Result<size_t> TimeSeriesTransformations::tryRemovePricesBefore(const std::string& date)
+{
+	if (!isValidDate(date))
+	{
+		return Status::InvalidDate;
+	}
+	return tryRemovePricesBefore(convertToUnix(date));
+}
+
+Result<size_t> TimeSeriesTransformations::tryRemovePricesBefore(int unix)
+{
+	size_t size_before = _data.size();
+	_data.erase(std::remove_if(_data.begin(), _data.end(), [unix](const std::pair<int, double>& pair) { return pair.first < unix; }), _data.end());
+	if (size_before == _data.size())
+	{
+		return Status::NothingRemoved;
+	}
+	dataChanged();
+	return size_before - _data.size();
+}
+
+bool TimeSeriesTransformations::removePricesBefore(std::string date)
+{
+	// an invalid date still throws, as it always has.
+	trickyDate(date);
+
+	if (!tryRemovePricesBefore(date))
+	{
+		std::cerr << "The given date is smaller than all dates in the series." << '\n';
+		return false;
+	}
+	return true;
+}
+
+Result<size_t> TimeSeriesTransformations::tryRemovePricesAfter(const std::string& date)
+{
+	if (!isValidDate(date))
+	{
+		return Status::InvalidDate;
+	}
+	return tryRemovePricesAfter(convertToUnix(date));
+}
+
+Result<size_t> TimeSeriesTransformations::tryRemovePricesAfter(int unix)
+{
+	size_t size_before = _data.size();
+	_data.erase(std::remove_if(_data.begin(), _data.end(), [unix](const std::pair<int, double>& pair) { return pair.first > unix; }), _data.end());
+	if (size_before == _data.size())
+	{
+		return Status::NothingRemoved;
+	}
+	dataChanged();
+	return size_before - _data.size();
+}
+
+bool TimeSeriesTransformations::removePricesAfter(std::string date)
+{
+	// an invalid date still throws, as it always has.
+	trickyDate(date);
+
+	if (!tryRemovePricesAfter(date))
+	{
+		std::cerr << "The given date is larger than all dates in the series." << '\n';
+		return false;
+	}
+	return true;
+}
+
+// function that removes the prices more than threshold standard deviations away from the mean. The first pass computes the mean and
+// standard deviation, the second compacts the data in place.
+Result<size_t> TimeSeriesTransformations::tryRemoveOutliersZScore(double threshold)
+{
+	if (!(threshold > 0))
+	{
+		return Status::InvalidArgument;
+	}
+	if (_data.size() < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	Moments moments = { 0, 0, 0 };
+	for (const std::pair<int, double>& pair : _data)
+	{
+		moments.count++;
+		double delta = pair.second - moments.mean;
+		moments.mean += delta / moments.count;
+		moments.m2 += delta * (pair.second - moments.mean);
+	}
+	double limit = threshold * std::sqrt(moments.m2 / (moments.count - 1));
+	double mean = moments.mean;
+
+	size_t size_before = _data.size();
+	_data.erase(std::remove_if(_data.begin(), _data.end(), [mean, limit](std::pair<int, double> pair) { return std::abs(pair.second - mean) > limit; }), _data.end());
+	if (size_before != _data.size())
+	{
+		dataChanged();
+	}
+	return size_before - _data.size();
+}
+
+bool TimeSeriesTransformations::removeOutliersZScore(double threshold, size_t* removed)
+{
+	Result<size_t> result = tryRemoveOutliersZScore(threshold);
+	if (!result)
+	{
+		std::cerr << (result.error() == Status::InvalidArgument ? "The threshold must be positive." : "At least two prices are needed to compute a standard deviation.") << '\n';
+	}
+	else if (removed != nullptr)
+	{
+		*removed = *result;
+	}
+	return result.hasValue();
+}
+
+// function that removes the prices far from the median of the window prices before them (see OutlierFilter::rollingMAD), in a single pass
+// that compacts the data in place.
+Result<size_t> TimeSeriesTransformations::tryRemoveOutliersMAD(size_t window, double threshold)
+{
+	if (!(threshold > 0) || window < 3)
+	{
+		return Status::InvalidArgument;
+	}
+
+	OutlierFilter filter = OutlierFilter::rollingMAD(window, threshold);
+	size_t kept = 0;
+	for (size_t i = 0; i < _data.size(); i++)
+	{
+		if (filter.accept(_data[i].second))
+		{
+			_data[kept++] = _data[i];
+		}
+	}
+	_data.resize(kept);
+
+	if (filter.rejected() > 0)
+	{
+		dataChanged();
+	}
+	return filter.rejected();
+}
+
+bool TimeSeriesTransformations::removeOutliersMAD(size_t window, double threshold, size_t* removed)
+{
+	Result<size_t> result = tryRemoveOutliersMAD(window, threshold);
+	if (!result)
+	{
+		std::cerr << "The threshold must be positive and the window hold at least three prices." << '\n';
+	}
+	else if (removed != nullptr)
+	{
+		*removed = *result;
+	}
+	return result.hasValue();
+}
+
+// function that removes isolated spikes: prices that jump more than threshold standard deviations of the increments away from the last
+// kept price and then jump back by as much in the other direction. The first pass computes the mean and standard deviation of the
+// increments, the second compacts the data in place. A lasting jump is not a spike and is kept.
+Result<size_t> TimeSeriesTransformations::tryRemoveIncrementSpikes(double threshold)
+{
+	if (!(threshold > 0))
+	{
+		return Status::InvalidArgument;
+	}
+	if (_data.size() < 3)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	Moments moments = { 0, 0, 0 };
+	for (size_t i = 1; i < _data.size(); i++)
+	{
+		double increment = _data[i].second - _data[i - 1].second;
+		moments.count++;
+		double delta = increment - moments.mean;
+		moments.mean += delta / moments.count;
+		moments.m2 += delta * (increment - moments.mean);
+	}
+	double limit = threshold * std::sqrt(moments.m2 / (moments.count - 1));
+	double mean = moments.mean;
+
+	// the first and last prices have no increment on one side and are always kept.
+	size_t size_before = _data.size();
+	size_t kept = 1;
+	for (size_t i = 1; i < size_before; i++)
+	{
+		if (i + 1 < size_before)
+		{
+			double in = _data[i].second - _data[kept - 1].second - mean;
+			double out = _data[i + 1].second - _data[i].second - mean;
+			if (std::abs(in) > limit && std::abs(out) > limit && (in > 0) != (out > 0))
+			{
+				continue;
+			}
+		}
+		_data[kept++] = _data[i];
+	}
+	_data.resize(kept);
+
+	if (size_before != kept)
+	{
+		dataChanged();
+	}
+	return size_before - kept;
+}
+
+bool TimeSeriesTransformations::removeIncrementSpikes(double threshold, size_t* removed)
+{
+	Result<size_t> result = tryRemoveIncrementSpikes(threshold);
+	if (!result)
+	{
+		std::cerr << (result.error() == Status::InvalidArgument ? "The threshold must be positive." : "At least three prices are needed to find spikes.") << '\n';
+	}
+	else if (removed != nullptr)
+	{
+		*removed = *result;
+	}
+	return result.hasValue();
+}
+
+// function that creates a string out of the prices observed in a given date.
+std::string TimeSeriesTransformations::printSharePricesOnDate(std::string date) const
+{
+	if (trickyDate(date))
+	{
+		// we truncate the date so as to return all prices in a given day.
+		int unix = truncDate(date);
+
+		// create the string to store the prices.
+		std::string prices = "";
+
+		for (int i = 0; i < _data.size(); i++)
+		{
+			// we select the prices for the truncated times equal to the given date truncated.
+			if (truncUnix(getTime()[i]) == unix)
+			{
+				// perform string arithemtic to concatenate the prices on each new line.
+				prices += std::to_string(getPrice()[i]) + '\n';
+			}
+		}
+
+		// print the prices on new lines.
+		std::cout << prices << '\n';
+
+		// we store the string.
+		return prices;
+	}
+}
+
+// same as PrintPricesOnDate but fro increments.
+std::string TimeSeriesTransformations::printIncrementsOnDate(std::string date) const
+{
+	if (trickyDate(date))
+	{
+		int unix = truncDate(date);
+
+		std::string incerements = "";
+
+		// we set the index i to run while it is less then the data size minus 1, so that if the date corresponds to the last datapoint, we do not go out of range.
+		// this is necessary since, in line 510, we compute the increments using the price at i + 1.
+		for (int i = 0; i < _data.size() - 1; i++)
+		{
+			if (truncUnix(getTime()[i]) == unix)
+			{
+				incerements += std::to_string(getPrice()[i + 1] - getPrice()[i]) + '\n';
+			}
+		}
+		std::cout << incerements << '\n';
+		return incerements;
+	}
+}
+
+// function that finds the greatest price increment in the whole series.
+Result<std::pair<int, double>> TimeSeriesTransformations::tryFindGreatestIncrement() const
+{
+	// there is at least one increment only if there are at least two prices.
+	if (_data.size() < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	// we look for the greatest increment in a single pass over the prices, keeping the first one in case of ties (as max_element does).
+	size_t index = 0;
+	double greatest = _data[1].second - _data[0].second;
+	for (size_t i = 1; i + 1 < _data.size(); i++)
+	{
+		double increment = _data[i + 1].second - _data[i].second;
+		if (increment > greatest)
+		{
+			greatest = increment;
+			index = i;
+		}
+	}
+	return std::make_pair(_data[index].first, greatest);
+}
+
+bool TimeSeriesTransformations::findGreatestIncrements(std::string* date, double* price_increment) const
+{
+	Result<std::pair<int, double>> result = tryFindGreatestIncrement();
+	if (!result)
+	{
+		std::cerr << "The vector of prices must be greater than 1." << '\n';
+
+		// set *price_incerement to nan in this case.
+		*price_increment = std::numeric_limits<double>::quiet_NaN();
+		return false;
+	}
+	*date = convertToDate(result->first);
+	*price_increment = result->second;
+	return true;
+}
+
+// function that finds the k largest and the k smallest increments in one pass. Each side keeps a heap of at most k increments whose
+// top is the one that would be dropped first, so the memory used is O(k) whatever the size of the series.
+Result<size_t> TimeSeriesTransformations::tryTopIncrements(size_t k, std::vector<std::pair<int, double>>* largest, std::vector<std::pair<int, double>>* smallest) const
+{
+	largest->clear();
+	smallest->clear();
+	if (_data.size() < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	// the heaps hold (time, increment) pairs; the largest side is a min-heap and the smallest side a max-heap on the increment.
+	auto greater = [](const std::pair<int, double>& a, const std::pair<int, double>& b) { return a.second > b.second; };
+	auto lower = [](const std::pair<int, double>& a, const std::pair<int, double>& b) { return a.second < b.second; };
+	largest->reserve(k);
+	smallest->reserve(k);
+
+	for (size_t i = 0; i + 1 < _data.size() && k > 0; i++)
+	{
+		std::pair<int, double> increment = { _data[i].first, _data[i + 1].second - _data[i].second };
+
+		if (largest->size() < k)
+		{
+			largest->push_back(increment);
+			std::push_heap(largest->begin(), largest->end(), greater);
+		}
+		else if (increment.second > largest->front().second)
+		{
+			std::pop_heap(largest->begin(), largest->end(), greater);
+			largest->back() = increment;
+			std::push_heap(largest->begin(), largest->end(), greater);
+		}
+
+		if (smallest->size() < k)
+		{
+			smallest->push_back(increment);
+			std::push_heap(smallest->begin(), smallest->end(), lower);
+		}
+		else if (increment.second < smallest->front().second)
+		{
+			std::pop_heap(smallest->begin(), smallest->end(), lower);
+			smallest->back() = increment;
+			std::push_heap(smallest->begin(), smallest->end(), lower);
+		}
+	}
+
+	// sorting a heap with its own comparator gives the largest in decreasing and the smallest in increasing order.
+	std::sort_heap(largest->begin(), largest->end(), greater);
+	std::sort_heap(smallest->begin(), smallest->end(), lower);
+	return largest->size();
+}
+
+bool TimeSeriesTransformations::topIncrements(size_t k, std::vector<std::pair<int, double>>* largest, std::vector<std::pair<int, double>>* smallest) const
+{
+	Result<size_t> result = tryTopIncrements(k, largest, smallest);
+	if (!result)
+	{
+		std::cerr << "The vector of prices must be greater than 1." << '\n';
+	}
+	return result.hasValue();
+}
+
+// function that returns the start of the period of periodSeconds seconds holding a UNIX time. Periods are aligned on the epoch,
+// so with periodSeconds = 86400 this is the start of the UTC day; the division rounds down for times before 1970 too.
+int TimeSeriesTransformations::periodStart(int unix, int periodSeconds)
+{
+	long long quotient = (long long)unix / periodSeconds;
+	if ((long long)unix % periodSeconds < 0)
+	{
+		quotient--;
+	}
+	return (int)(quotient * periodSeconds);
+}
+
+// function that finds the greatest increment of each period. As the data is sorted, the increments of a period are contiguous
+// and a single pass is enough. As in displayIncrements, the increment price[i + 1] - price[i] belongs to the time of i.
+Result<std::vector<std::pair<int, double>>> TimeSeriesTransformations::tryGreatestIncrementPerPeriod(int periodSeconds) const
+{
+	if (periodSeconds < 1)
+	{
+		return Status::InvalidArgument;
+	}
+	if (_data.size() < 2)
+	{
+		return Status::NotEnoughPrices;
+	}
+
+	std::vector<std::pair<int, double>> increments;
+	int currentPeriod = 0;
+	for (size_t i = 0; i + 1 < _data.size(); i++)
+	{
+		std::pair<int, double> increment = { _data[i].first, _data[i + 1].second - _data[i].second };
+		int period = periodStart(_data[i].first, periodSeconds);
+
+		if (increments.empty() || period != currentPeriod)
+		{
+			increments.push_back(increment);
+			currentPeriod = period;
+		}
+		else if (increment.second > increments.back().second)
+		{
+			increments.back() = increment;
+		}
+	}
+	return increments;
+}
+
+bool TimeSeriesTransformations::greatestIncrementPerPeriod(int periodSeconds, std::vector<std::pair<int, double>>* increments) const
+{
+	Result<std::vector<std::pair<int, double>>> result = tryGreatestIncrementPerPeriod(periodSeconds);
+	if (!result)
+	{
+		std::cerr << (result.error() == Status::InvalidArgument ? "The period must be at least one second." : "The vector of prices must be greater than 1.") << '\n';
+	}
+	*increments = result.take();
+	return result.hasValue();
+}
+
+// function that computes per-period aggregates in one walk over the sorted data. The period of each point is found with integer
+// arithmetic (periodStart) rather than by converting times to dates, and the means and standard deviations are updated as the
+// points arrive (Welford), so nothing but the table of aggregates is allocated.
+Result<std::vector<PeriodAggregate>> TimeSeriesTransformations::tryAggregateByPeriod(int periodSeconds) const
+{
+	if (periodSeconds < 1)
+	{
+		return Status::InvalidArgument;
+	}
+
+	std::vector<PeriodAggregate> aggregates;
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+
+	// running sums of squared differences to the mean of the prices and of the increments of the current period.
+	double m2 = 0, incrementM2 = 0;
+
+	for (size_t i = 0; i < _data.size(); i++)
+	{
+		int time = _data[i].first;
+		double price = _data[i].second;
+		int period = periodStart(time, periodSeconds);
+
+		if (aggregates.empty() || aggregates.back().periodStart != period)
+		{
+			aggregates.push_back({ period, 0, time, time, price, price, price, price, 0.0, nan, 0, nan, nan, nan });
+			m2 = 0;
+			incrementM2 = 0;
+		}
+		PeriodAggregate& aggregate = aggregates.back();
 
-	// we then simply apply truncDate.
-	return truncDate(date);
-}
+		aggregate.count++;
+		aggregate.lastTime = time;
+		aggregate.last = price;
+		aggregate.min = std::min(aggregate.min, price);
+		aggregate.max = std::max(aggregate.max, price);
 
-// function that returns true if the given date is not tricky.
-bool TimeSeriesTransformations::trickyDate(std::string date) const
-{
-	// parse the date and keep only the day.
-	std::stringstream ss(date);
-	getline(ss, date, ' ');
-	std::string day = date;
+		double delta = price - aggregate.mean;
+		aggregate.mean += delta / aggregate.count;
+		m2 += delta * (price - aggregate.mean);
 
-	// convert the day to unix. If the day is invalid (such as 30th Feb, or 31st April), then convertToUnix will return a different day (such as 2nd March or 1st May).
-	int unix = convertToUnix(day);
-	
-	// we convert it back to day in string and parse it so that we are only left with the day part.
-	std::string helper = convertToDate(unix);
-	std::stringstream ss1(helper);
-	getline(ss1, helper, ' ');
+		// the increment starting at this point (the last point of the series has none).
+		if (i + 1 < _data.size())
+		{
+			double increment = _data[i + 1].second - price;
+			aggregate.incrementCount++;
+			if (aggregate.incrementCount == 1)
+			{
+				aggregate.incrementMean = 0;
+				aggregate.greatestIncrement = increment;
+			}
+			aggregate.greatestIncrement = std::max(aggregate.greatestIncrement, increment);
 
-	// we store it as newDate.
-	std::string newDay = helper;
+			double incrementDelta = increment - aggregate.incrementMean;
+			aggregate.incrementMean += incrementDelta / aggregate.incrementCount;
+			incrementM2 += incrementDelta * (increment - aggregate.incrementMean);
+		}
 
-	// if the input day is equal to the new day, then the input is a valid date. Return true.
-	if (newDay == date)
-	{
-		return true;
+		// the standard deviations are kept up to date so that the period is complete whenever the next one starts.
+		aggregate.standardDeviation = sqrt(m2 / (aggregate.count - 1));
+		aggregate.incrementStandardDeviation = (aggregate.incrementCount > 0 ? sqrt(incrementM2 / (aggregate.incrementCount - 1)) : nan);
 	}
-	// otherwise throw an error.
-	else
+	return aggregates;
+}
+
+bool TimeSeriesTransformations::aggregateByPeriod(int periodSeconds, std::vector<PeriodAggregate>* aggregates) const
+{
+	Result<std::vector<PeriodAggregate>> result = tryAggregateByPeriod(periodSeconds);
+	if (!result)
 	{
-		throw std::runtime_error("Tricky date! The given date is invalid.");
-		return false;
+		std::cerr << "The period must be at least one second." << '\n';
 	}
+	*aggregates = result.take();
+	return result.hasValue();
 }
 
-// function that adds a given share price at a given date.
-void TimeSeriesTransformations::addASharePrice(std::string datetime, double price)
+// function that gets a price given a date.
+Result<double> TimeSeriesTransformations::tryGetPriceAtDate(const std::string& date) const
 {
-	// check if the date is not a tricky date. If true, proceed.
-	if (trickyDate(datetime))
+	if (!isValidDate(date))
 	{
-		// convert HRD to UNIX.
-		int unix = convertToUnix(datetime);
+		return Status::InvalidDate;
+	}
+	int unix = convertToUnix(date);
+
+	// the data is sorted, so the first price at that time is found by binary search.
+	auto element = std::lower_bound(_data.begin(), _data.end(), unix, [](const std::pair<int, double>& pair, int time) { return pair.first < time; });
+	if (element == _data.end() || element->first != unix)
+	{
+		return Status::DateNotFound;
+	}
+	return element->second;
+}
 
-		// pushback the pair in the TST data.
-		_data.push_back({ unix , price });
+bool TimeSeriesTransformations::getPriceAtDate(const std::string date, double* value) const
+{
+	trickyDate(date);
 
-		// sort the data so that the pair ends up at the correct place in the series.
-		std::sort(_data.begin(), _data.end());
+	Result<double> result = tryGetPriceAtDate(date);
+	if (!result)
+	{
+		std::cerr << "The given date is missing.";
 	}
+
+	// if error occurs, set *value to nan.
+	*value = result.valueOr(std::numeric_limits<double>::quiet_NaN());
+	return result.hasValue();
 }
 
-// funciton that removes a pair date-price at a given time.
-bool TimeSeriesTransformations::removeEntryAtTime(std::string time)
+// function that computes several quantiles of a vector at once. The probabilities are visited in increasing order so that each
+// nth_element only has to look at the part of the vector above the previous quantile. Between two order statistics the quantile
+// is interpolated linearly (the usual "type 7" definition, which gives the median of an even number of values as the mean of the middle two).
+void TimeSeriesTransformations::exactQuantiles(std::vector<double>& values, const std::vector<double>& probabilities, std::vector<double>* quantiles)
 {
-	if (trickyDate(time))
+	std::vector<size_t> order(probabilities.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&probabilities](size_t a, size_t b) { return probabilities[a] < probabilities[b]; });
+
+	quantiles->assign(probabilities.size(), 0.0);
+	auto first = values.begin();
+	for (size_t index : order)
 	{
-		// convert HRD to UNIX.
-		int unix = convertToUnix(time);
+		double h = probabilities[index] * (values.size() - 1);
+		size_t lower = (size_t)std::floor(h);
 
-		// store the size of the data now for future comparison.
-		size_t size_before = _data.size();
+		std::nth_element(first, values.begin() + lower, values.end());
+		double lowerValue = values[lower];
 
-		// over the whole data range, check which time is equal to the given UNIX and erase it.
-		_data.erase(std::remove_if(_data.begin(), _data.end(), [unix](std::pair<int, double> pair) { return pair.first == unix; }), _data.end());
+		// the next order statistic is the smallest value above the lower one.
+		double upperValue = (lower + 1 < values.size() ? *std::min_element(values.begin() + lower + 1, values.end()) : lowerValue);
 
-		try
-		{
-			// if the size of the data is changed, that means that an element was erased, which means that the given time was found within the time of the data.
-			if (size_before != _data.size())
-			{
-				return true;
-			}
-			else
-			{
-				// otherwise throw an error.
-				throw std::runtime_error("The given time is missing.");
-			}
-		}
-		catch (const std::runtime_error& error)
+		(*quantiles)[index] = lowerValue + (h - lower) * (upperValue - lowerValue);
+		first = values.begin() + lower;
+	}
+}
+
+// function that computes quantiles of the prices on a scratch copy of the price column.
+Result<std::vector<double>> TimeSeriesTransformations::tryQuantiles(const std::vector<double>& probabilities) const
+{
+	if (_data.empty())
+	{
+		return Status::EmptySeries;
+	}
+	for (double q : probabilities)
+	{
+		if (!(q >= 0 && q <= 1))
 		{
-			// catch the error and print the message to the console.
-			std::cerr << error.what() << '\n';
-			return false;
+			return Status::InvalidArgument;
 		}
 	}
+
+	std::vector<double> scratch = getPrice();
+	std::vector<double> values;
+	exactQuantiles(scratch, probabilities, &values);
+	return values;
 }
 
-// function to remove all prices greater than a given double (exclusive). The procedure is the same as in remove entry at time, but with a change in the conditional statement (line 546).
-bool TimeSeriesTransformations::removePricesGreaterThan(double price)
+bool TimeSeriesTransformations::quantiles(const std::vector<double>& probabilities, std::vector<double>* values) const
 {
-	size_t size_before = _data.size();
+	Result<std::vector<double>> result = tryQuantiles(probabilities);
+	if (!result)
+	{
+		std::cerr << (result.error() == Status::InvalidArgument ? "Quantiles must be between 0 and 1." : "Empty vector.") << '\n';
+	}
+	*values = result.take();
+	if (!result)
+	{
+		values->assign(probabilities.size(), std::numeric_limits<double>::quiet_NaN());
+	}
+	return result.hasValue();
+}
 
-	_data.erase(std::remove_if(_data.begin(), _data.end(), [price](std::pair<int, double> pair) { return pair.second > price; }), _data.end());
+bool TimeSeriesTransformations::quantile(double q, double* value) const
+{
+	std::vector<double> values;
+	bool found = quantiles({ q }, &values);
+	*value = values[0];
+	return found;
+}
 
-	try
+// same as quantiles but on a scratch vector of increments.
+Result<std::vector<double>> TimeSeriesTransformations::tryIncrementQuantiles(const std::vector<double>& probabilities) const
+{
+	if (_data.size() < 2)
 	{
-		if (size_before != _data.size())
-		{
-			return true;
-		}
-		else
+		return Status::NotEnoughPrices;
+	}
+	for (double q : probabilities)
+	{
+		if (!(q >= 0 && q <= 1))
 		{
-			throw std::runtime_error("The given price is lower than all prices in the series.");
+			return Status::InvalidArgument;
 		}
 	}
-	catch (const std::runtime_error& error)
+
+	std::vector<double> scratch = computeIncrements();
+	std::vector<double> values;
+	exactQuantiles(scratch, probabilities, &values);
+	return values;
+}
+
+bool TimeSeriesTransformations::incrementQuantiles(const std::vector<double>& probabilities, std::vector<double>* values) const
+{
+	Result<std::vector<double>> result = tryIncrementQuantiles(probabilities);
+	if (!result)
 	{
-		std::cerr << error.what() << '\n';
-		return false;
+		std::cerr << (result.error() == Status::InvalidArgument ? "Quantiles must be between 0 and 1." : "The vector of prices must be greater than 1.") << '\n';
+	}
+	*values = result.take();
+	if (!result)
+	{
+		values->assign(probabilities.size(), std::numeric_limits<double>::quiet_NaN());
 	}
+	return result.hasValue();
 }
 
-// same as the previous function but for prices lower than a given double.
-bool TimeSeriesTransformations::removePricesLowerThan(double price)
+bool TimeSeriesTransformations::incrementQuantile(double q, double* value) const
 {
-	size_t size_before = _data.size();
-	_data.erase(std::remove_if(_data.begin(), _data.end(), [price](std::pair<int, double> pair) { return pair.second < price; }), _data.end());
+	std::vector<double> values;
+	bool found = incrementQuantiles({ q }, &values);
+	*value = values[0];
+	return found;
+}
 
-	try
+// function that counts the increments falling in bins of equal width. edges receives the bins + 1 bin edges.
+Result<size_t> TimeSeriesTransformations::tryIncrementHistogram(int bins, std::vector<double>* edges, std::vector<int>* counts) const
+{
+	edges->clear();
+	counts->clear();
+	if (bins < 1)
 	{
-		if (size_before != _data.size())
-		{
-			return true;
-		}
-		else
-		{
-			throw std::invalid_argument("The given price is greater than all prices in the series.");
-		}
+		return Status::InvalidArgument;
 	}
-	catch (const std::invalid_argument& error)
+	if (_data.size() < 2)
 	{
-		std::cerr << error.what() << '\n';
-		return false;
+		return Status::NotEnoughPrices;
+	}
+
+	// first pass: range of the increments.
+	double lowest = std::numeric_limits<double>::infinity();
+	double highest = -std::numeric_limits<double>::infinity();
+	for (size_t i = 0; i + 1 < _data.size(); i++)
+	{
+		double increment = _data[i + 1].second - _data[i].second;
+		lowest = std::min(lowest, increment);
+		highest = std::max(highest, increment);
+	}
+
+	double width = (highest - lowest) / bins;
+	edges->resize(bins + 1);
+	for (int b = 0; b <= bins; b++)
+	{
+		(*edges)[b] = lowest + b * width;
 	}
+	(*edges)[bins] = highest;
+
+	// second pass: count. The highest increment belongs to the last bin.
+	counts->assign(bins, 0);
+	for (size_t i = 0; i + 1 < _data.size(); i++)
+	{
+		double increment = _data[i + 1].second - _data[i].second;
+		int b = (width > 0 ? (int)((increment - lowest) / width) : 0);
+		(*counts)[std::min(b, bins - 1)]++;
+	}
+	return _data.size() - 1;
 }
 
-// function to remove prices before a given string date. Same procedure as in the previous functions, but this time we are comparing the data time vector to the given date (converted to UNIX).
-bool TimeSeriesTransformations::removePricesBefore(std::string date)
+bool TimeSeriesTransformations::incrementHistogram(int bins, std::vector<double>* edges, std::vector<int>* counts) const
 {
-	if (trickyDate(date))
+	Result<size_t> result = tryIncrementHistogram(bins, edges, counts);
+	if (!result)
 	{
-		int unix = convertToUnix(date);
+		std::cerr << (result.error() == Status::InvalidArgument ? "The number of bins must be at least 1." : "The vector of prices must be greater than 1.") << '\n';
+	}
+	return result.hasValue();
+}
 
-		size_t size_before = _data.size();
-		_data.erase(std::remove_if(_data.begin(), _data.end(), [unix](std::pair<int, double> pair) { return pair.first < unix; }), _data.end());
+// function that turns the sketches on and fills them with the current data.
+void TimeSeriesTransformations::enableSketches(double compression)
+{
+	_priceSketch = TDigest(compression);
+	_incrementSketch = TDigest(compression);
+	_sketchesEnabled = true;
+	rebuildSketches();
+}
 
-		try
-		{
-			if (size_before != _data.size())
-			{
-				return true;
-			}
-			else
-			{
-				throw std::runtime_error("The given date is smaller than all dates in the series.");
-			}
-		}
-		catch (const std::runtime_error& error)
+void TimeSeriesTransformations::disableSketches()
+{
+	_priceSketch.clear();
+	_incrementSketch.clear();
+	_sketchesEnabled = false;
+}
+
+// function called after the data is changed anywhere but at the end: the sketches are rebuilt and the range indexes are dropped, to be built
+// again by the next range query.
+void TimeSeriesTransformations::dataChanged()
+{
+	_rangeIndexReady.store(false, std::memory_order_release);
+	_extremumIndexReady.store(false, std::memory_order_release);
+	_rangeIndex.clear();
+	_extremumIndex.clear();
+	rebuildSketches();
+}
+
+void TimeSeriesTransformations::rebuildSketches()
+{
+	if (!_sketchesEnabled)
+	{
+		return;
+	}
+
+	_priceSketch.clear();
+	_incrementSketch.clear();
+	for (size_t i = 0; i < _data.size(); i++)
+	{
+		_priceSketch.add(_data[i].second);
+		if (i > 0)
 		{
-			std::cerr << error.what() << '\n';
-			return false;
+			_incrementSketch.add(_data[i].second - _data[i - 1].second);
 		}
 	}
+	_priceSketch.compress();
+	_incrementSketch.compress();
 }
 
-bool TimeSeriesTransformations::removePricesAfter(std::string date)
+// the approximate quantiles return false when the sketches are off or empty.
+bool TimeSeriesTransformations::sketchQuantile(double q, double* value) const
 {
-	if (trickyDate(date))
-	{
-		int unix = convertToUnix(date);
-		size_t size_before = _data.size();
-		_data.erase(std::remove_if(_data.begin(), _data.end(), [unix](std::pair<int, double> pair) { return pair.first > unix; }), _data.end());
+	*value = (_sketchesEnabled ? _priceSketch.quantile(q) : std::numeric_limits<double>::quiet_NaN());
+	return !std::isnan(*value);
+}
+
+bool TimeSeriesTransformations::sketchIncrementQuantile(double q, double* value) const
+{
+	*value = (_sketchesEnabled ? _incrementSketch.quantile(q) : std::numeric_limits<double>::quiet_NaN());
+	return !std::isnan(*value);
+}
+
+const TDigest& TimeSeriesTransformations::priceSketch() const
+{
+	return _priceSketch;
+}
+
+const TDigest& TimeSeriesTransformations::incrementSketch() const
+{
+	return _incrementSketch;
+}
 
+// function that builds the range indexes now rather than on the first range query.
+void TimeSeriesTransformations::buildRangeIndex() const
+{
+	buildPrefixSums();
+	buildExtremumIndex();
+}
 
-		try
+void TimeSeriesTransformations::buildPrefixSums() const
+{
+	if (!_rangeIndexReady.load(std::memory_order_acquire))
+	{
+		std::lock_guard<std::mutex> lock(_indexMutex);
+		if (!_rangeIndex.built())
 		{
-			if (size_before != _data.size())
-			{
-				return true;
-			}
-			else
-			{
-				throw std::runtime_error("The given date is larger than all dates in the series.");
-			}
+			_rangeIndex.build(_data);
 		}
-		catch (const std::runtime_error& error)
+		_rangeIndexReady.store(true, std::memory_order_release);
+	}
+}
+
+void TimeSeriesTransformations::buildExtremumIndex() const
+{
+	if (!_extremumIndexReady.load(std::memory_order_acquire))
+	{
+		std::lock_guard<std::mutex> lock(_indexMutex);
+		if (!_extremumIndex.built())
 		{
-			std::cerr << error.what() << '\n';
-			return false;
+			_extremumIndex.build(_data);
 		}
+		_extremumIndexReady.store(true, std::memory_order_release);
 	}
 }
 
-// function that creates a string out of the prices observed in a given date.
-std::string TimeSeriesTransformations::printSharePricesOnDate(std::string date) const
+void TimeSeriesTransformations::clearRangeIndex()
 {
-	if (trickyDate(date))
-	{
-		// we truncate the date so as to return all prices in a given day.
-		int unix = truncDate(date);
+	_rangeIndexReady.store(false, std::memory_order_release);
+	_extremumIndexReady.store(false, std::memory_order_release);
+	_rangeIndex.clear();
+	_extremumIndex.clear();
+}
 
-		// create the string to store the prices.
-		std::string prices = "";
+// the prices from "from" to "to" (inclusive) are found by binary search on the times.
+void TimeSeriesTransformations::rangeBetween(int from, int to, size_t* begin, size_t* end) const
+{
+	*begin = std::lower_bound(_data.begin(), _data.end(), from, [](const std::pair<int, double>& pair, int time) { return pair.first < time; }) - _data.begin();
+	*end = std::upper_bound(_data.begin(), _data.end(), to, [](int time, const std::pair<int, double>& pair) { return time < pair.first; }) - _data.begin();
+	*end = std::max(*begin, *end);
+}
 
-		for (int i = 0; i < _data.size(); i++)
-		{
-			// we select the prices for the truncated times equal to the given date truncated.
-			if (truncUnix(getTime()[i]) == unix)
-			{
-				// perform string arithemtic to concatenate the prices on each new line.
-				prices += std::to_string(getPrice()[i]) + '\n';
-			}
-		}
+size_t TimeSeriesTransformations::countBetween(int from, int to) const
+{
+	size_t begin, end;
+	rangeBetween(from, to, &begin, &end);
+	return end - begin;
+}
 
-		// print the prices on new lines.
-		std::cout << prices << '\n';
+// the range statistics return false, with the value set to NaN, when the window holds too few prices; they print nothing, since they
+// are meant to be called many times (e.g. on every refresh of a dashboard).
+bool TimeSeriesTransformations::meanBetween(int from, int to, double* meanValue) const
+{
+	size_t begin, end;
+	double standardDeviationValue;
+	rangeBetween(from, to, &begin, &end);
+	buildPrefixSums();
+	return _rangeIndex.priceMoments(begin, end, meanValue, &standardDeviationValue);
+}
 
-		// we store the string.
-		return prices;
-	}
+bool TimeSeriesTransformations::standardDeviationBetween(int from, int to, double* standardDeviationValue) const
+{
+	size_t begin, end;
+	double meanValue;
+	rangeBetween(from, to, &begin, &end);
+	buildPrefixSums();
+	_rangeIndex.priceMoments(begin, end, &meanValue, standardDeviationValue);
+	return !std::isnan(*standardDeviationValue);
 }
 
-// same as PrintPricesOnDate but fro increments.
-std::string TimeSeriesTransformations::printIncrementsOnDate(std::string date) const
+bool TimeSeriesTransformations::incrementMeanBetween(int from, int to, double* meanValue) const
 {
-	if (trickyDate(date))
-	{
-		int unix = truncDate(date);
+	size_t begin, end;
+	double standardDeviationValue;
+	rangeBetween(from, to, &begin, &end);
+	buildPrefixSums();
+	return _rangeIndex.incrementMoments(begin, end, meanValue, &standardDeviationValue);
+}
 
-		std::string incerements = "";
+bool TimeSeriesTransformations::incrementStandardDeviationBetween(int from, int to, double* standardDeviationValue) const
+{
+	size_t begin, end;
+	double meanValue;
+	rangeBetween(from, to, &begin, &end);
+	buildPrefixSums();
+	_rangeIndex.incrementMoments(begin, end, &meanValue, standardDeviationValue);
+	return !std::isnan(*standardDeviationValue);
+}
 
-		// we set the index i to run while it is less then the data size minus 1, so that if the date corresponds to the last datapoint, we do not go out of range.
-		// this is necessary since, in line 510, we compute the increments using the price at i + 1.
-		for (int i = 0; i < _data.size() - 1; i++)
+// the extremum queries find the positions of the window by binary search and the extremum in it from the extremum index.
+bool TimeSeriesTransformations::minBetween(int from, int to, double* value, int* time) const
+{
+	size_t begin, end;
+	rangeBetween(from, to, &begin, &end);
+	*value = std::numeric_limits<double>::quiet_NaN();
+	if (begin < end)
+	{
+		buildExtremumIndex();
+		size_t i = _extremumIndex.lowestPrice(_data, begin, end);
+		*value = _data[i].second;
+		if (time != nullptr)
 		{
-			if (truncUnix(getTime()[i]) == unix)
-			{
-				incerements += std::to_string(getPrice()[i + 1] - getPrice()[i]) + '\n';
-			}
+			*time = _data[i].first;
 		}
-		std::cout << incerements << '\n';
-		return incerements;
 	}
+	return !std::isnan(*value);
 }
 
-// function that finds the greatest price increment in the whole series.
-bool TimeSeriesTransformations::findGreatestIncrements(std::string* date, double* price_increment) const
+bool TimeSeriesTransformations::maxBetween(int from, int to, double* value, int* time) const
 {
-	// compute and store the increments.
-	std::vector<double> increments = computeIncrements();
-
-	// find and store the greatest element over the whole increments.
-	auto greatestElement = std::max_element(increments.begin(), increments.end());
-	
-
-	try
+	size_t begin, end;
+	rangeBetween(from, to, &begin, &end);
+	*value = std::numeric_limits<double>::quiet_NaN();
+	if (begin < end)
 	{
-		// return true only if the price vector is greater than 1 (which implies that the increments vector size will be greater than 0).
-		if (getPrice().size() > 1)
+		buildExtremumIndex();
+		size_t i = _extremumIndex.highestPrice(_data, begin, end);
+		*value = _data[i].second;
+		if (time != nullptr)
 		{
-			// find the index of the greatest element.
-			auto index = std::distance(increments.begin(), greatestElement);
-
-			*date = convertToDate(_data[index].first);
-			*price_increment = *greatestElement;
-			return true;
-		}
-		else
-		{    
-			// throw an error if increments size is 0.
-			throw std::runtime_error("The vector of prices must be greater than 1.");
+			*time = _data[i].first;
 		}
 	}
-	catch (const std::runtime_error& error)
+	return !std::isnan(*value);
+}
+
+// the increments of the window are those between two of its prices.
+bool TimeSeriesTransformations::smallestIncrementBetween(int from, int to, std::pair<int, double>* increment) const
+{
+	size_t begin, end;
+	rangeBetween(from, to, &begin, &end);
+	*increment = { 0, std::numeric_limits<double>::quiet_NaN() };
+	if (end - begin >= 2)
 	{
-		std::cerr << error.what() << '\n';
+		buildExtremumIndex();
+		size_t i = _extremumIndex.smallestIncrement(_data, begin, end - 1);
+		*increment = { _data[i].first, _data[i + 1].second - _data[i].second };
+	}
+	return !std::isnan(increment->second);
+}
 
-		// set *price_incerement to nan in this case.
-		*price_increment = std::numeric_limits<double>::quiet_NaN();
-		return false;
+bool TimeSeriesTransformations::greatestIncrementBetween(int from, int to, std::pair<int, double>* increment) const
+{
+	size_t begin, end;
+	rangeBetween(from, to, &begin, &end);
+	*increment = { 0, std::numeric_limits<double>::quiet_NaN() };
+	if (end - begin >= 2)
+	{
+		buildExtremumIndex();
+		size_t i = _extremumIndex.greatestIncrement(_data, begin, end - 1);
+		*increment = { _data[i].first, _data[i + 1].second - _data[i].second };
 	}
+	return !std::isnan(increment->second);
 }
 
-// function that gets a price given a date.
-bool TimeSeriesTransformations::getPriceAtDate(const std::string date, double* value) const
+// function that exports a slice of the series through the Arrow C Data Interface. The rows are pairs, so the columns Arrow expects are
+// built here in one pass; the buffers then belong to the exported arrays and live until the consumer releases them.
+Result<size_t> TimeSeriesTransformations::tryExportArrow(ArrowSchema* schema, ArrowArray* array, size_t offset, size_t length) const
 {
-	if (trickyDate(date))
+	if (offset > _data.size())
 	{
-		std::string date1 = date;
-		int unix = convertToUnix(date1);
+		return Status::InvalidArgument;
+	}
+	length = std::min(length, _data.size() - offset);
 
-		// find the element matching the unix.
-		auto element = std::find_if(_data.begin(), _data.end(), [unix](std::pair<int, double> pair) {return pair.first == unix; });
-		try
-		{
-			// if the iterator is equal to _data.end(), then no element matching the unix was found.
-			if (element == _data.end())
-			{
-				//throw error.
-				throw std::runtime_error("The given date is missing.");
-			}
-			else
-			{
-				// otheriwise get the index of the element and return true.
-				auto index = std::distance(_data.begin(), element);
-				*value = getPrice()[index];
-				return true;
-			}
-		}
-		catch (const std::runtime_error& error)
-		{
-			std::cerr << error.what();
-			// if error occurs, set *value to nan.
-			*value = std::numeric_limits<double>::quiet_NaN();
-			return false;
-		}
+	std::vector<int64_t> times(length);
+	std::vector<double> prices(length);
+	for (size_t i = 0; i < length; i++)
+	{
+		times[i] = _data[offset + i].first;
+		prices[i] = _data[offset + i].second;
 	}
+	ArrowSeries::exportColumns(_name, std::move(times), std::move(prices), schema, array);
+	return length;
+}
+
+bool TimeSeriesTransformations::exportArrow(ArrowSchema* schema, ArrowArray* array, size_t offset, size_t length) const
+{
+	Result<size_t> result = tryExportArrow(schema, array, offset, length);
+	if (!result)
+	{
+		std::cerr << "The offset is beyond the end of the series." << '\n';
+	}
+	return result.hasValue();
 }
 
 // we save the data.
@@ -851,6 +3210,11 @@ void TimeSeriesTransformations::saveDataHumanDate(std::string filename) const
 	return;
 }
 
+void TimeSeriesTransformations::saveDataHumanDate(std::string filename, size_t points, DownsampleMethod method) const
+{
+	downsampled(points, method).saveDataHumanDate(filename);
+}
+
 // get separator function.
 char TimeSeriesTransformations::getSeparator() const
 {
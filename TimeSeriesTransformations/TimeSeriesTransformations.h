@@ -2,6 +2,97 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <future>
+#include "TDigest.h"
+#include "OutlierFilter.h"
+#include "Result.h"
+#include "RangeIndex.h"
+#include "ExtremumIndex.h"
+
+struct ArrowSchema;
+struct ArrowArray;
+class LoadCache;
+
+// how the whole-series statistics are computed. Default uses the mode set with TimeSeriesTransformations::setDefaultExecution.
+enum class Execution { Default, Serial, Parallel };
+
+// aggregates of the prices and increments of one period, as returned by TimeSeriesTransformations::aggregateByPeriod.
+// the increment price[i + 1] - price[i] belongs to the period holding the time of i.
+struct PeriodAggregate
+{
+    int periodStart;                    // UNIX time at which the period starts.
+    int count;                          // number of prices in the period.
+    int firstTime;                      // time of the first and last prices of the period.
+    int lastTime;
+    double first;                       // first and last prices of the period.
+    double last;
+    double min;                         // lowest and highest prices of the period.
+    double max;
+    double mean;                        // mean and sample standard deviation of the prices of the period.
+    double standardDeviation;
+    int incrementCount;                 // number of increments of the period.
+    double incrementMean;               // mean and sample standard deviation of the increments of the period.
+    double incrementStandardDeviation;
+    double greatestIncrement;           // greatest increment of the period.
+};
+
+// kind of return computed by the return transforms, for prices p and a lag k:
+// Difference p[i + k] - p[i], Log ln(p[i + k] / p[i]), Percentage p[i + k] / p[i] - 1, Cumulative p[i + k] / p[0] - 1.
+enum class ReturnType { Difference, Log, Percentage, Cumulative };
+
+// how the autocovariance is computed: directly in O(n * lags), or with a fast Fourier transform in O(n log n).
+// Automatic picks the cheaper of the two for the size of the series and the number of lags.
+enum class AutocorrelationMethod { Automatic, Direct, FFT };
+
+// how reindex fills a grid time without a price: with the last price before it, by linear interpolation between the prices around it,
+// or with NaN. A grid time before the first price, or whose gap is larger than the maximum gap, is always NaN.
+enum class FillMethod { Forward, Linear, NaN };
+
+// how downsample picks the points drawn for a series too long to plot. The prices are split into buckets of consecutive prices;
+// LargestTriangle keeps in each bucket the price making the largest triangle with the price kept in the bucket before and the average of
+// the bucket after (Largest-Triangle-Three-Buckets, which follows the shape of the series), and MinMax keeps the lowest and highest
+// prices of each bucket (which keeps every spike). Both keep the first and last prices.
+enum class DownsampleMethod { LargestTriangle, MinMax };
+
+// what a series does with several prices at the same time: keeps them all (ordered by price), keeps the first or the last one received,
+// or replaces them by their average.
+enum class DuplicatePolicy { KeepAll, KeepFirst, KeepLast, Average };
+
+// a tile of a matrix computed by TimeSeriesTransformations::incrementCovarianceTiles: "rows" x "columns" values stored row by row,
+// for the rows and columns starting at firstRow and firstColumn. The values only live during the call that receives the tile.
+struct MatrixTile
+{
+    size_t firstRow;
+    size_t firstColumn;
+    size_t rows;
+    size_t columns;
+    const double* values;
+};
+
+// options of TimeSeriesTransformations::load and TimeSeriesTransformations::loadAsync.
+struct LoadOptions
+{
+    // set to true (from any thread) to stop a load in progress, which then throws std::runtime_error("Loading cancelled.").
+    std::shared_ptr<std::atomic<bool>> cancel{};
+
+    // called after each chunk is parsed, with the number of bytes parsed so far and the size of the file.
+    std::function<void(size_t bytesRead, size_t totalBytes)> progress{};
+
+    // number of bytes read from the disk at a time.
+    size_t chunkSize = size_t(1) << 20;
+
+    // duplicate policy of the loaded series, applied when the rows are sorted.
+    DuplicatePolicy duplicates = DuplicatePolicy::KeepAll;
+
+    // filter applied to the rows in file order as they are parsed; the rejected rows are never stored (accepts everything by default).
+    OutlierFilter filter{};
+};
 
 class TimeSeriesTransformations
 {
@@ -18,6 +109,26 @@ private:
 
     // set desired precision.
     const int decimalPlaces = 5;
+
+    // optional sketches of the prices and of the increments, kept up to date by the functions that change the data.
+    TDigest _priceSketch{};
+    TDigest _incrementSketch{};
+    bool _sketchesEnabled = false;
+
+    // what to do with prices at the same time, applied whenever the data is sorted or merged.
+    DuplicatePolicy _duplicatePolicy = DuplicatePolicy::KeepAll;
+
+    // optional prefix sums for the range statistics, built by the first of them and extended when prices are added at the end.
+    mutable RangeIndex _rangeIndex{};
+
+    // optional index of the extremums for the range minimum and maximum queries, built and kept up to date in the same way.
+    mutable ExtremumIndex _extremumIndex{};
+
+    // the const range queries build the indexes on first use, possibly from several threads at once (e.g. the readers of a shared
+    // snapshot): the builds are done under the mutex, and the flags tell without locking that an index is built.
+    mutable std::mutex _indexMutex;
+    mutable std::atomic<bool> _rangeIndexReady{ false };
+    mutable std::atomic<bool> _extremumIndexReady{ false };
  
     // below are functions to be used within the class;
 
@@ -38,6 +149,77 @@ private:
 
     // function to check tricky dates.
     bool trickyDate(std::string date) const;
+
+    // count, mean and sum of squared differences to the mean of a set of values (partial moments that can be merged).
+    struct Moments
+    {
+        double count;
+        double mean;
+        double m2;
+    };
+
+    // merges the moments of two disjoint sets of values (Chan et al. pairwise update).
+    static Moments mergeMoments(const Moments& a, const Moments& b);
+
+    // moments of the n values returned by value(i), computed in chunks on the thread pool and merged pairwise.
+    template <typename Value>
+    static Moments parallelMoments(size_t n, Value value);
+
+    // true if a statistic over n values should run on the thread pool.
+    static bool runInParallel(Execution execution, size_t n);
+
+    // inserts a batch of pairs at their place in the series (the batch is reordered).
+    void insertPrices(std::vector<std::pair<int, double>>& batch);
+
+    // sorts the data by time and applies the duplicate policy.
+    void sortData();
+
+    // collapses the pairs with the same time from the given index on, according to the duplicate policy. Returns the number of pairs removed.
+    size_t collapseDuplicates(size_t from);
+
+    // rebuilds the sketches from the whole series.
+    void rebuildSketches();
+
+    // called after the data is changed anywhere but at the end: rebuilds the sketches and drops the range indexes.
+    void dataChanged();
+
+    // indexes of the first price at or after "from" and one past the last price at or before "to".
+    void rangeBetween(int from, int to, size_t* begin, size_t* end) const;
+
+    // build the prefix sums or the extremum index if it is not built yet (each query builds only the one it reads).
+    void buildPrefixSums() const;
+    void buildExtremumIndex() const;
+
+    // start of the period of periodSeconds seconds (aligned on the epoch) holding a UNIX time.
+    static int periodStart(int unix, int periodSeconds);
+
+    // computes the autocovariances at lags 0 to maxLag of a vector of values, which is centred in place.
+    static void autocovarianceOf(std::vector<double>& values, int maxLag, AutocorrelationMethod method, std::vector<double>* autocovariances);
+
+    // computes the given quantiles of a vector of values, which is reordered in place.
+    static void exactQuantiles(std::vector<double>& values, const std::vector<double>& probabilities, std::vector<double>* quantiles);
+
+    // moments of the prices and of the increments, computed in chunks on the thread pool.
+    Moments parallelPriceMoments() const;
+    Moments parallelIncrementMoments() const;
+
+    // the compressed representation reads and rebuilds _data directly.
+    friend class CompressedSeries;
+
+    // the real-time series merges its batches of ticks with insertPrices.
+    friend class RealTimeSeries;
+
+    // the partitioned store writes _data and loads partitions into it directly.
+    friend class PartitionedStore;
+
+    // so does the binary file format.
+    friend class BinarySeriesFile;
+
+    // and the cache of parsed files.
+    friend class LoadCache;
+
+    // the query server reads the prices of a day from _data directly.
+    friend class QueryServer;
  
 public:
     
@@ -50,20 +232,32 @@ public:
     };
 
     // constructor that creates a TimeSeriesTransformations object from a given external file.
-    explicit TimeSeriesTransformations(const std::string& filenameandpath);
+    explicit TimeSeriesTransformations(const std::string& filenameandpath, DuplicatePolicy duplicates = DuplicatePolicy::KeepAll);
+
+    // function that loads a file like the file constructor, reading the next chunk of the file while the current one is parsed.
+    static TimeSeriesTransformations load(const std::string& filenameandpath, const LoadOptions& options = LoadOptions());
+
+    // same as load but on another thread: the future holds the series (or the exception thrown while loading).
+    static std::future<TimeSeriesTransformations> loadAsync(const std::string& filenameandpath, LoadOptions options = LoadOptions());
 
     // second constructor for data given from two vectors and a name rather than from an external file. 
-    TimeSeriesTransformations(const std::vector<int>& time, const std::vector<double>& price, std::string name = "");
+    TimeSeriesTransformations(const std::vector<int>& time, const std::vector<double>& price, std::string name = "", DuplicatePolicy duplicates = DuplicatePolicy::KeepAll);
 
     // Copy Constructor.
     TimeSeriesTransformations(const TimeSeriesTransformations& t);
 
+    // Move Constructor (used when a loaded series is handed over, e.g. by a future).
+    TimeSeriesTransformations(TimeSeriesTransformations&& t) noexcept;
+
     // Destructor
     virtual ~TimeSeriesTransformations();
 
     // overloaded = operator.
     TimeSeriesTransformations& operator=(const TimeSeriesTransformations& t);
 
+    // move assignment.
+    TimeSeriesTransformations& operator=(TimeSeriesTransformations&& t) noexcept;
+
     // a function which returns the price vector.
     std::vector<double> getPrice() const;
 
@@ -88,33 +282,97 @@ public:
     // this is the inverse of the above and converts a given human readable date into a UNIX timestamp.
     static int convertToUnix(const std::string& date);
 
+    // function that returns true if a date "YYYY-MM-DD", optionally followed by " HH:MM" or " HH:MM:SS", exists (such as 2020-02-29,
+    // but not 2021-02-29) and fits the int times of the series (from 1901-12-15 to 2038-01-17). It never throws.
+    static bool isValidDate(const std::string& date);
+
     // function that displays the vector of pairs time-price (here time is displayed in human readable dates).
     void displayData() const;
 
+    // same but only displays at most "points" representative prices (see DownsampleMethod).
+    void displayData(size_t points, DownsampleMethod method = DownsampleMethod::LargestTriangle) const;
+
     // function that displays the price vector.
     void displayPrice() const;
 
     // function to compute the mean of the price vector.
-    bool mean(double* meanValue) const;
+    bool mean(double* meanValue, Execution execution = Execution::Default) const;
 
     // fucntion that computes the standard deviation of prices.
-    bool standardDeviation(double* standardDeviationValue) const;
+    bool standardDeviation(double* standardDeviationValue, Execution execution = Execution::Default) const;
 
     // function that computed the increments of the price vector.
     std::vector<double> computeIncrements() const;
 
+    // function that writes the returns at lag k (count() - lag values) into a caller buffer of the given size.
+    bool computeReturns(ReturnType type, int lag, double* values, size_t size) const;
+
+    // function that returns the returns at lag k in a new vector.
+    std::vector<double> computeReturns(ReturnType type, int lag = 1) const;
+
+    // function that returns the returns at lag k as a new series (return i is dated at the time of price i).
+    TimeSeriesTransformations returnsSeries(ReturnType type, int lag = 1) const;
+
+    // function that projects the prices onto the regular grid start + i * step (i < size), writing into caller buffers (times may be null).
+    // maxGap (0 for no limit) is the largest distance to the price carried forward, or between the two prices interpolated.
+    bool reindex(int start, int step, FillMethod fill, int maxGap, int* times, double* prices, size_t size) const;
+
+    // function that returns the series reindexed on a grid of "step" seconds from its first time to its last time.
+    TimeSeriesTransformations reindexed(int step, FillMethod fill = FillMethod::Forward, int maxGap = 0) const;
+
+    // function that reduces the prices between two UNIX times (inclusive) to at most "points" representative ones in a single pass,
+    // writing them in time order into caller buffers of that size (times may be null). Returns the number of prices written.
+    size_t downsample(int from, int to, size_t points, DownsampleMethod method, int* times, double* prices) const;
+
+    // function that returns the series, or its prices between two UNIX times (inclusive), reduced to at most "points" prices.
+    TimeSeriesTransformations downsampled(size_t points, DownsampleMethod method = DownsampleMethod::LargestTriangle) const;
+    TimeSeriesTransformations downsampledBetween(int from, int to, size_t points, DownsampleMethod method = DownsampleMethod::LargestTriangle) const;
+
+    // function that computes the mean and standard deviation of the returns at lag k in a single pass, without storing them.
+    bool returnStatistics(ReturnType type, int lag, double* meanValue, double* standardDeviationValue) const;
+
+    // function that computes the autocovariance of the prices at lags 0 to maxLag (biased estimator, divided by the number of prices).
+    bool autocovariance(int maxLag, std::vector<double>* values, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+
+    // function that computes the autocorrelation of the prices at lags 0 to maxLag.
+    bool autocorrelation(int maxLag, std::vector<double>* values, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+
+    // same as autocovariance and autocorrelation but for the increments.
+    bool incrementAutocovariance(int maxLag, std::vector<double>* values, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+    bool incrementAutocorrelation(int maxLag, std::vector<double>* values, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+
+    // function that computes the covariance (or correlation) matrix of the increments of several series sampled on a common grid of "step"
+    // seconds, handing it over in tiles (on and above the diagonal only) instead of storing it. onTile is called one tile at a time.
+    static bool incrementCovarianceTiles(const std::vector<const TimeSeriesTransformations*>& series, int step, bool correlation,
+        const std::function<void(const MatrixTile&)>& onTile);
+
+    // same as incrementCovarianceTiles, gathered into the full matrix (row-major, series.size() x series.size()).
+    static bool incrementCovarianceMatrix(const std::vector<const TimeSeriesTransformations*>& series, int step, std::vector<double>* matrix, bool correlation = false);
+
+    // function that computes the correlation matrix of the increments of several series sampled on a common grid.
+    static bool incrementCorrelationMatrix(const std::vector<const TimeSeriesTransformations*>& series, int step, std::vector<double>* matrix);
+
     // function that displays increments.
     void displayIncrements() const;
 
     // function that computes the mean of the increments.
-    bool computeIncrementMean(double* meanValue) const;
+    bool computeIncrementMean(double* meanValue, Execution execution = Execution::Default) const;
 
     // function that computes the standard deviation of the increments.
-    bool computeIncrementStandardDeviation(double* standardDeviationValue) const;
+    bool computeIncrementStandardDeviation(double* standardDeviationValue, Execution execution = Execution::Default) const;
 
     // function to add a share price given a date and a time.
     void addASharePrice(std::string datetime, double price);
 
+    // function that adds several prices given their UNIX times (in any order), merging them into the series in one go.
+    void addSharePrices(const std::vector<int>& time, const std::vector<double>& price);
+
+    // function that sets the duplicate policy, which is applied at once to the data stored and then to every price added.
+    void setDuplicatePolicy(DuplicatePolicy policy);
+
+    // function that returns the duplicate policy.
+    DuplicatePolicy getDuplicatePolicy() const;
+
     // function that removes an entry at a given time;
     bool removeEntryAtTime(std::string time);
 
@@ -130,6 +388,15 @@ public:
     // function that removes all prices after a given date.
     bool removePricesAfter(std::string date);
 
+    // function that removes the prices more than threshold standard deviations away from the mean (two passes over the data).
+    bool removeOutliersZScore(double threshold, size_t* removed = nullptr);
+
+    // function that removes the prices more than threshold * 1.4826 * MAD away from the median of the window prices before them (one pass).
+    bool removeOutliersMAD(size_t window, double threshold, size_t* removed = nullptr);
+
+    // function that removes isolated spikes, whose increments in and out are both larger than threshold standard deviations of the increments (two passes).
+    bool removeIncrementSpikes(double threshold, size_t* removed = nullptr);
+
     // function that prints the share price on a given date.
     std::string printSharePricesOnDate(std::string date) const;
 
@@ -139,16 +406,173 @@ public:
     // function that finds the greatest incerement in the series of prices on a given date.
     bool findGreatestIncrements(std::string* date, double* price_increment) const;
 
+    // function that finds the k largest increments (in decreasing order) and the k smallest increments (in increasing order), as (time, increment) pairs.
+    bool topIncrements(size_t k, std::vector<std::pair<int, double>>* largest, std::vector<std::pair<int, double>>* smallest) const;
+
+    // function that finds the greatest increment of each period of periodSeconds seconds (86400 for UTC days), as (time, increment) pairs.
+    bool greatestIncrementPerPeriod(int periodSeconds, std::vector<std::pair<int, double>>* increments) const;
+
+    // function that aggregates the prices and increments of each period of periodSeconds seconds (86400 for UTC days) in a single pass over the data.
+    bool aggregateByPeriod(int periodSeconds, std::vector<PeriodAggregate>* aggregates) const;
+
     // function that returns the price at a given date (in case of multiple prices on a date, it returns the price of the last time in that day).
     bool getPriceAtDate(const std::string date, double* value) const;
 
+    // the functions below report ordinary failures (an empty series, an invalid or missing date, nothing to remove) through their
+    // Result instead of throwing or printing. The functions above with the same purpose are thin wrappers around them.
+    // the standard deviation and the increment mean fail with Status::NotEnoughPrices below two prices, and the increment standard
+    // deviation below three (the wrappers above still give NaN there without failing).
+    Result<double> tryMean(Execution execution = Execution::Default) const;
+    Result<double> tryStandardDeviation(Execution execution = Execution::Default) const;
+    Result<double> tryIncrementMean(Execution execution = Execution::Default) const;
+    Result<double> tryIncrementStandardDeviation(Execution execution = Execution::Default) const;
+
+    // the price at a date (the first one if there are several prices at that time).
+    Result<double> tryGetPriceAtDate(const std::string& date) const;
+
+    // the greatest increment, as the pair (time of the price it starts from, increment).
+    Result<std::pair<int, double>> tryFindGreatestIncrement() const;
+
+    // the removals return the number of prices removed.
+    Result<size_t> tryRemoveEntryAtTime(const std::string& time);
+    Result<size_t> tryRemovePricesGreaterThan(double price);
+    Result<size_t> tryRemovePricesLowerThan(double price);
+    Result<size_t> tryRemovePricesBefore(const std::string& date);
+    Result<size_t> tryRemovePricesAfter(const std::string& date);
+
+    // same removals by UNIX time, as replayed by the write-ahead log (no date to convert, so no time zone involved).
+    Result<size_t> tryRemoveEntryAtTime(int unix);
+    Result<size_t> tryRemovePricesBefore(int unix);
+    Result<size_t> tryRemovePricesAfter(int unix);
+
+    // the analyses and filters below fail with Status::InvalidArgument when an argument is out of its range (a lag below 1, a step, period,
+    // threshold or number of bins that is not positive, a quantile outside [0, 1], a buffer too small, an offset past the end) and with
+    // Status::NotEnoughPrices (Status::EmptySeries for the quantiles of the prices) when the series is too short for them.
+    // the returns written into values, and their number.
+    Result<size_t> tryComputeReturns(ReturnType type, int lag, double* values, size_t size) const;
+
+    // the grid written into times and prices, and its size.
+    Result<size_t> tryReindex(int start, int step, FillMethod fill, int maxGap, int* times, double* prices, size_t size) const;
+
+    // the mean and standard deviation of the returns, which need at least two returns.
+    Result<std::pair<double, double>> tryReturnStatistics(ReturnType type, int lag) const;
+
+    // the autocovariances and autocorrelations at lags 0 to maxLag.
+    Result<std::vector<double>> tryAutocovariance(int maxLag, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+    Result<std::vector<double>> tryAutocorrelation(int maxLag, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+    Result<std::vector<double>> tryIncrementAutocovariance(int maxLag, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+    Result<std::vector<double>> tryIncrementAutocorrelation(int maxLag, AutocorrelationMethod method = AutocorrelationMethod::Automatic) const;
+
+    // the tiles handed to onTile, and the number of increments of each series on the grid (EmptySeries if one of them is empty).
+    static Result<size_t> tryIncrementCovarianceTiles(const std::vector<const TimeSeriesTransformations*>& series, int step, bool correlation,
+        const std::function<void(const MatrixTile&)>& onTile);
+
+    // the filters return the number of prices removed. Unlike the removals above, removing nothing is a success (0), as a clean
+    // series is the usual case for them.
+    Result<size_t> tryRemoveOutliersZScore(double threshold);
+    Result<size_t> tryRemoveOutliersMAD(size_t window, double threshold);
+    Result<size_t> tryRemoveIncrementSpikes(double threshold);
+
+    // the increments written into largest and smallest, and the number on each side.
+    Result<size_t> tryTopIncrements(size_t k, std::vector<std::pair<int, double>>* largest, std::vector<std::pair<int, double>>* smallest) const;
+
+    // the greatest increment and the aggregates of each period.
+    Result<std::vector<std::pair<int, double>>> tryGreatestIncrementPerPeriod(int periodSeconds) const;
+    Result<std::vector<PeriodAggregate>> tryAggregateByPeriod(int periodSeconds) const;
+
+    // the quantiles of the prices and of the increments.
+    Result<std::vector<double>> tryQuantiles(const std::vector<double>& probabilities) const;
+    Result<std::vector<double>> tryIncrementQuantiles(const std::vector<double>& probabilities) const;
+
+    // the histogram written into edges and counts, and the number of increments counted.
+    Result<size_t> tryIncrementHistogram(int bins, std::vector<double>* edges, std::vector<int>* counts) const;
+
+    // the slice exported into schema and array, and its number of rows.
+    Result<size_t> tryExportArrow(ArrowSchema* schema, ArrowArray* array, size_t offset = 0, size_t length = SIZE_MAX) const;
+
+    // function that exports the rows offset to offset + length (all the rows from offset by default) as an Arrow C Data Interface struct
+    // array of "time" and "price" columns (see ArrowSeries). The columns are copied once out of the rows; the consumer frees them by
+    // calling the release callbacks.
+    bool exportArrow(ArrowSchema* schema, ArrowArray* array, size_t offset = 0, size_t length = SIZE_MAX) const;
+
     // function that saves the data.
     void saveData(std::string filename) const;
 
     // function that saves the data but instead of unix uses human readable date.
     void saveDataHumanDate(std::string filename) const;
 
+    // same but only saves at most "points" representative prices (see DownsampleMethod).
+    void saveDataHumanDate(std::string filename, size_t points, DownsampleMethod method = DownsampleMethod::LargestTriangle) const;
+
     // gets the separator of the file loaded.
     char getSeparator() const;
 
+    // sets the execution mode used by the statistics when they are called with Execution::Default (Serial unless changed).
+    static void setDefaultExecution(Execution execution);
+
+    // sets the number of values below which the parallel statistics fall back to serial.
+    static void setParallelThreshold(size_t threshold);
+
+    // function that sets the cache of parsed files used by the file constructor and by load (null, the default, for none).
+    // loads with an outlier filter always parse the file.
+    static void setLoadCache(std::shared_ptr<LoadCache> cache);
+
+    // function that returns the cache of parsed files in use.
+    static std::shared_ptr<LoadCache> getLoadCache();
+
+    // function that computes the exact quantile q (0 <= q <= 1) of the prices, e.g. q = 0.5 for the median.
+    bool quantile(double q, double* value) const;
+
+    // same as quantile for several probabilities at once.
+    bool quantiles(const std::vector<double>& probabilities, std::vector<double>* values) const;
+
+    // function that computes the exact quantile q of the increments.
+    bool incrementQuantile(double q, double* value) const;
+
+    // same as incrementQuantile for several probabilities at once.
+    bool incrementQuantiles(const std::vector<double>& probabilities, std::vector<double>* values) const;
+
+    // function that counts the increments in "bins" bins of equal width between the lowest and the highest increment.
+    bool incrementHistogram(int bins, std::vector<double>* edges, std::vector<int>* counts) const;
+
+    // function that starts maintaining t-digest sketches of the prices and of the increments, which then answer approximate quantiles in constant time.
+    void enableSketches(double compression = 100);
+
+    // function that stops maintaining the sketches.
+    void disableSketches();
+
+    // approximate quantiles of the prices and of the increments from the sketches.
+    bool sketchQuantile(double q, double* value) const;
+    bool sketchIncrementQuantile(double q, double* value) const;
+
+    // the sketches themselves, e.g. to merge them across series.
+    const TDigest& priceSketch() const;
+    const TDigest& incrementSketch() const;
+
+    // function that counts the prices between two UNIX times (inclusive), by binary search.
+    size_t countBetween(int from, int to) const;
+
+    // functions that compute the mean and sample standard deviation of the prices, and of the increments between them, between two UNIX
+    // times (inclusive) in O(log n) from the range index. They return false, with the value set to NaN, if the window holds too few prices.
+    bool meanBetween(int from, int to, double* meanValue) const;
+    bool standardDeviationBetween(int from, int to, double* standardDeviationValue) const;
+    bool incrementMeanBetween(int from, int to, double* meanValue) const;
+    bool incrementStandardDeviationBetween(int from, int to, double* standardDeviationValue) const;
+
+    // functions that find the lowest and highest prices between two UNIX times (inclusive) in O(log n) from the extremum index, with the
+    // time of the first of them if time is not null. They return false, with the value set to NaN, if the window holds no price.
+    bool minBetween(int from, int to, double* value, int* time = nullptr) const;
+    bool maxBetween(int from, int to, double* value, int* time = nullptr) const;
+
+    // same for the smallest and greatest increments between the prices of the window, as (time of the price the increment starts from, increment).
+    bool smallestIncrementBetween(int from, int to, std::pair<int, double>* increment) const;
+    bool greatestIncrementBetween(int from, int to, std::pair<int, double>* increment) const;
+
+    // the range indexes are built by the first range query that needs them (the prefix sums by the moments, the extremum index by the
+    // minimums and maximums); this builds both up front, which saves the first queries the wait.
+    void buildRangeIndex() const;
+
+    // function that frees the memory of the range indexes (about four times that of the data) until the next range query.
+    void clearRangeIndex();
+
 };
\ No newline at end of file
@@ -0,0 +1,529 @@
+// WriteAheadLog.cpp : durable log of the changes made to a series, with group commit.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include "WriteAheadLog.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char logMagic[8] = { 'T', 'S', 'T', 'W', 'A', 'L', '0', '1' };
+	const size_t recordSize = 24;
+
+	// an open file, the value returned when a file cannot be opened, and the value of WriteAheadLog::_file when the log is closed.
+#ifdef _WIN32
+	typedef HANDLE FileHandle;
+	const FileHandle noFile = INVALID_HANDLE_VALUE;
+	const FileHandle closedFile = nullptr;
+#else
+	typedef int FileHandle;
+	const FileHandle noFile = -1;
+	const FileHandle closedFile = -1;
+#endif
+
+	size_t roundUpTo8(size_t size)
+	{
+		return (size + 7) / 8 * 8;
+	}
+
+	uint64_t readUint64(const char* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	// FNV-1a hash of the first 20 bytes of a record.
+	uint32_t checksum(const char* record)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < 20; i++)
+		{
+			hash = (hash ^ (unsigned char)record[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+	void encodeRecord(char* record, LogOperation operation, int time, double value, uint64_t sequence)
+	{
+		uint32_t code = (uint32_t)operation;
+		uint32_t sequence32 = (uint32_t)sequence;
+		memcpy(record, &code, 4);
+		memcpy(record + 4, &time, 4);
+		memcpy(record + 8, &value, 8);
+		memcpy(record + 16, &sequence32, 4);
+		uint32_t sum = checksum(record);
+		memcpy(record + 20, &sum, 4);
+	}
+
+	// a record is valid if its checksum matches and it carries the next sequence number, which a torn or stale record cannot.
+	bool decodeRecord(const char* record, uint64_t sequence, LogOperation* operation, int* time, double* value)
+	{
+		uint32_t code, sequence32, sum;
+		memcpy(&code, record, 4);
+		memcpy(time, record + 4, 4);
+		memcpy(value, record + 8, 8);
+		memcpy(&sequence32, record + 16, 4);
+		memcpy(&sum, record + 20, 4);
+		*operation = (LogOperation)code;
+		return sum == checksum(record) && sequence32 == (uint32_t)sequence && code >= (uint32_t)LogOperation::Insert
+			&& code <= (uint32_t)LogOperation::RemovePricesAfter;
+	}
+
+	// where the parts of a log file start, and the number of valid records in it.
+	struct LogLayout
+	{
+		std::string name;
+		size_t rows;
+		size_t times;
+		size_t prices;
+		size_t records;
+		size_t recordCount;
+		size_t end;
+	};
+
+	bool parseLog(const char* data, size_t size, LogLayout* layout)
+	{
+		if (size < 24 || memcmp(data, logMagic, sizeof(logMagic)) != 0)
+		{
+			return false;
+		}
+		uint64_t nameLength = readUint64(data + 8);
+		if (nameLength > size || 16 + roundUpTo8(nameLength) + 8 > size)
+		{
+			return false;
+		}
+		layout->name.assign(data + 16, nameLength);
+		size_t offset = 16 + roundUpTo8(nameLength);
+		uint64_t rows = readUint64(data + offset);
+		offset += 8;
+		if (rows > size / 12)
+		{
+			return false;
+		}
+		layout->rows = (size_t)rows;
+		layout->times = offset;
+		layout->prices = offset + roundUpTo8(layout->rows * sizeof(int32_t));
+		layout->records = layout->prices + layout->rows * sizeof(double);
+		if (layout->records > size)
+		{
+			return false;
+		}
+
+		LogOperation operation;
+		int time;
+		double value;
+		layout->recordCount = 0;
+		layout->end = layout->records;
+		while (layout->end + recordSize <= size && decodeRecord(data + layout->end, layout->recordCount + 1, &operation, &time, &value))
+		{
+			layout->recordCount++;
+			layout->end += recordSize;
+		}
+		return true;
+	}
+
+	FileHandle openFile(const std::string& path, bool create)
+	{
+#ifdef _WIN32
+		return CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+		return ::open(path.c_str(), create ? O_WRONLY | O_CREAT | O_TRUNC : O_WRONLY, 0644);
+#endif
+	}
+
+	void closeFile(FileHandle file)
+	{
+#ifdef _WIN32
+		CloseHandle(file);
+#else
+		::close(file);
+#endif
+	}
+
+	bool writeAll(FileHandle file, const char* data, size_t size)
+	{
+		while (size > 0)
+		{
+#ifdef _WIN32
+			DWORD written = 0;
+			if (!WriteFile(file, data, (DWORD)std::min(size, size_t(1) << 30), &written, nullptr))
+			{
+				return false;
+			}
+#else
+			ssize_t written = ::write(file, data, size);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+#endif
+			data += written;
+			size -= (size_t)written;
+		}
+		return true;
+	}
+
+	bool syncFile(FileHandle file)
+	{
+#ifdef _WIN32
+		return FlushFileBuffers(file) != 0;
+#else
+		return fsync(file) == 0;
+#endif
+	}
+
+	// cuts the file at the given size and leaves the file position there.
+	bool truncateFile(FileHandle file, size_t size)
+	{
+#ifdef _WIN32
+		LARGE_INTEGER position;
+		position.QuadPart = (LONGLONG)size;
+		return SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+#else
+		return ftruncate(file, (off_t)size) == 0 && lseek(file, (off_t)size, SEEK_SET) == (off_t)size;
+#endif
+	}
+
+	bool seekToEnd(FileHandle file)
+	{
+#ifdef _WIN32
+		LARGE_INTEGER zero;
+		zero.QuadPart = 0;
+		return SetFilePointerEx(file, zero, nullptr, FILE_END) != 0;
+#else
+		return lseek(file, 0, SEEK_END) >= 0;
+#endif
+	}
+
+	// moves a file over another in one step, so that a crash leaves one or the other. On POSIX systems the directory is synced too,
+	// so that the move itself is durable.
+	bool replaceFile(const std::string& from, const std::string& to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		if (rename(from.c_str(), to.c_str()) != 0)
+		{
+			return false;
+		}
+		size_t slash = to.find_last_of('/');
+		std::string directory = (slash == std::string::npos ? "." : to.substr(0, slash + 1));
+		int descriptor = ::open(directory.c_str(), O_RDONLY);
+		if (descriptor >= 0)
+		{
+			fsync(descriptor);
+			::close(descriptor);
+		}
+		return true;
+#endif
+	}
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& filenameandpath, const std::string& name, size_t groupSize)
+	: _path(filenameandpath), _groupSize(groupSize)
+{
+	if (!std::ifstream(_path).good())
+	{
+		TimeSeriesTransformations empty;
+		empty.setName(name);
+		writeSnapshot(empty);
+		open();
+		return;
+	}
+
+	size_t size, end;
+	{
+		// the map is closed before the file is opened for writing, which Windows requires.
+		MappedFile file(_path);
+		LogLayout layout;
+		if (!parseLog(file.data(), file.size(), &layout))
+		{
+			throw std::runtime_error("Not a write-ahead log.");
+		}
+		size = file.size();
+		end = layout.end;
+		_appended = _durable = layout.recordCount;
+	}
+
+	// a torn record left by a crash is cut off, so that the next records follow the last valid one.
+	open();
+	if (end < size && !(truncateFile(_file, end) && syncFile(_file)))
+	{
+		close();
+		throw std::runtime_error("Could not write the log.");
+	}
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+	try
+	{
+		commit();
+	}
+	catch (const std::runtime_error& error)
+	{
+		std::cerr << error.what() << '\n';
+	}
+	close();
+}
+
+void WriteAheadLog::open()
+{
+	FileHandle file = openFile(_path, false);
+	if (file == noFile)
+	{
+		throw std::runtime_error("Could not open file.");
+	}
+	_file = file;
+	if (!seekToEnd(_file))
+	{
+		close();
+		throw std::runtime_error("Could not open file.");
+	}
+}
+
+void WriteAheadLog::close()
+{
+	if (_file != closedFile)
+	{
+		closeFile(_file);
+	}
+	_file = closedFile;
+}
+
+void WriteAheadLog::writeSnapshot(const TimeSeriesTransformations& series)
+{
+	std::string name = series.getName();
+	std::vector<int> times = series.getTime();
+	std::vector<double> prices = series.getPrice();
+
+	std::vector<char> buffer(16 + roundUpTo8(name.size()) + 8 + roundUpTo8(times.size() * sizeof(int32_t)) + prices.size() * sizeof(double), 0);
+	uint64_t nameLength = name.size();
+	uint64_t rows = times.size();
+	memcpy(&buffer[0], logMagic, sizeof(logMagic));
+	memcpy(&buffer[8], &nameLength, 8);
+	memcpy(&buffer[16], name.data(), name.size());
+	size_t offset = 16 + roundUpTo8(name.size());
+	memcpy(&buffer[offset], &rows, 8);
+	offset += 8;
+	memcpy(&buffer[offset], times.data(), times.size() * sizeof(int32_t));
+	offset += roundUpTo8(times.size() * sizeof(int32_t));
+	memcpy(&buffer[offset], prices.data(), prices.size() * sizeof(double));
+
+	// the snapshot is written aside and only then moved over the log, so that a crash leaves either the old log or the new one.
+	std::string temporary = _path + ".tmp";
+	FileHandle file = openFile(temporary, true);
+	if (file == noFile)
+	{
+		throw std::runtime_error("Could not open file.");
+	}
+	bool written = writeAll(file, buffer.data(), buffer.size()) && syncFile(file);
+	closeFile(file);
+	if (!written || !replaceFile(temporary, _path))
+	{
+		std::remove(temporary.c_str());
+		throw std::runtime_error("Could not write the log.");
+	}
+}
+
+TimeSeriesTransformations WriteAheadLog::recover(const std::string& filenameandpath, DuplicatePolicy duplicates)
+{
+	MappedFile file(filenameandpath);
+	const char* data = file.data();
+	LogLayout layout;
+	if (!parseLog(data, file.size(), &layout))
+	{
+		throw std::runtime_error("Not a write-ahead log.");
+	}
+
+	std::vector<int> times(layout.rows);
+	std::vector<double> prices(layout.rows);
+	memcpy(times.data(), data + layout.times, layout.rows * sizeof(int32_t));
+	memcpy(prices.data(), data + layout.prices, layout.rows * sizeof(double));
+	TimeSeriesTransformations series(times, prices, layout.name, duplicates);
+
+	// consecutive insertions are replayed as one batch, which is merged at once.
+	std::vector<int> batchTimes;
+	std::vector<double> batchPrices;
+	auto insertBatch = [&]()
+	{
+		if (!batchTimes.empty())
+		{
+			series.addSharePrices(batchTimes, batchPrices);
+			batchTimes.clear();
+			batchPrices.clear();
+		}
+	};
+
+	for (size_t k = 0; k < layout.recordCount; k++)
+	{
+		LogOperation operation;
+		int time;
+		double value;
+		decodeRecord(data + layout.records + k * recordSize, k + 1, &operation, &time, &value);
+		if (operation == LogOperation::Insert)
+		{
+			batchTimes.push_back(time);
+			batchPrices.push_back(value);
+			continue;
+		}
+
+		insertBatch();
+		switch (operation)
+		{
+		case LogOperation::RemoveEntryAtTime:
+			series.tryRemoveEntryAtTime(time);
+			break;
+		case LogOperation::RemovePricesGreaterThan:
+			series.tryRemovePricesGreaterThan(value);
+			break;
+		case LogOperation::RemovePricesLowerThan:
+			series.tryRemovePricesLowerThan(value);
+			break;
+		case LogOperation::RemovePricesBefore:
+			series.tryRemovePricesBefore(time);
+			break;
+		case LogOperation::RemovePricesAfter:
+			series.tryRemovePricesAfter(time);
+			break;
+		default:
+			break;
+		}
+	}
+	insertBatch();
+	return series;
+}
+
+uint64_t WriteAheadLog::append(LogOperation operation, int time, double value)
+{
+	uint64_t sequence;
+	bool commitNow;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_failed)
+		{
+			throw std::runtime_error("Could not write the log.");
+		}
+		sequence = ++_appended;
+		size_t offset = _pending.size();
+		_pending.resize(offset + recordSize);
+		encodeRecord(&_pending[offset], operation, time, value, sequence);
+		commitNow = _groupSize > 0 && _pending.size() >= _groupSize * recordSize;
+	}
+
+	if (commitNow)
+	{
+		commit(sequence);
+	}
+	return sequence;
+}
+
+// group commit: the first thread to find records waiting becomes the leader. It takes every record buffered so far, writes them and
+// syncs the file without holding the lock, so that other threads keep appending meanwhile; the threads that commit in the meantime
+// wait for it and, if their records came too late for its batch, one of them leads the next batch.
+void WriteAheadLog::commit(uint64_t sequence)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	sequence = std::min(sequence, _appended);
+	while (_durable < sequence)
+	{
+		if (_failed)
+		{
+			throw std::runtime_error("Could not write the log.");
+		}
+		if (_syncing)
+		{
+			_synced.wait(lock);
+			continue;
+		}
+
+		_syncing = true;
+		std::vector<char> batch;
+		batch.swap(_pending);
+		uint64_t last = _appended;
+		lock.unlock();
+		bool written = writeAll(_file, batch.data(), batch.size()) && syncFile(_file);
+		lock.lock();
+
+		_syncing = false;
+		if (written)
+		{
+			_durable = last;
+		}
+		else
+		{
+			_failed = true;
+		}
+		_synced.notify_all();
+	}
+	if (_failed && _durable < sequence)
+	{
+		throw std::runtime_error("Could not write the log.");
+	}
+}
+
+void WriteAheadLog::commit()
+{
+	uint64_t sequence;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		sequence = _appended;
+	}
+	commit(sequence);
+}
+
+// the records buffered are dropped rather than written, as the snapshot includes them. The sequence numbers start again from 1.
+void WriteAheadLog::checkpoint(const TimeSeriesTransformations& series)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_synced.wait(lock, [this] { return !_syncing; });
+	if (_failed)
+	{
+		throw std::runtime_error("Could not write the log.");
+	}
+
+	close();
+	try
+	{
+		writeSnapshot(series);
+	}
+	catch (const std::runtime_error&)
+	{
+		// the old log is still in place: keep appending to it.
+		open();
+		throw;
+	}
+	_pending.clear();
+	_appended = 0;
+	_durable = 0;
+	open();
+}
+
+uint64_t WriteAheadLog::appended()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _appended;
+}
+
+uint64_t WriteAheadLog::durable()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _durable;
+}
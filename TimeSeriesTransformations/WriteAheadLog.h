@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include "TimeSeriesTransformations.h"
+
+// change recorded by a WriteAheadLog, with the time and value it applies to (the removals by time do not use the value, and those by
+// price do not use the time).
+enum class LogOperation : uint32_t
+{
+    Insert = 1,
+    RemoveEntryAtTime,
+    RemovePricesGreaterThan,
+    RemovePricesLowerThan,
+    RemovePricesBefore,
+    RemovePricesAfter
+};
+
+// append-only log of the changes made to a series since its last snapshot, which is kept at the start of the same file.
+// layout: magic "TSTWAL01", the length of the name (8 bytes) and the name padded to 8 bytes, the number of rows of the snapshot (8 bytes),
+// the times of the snapshot (int32, padded to 8 bytes) and its prices (double), then records of 24 bytes: operation (uint32), time (int32),
+// value (double), sequence number (uint32) and checksum (uint32). A crash can only leave a torn record at the end, which is dropped.
+// records are buffered as they are appended and written with group commit: commit() writes every record buffered so far by any thread
+// and syncs the file once, and the threads that commit while a sync is in progress are all covered by the next one.
+class WriteAheadLog
+{
+
+private:
+    std::string _path;
+    size_t _groupSize;
+
+    // the log opened to append records (a HANDLE on Windows, a file descriptor elsewhere).
+#ifdef _WIN32
+    void* _file = nullptr;
+#else
+    int _file = -1;
+#endif
+
+    // records appended but not written yet, and the number of records appended and made durable since the snapshot.
+    std::mutex _mutex;
+    std::condition_variable _synced;
+    std::vector<char> _pending{};
+    uint64_t _appended = 0;
+    uint64_t _durable = 0;
+    bool _syncing = false;
+    bool _failed = false;
+
+    // writes a snapshot of the series with no record to a temporary file and moves it over the log.
+    void writeSnapshot(const TimeSeriesTransformations& series);
+
+    // opens the log to append records to it.
+    void open();
+    void close();
+
+public:
+
+    // opens the log file, creating it with an empty snapshot of a series called name if it does not exist, and dropping a torn record
+    // at its end. append commits on its own once groupSize records are buffered (0 to commit only when asked).
+    // throws std::runtime_error if the file cannot be created or is not a log.
+    explicit WriteAheadLog(const std::string& filenameandpath, const std::string& name = "", size_t groupSize = 4096);
+
+    // commits the records still buffered.
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // reads the snapshot of a log file and replays its records onto it, with the given duplicate policy.
+    static TimeSeriesTransformations recover(const std::string& filenameandpath, DuplicatePolicy duplicates = DuplicatePolicy::KeepAll);
+
+    // records a change (from any thread). Returns its sequence number, to be given to commit.
+    uint64_t append(LogOperation operation, int time, double value = 0);
+
+    // waits until the records up to the given sequence number (every record appended so far by default) are on the disk.
+    // throws std::runtime_error("Could not write the log.") if a write or a sync failed, after which the log accepts no more records.
+    void commit(uint64_t sequence);
+    void commit();
+
+    // replaces the snapshot by the given series, which must include every record appended so far, and empties the log.
+    void checkpoint(const TimeSeriesTransformations& series);
+
+    // number of records since the snapshot that were appended, and that are on the disk.
+    uint64_t appended();
+    uint64_t durable();
+
+};
@@ -1,27 +1,419 @@
-using namespace std;
+// TimeSeriesTransformationsApplication.cpp : command-line tool running a pipeline (load, filter, stats, resample, save) over many files.
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
-#include<algorithm>
-#include<numeric>
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <cstdlib>
+#include <stdexcept>
 
-#include "../TimeSeriesTransformations\TimeSeriesTransformations.h"
+#include "../TimeSeriesTransformations/TimeSeriesTransformations.h"
+#include "../TimeSeriesTransformations/BinarySeriesFile.h"
+#include "../TimeSeriesTransformations/QueryServer.h"
 
-template <typename T>
-void print(const std::vector<T>& vector)
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <csignal>
+#endif
+
+namespace
 {
-	int sizeVec = vector.size();
-	for (int i = 0; i < sizeVec; i++)
+	const char* const usage =
+		"usage: TimeSeriesTransformationsApplication [options] file...\n"
+		"runs load, filter, stats, resample and save on each file, several files at once.\n"
+		"  --workers N                 number of files processed at once (default: number of cores)\n"
+		"  --duplicates POLICY         keepall (default), keepfirst, keeplast or average\n"
+		"  --filter zscore:T           removes the prices more than T standard deviations from the mean\n"
+		"  --filter mad:W:T            removes the prices more than T scaled MADs from the median of the W prices before them\n"
+		"  --filter spike:T            removes the isolated spikes of more than T standard deviations of the increments\n"
+		"  --resample SECONDS          reindexes the series on a grid of SECONDS seconds\n"
+		"  --fill METHOD               forward (default), linear or nan, for --resample\n"
+		"  --output DIRECTORY          writes each resulting series to DIRECTORY (not written by default)\n"
+		"  --format FORMAT             csv (default) or binary, for --output\n"
+		"  --serve SOCKET              then keeps the series in memory and answers queries on the Unix domain socket SOCKET until\n"
+		"                              interrupted, each series named after its file (see QueryServer.h for the requests)\n"
+		"with --output or --serve, the files must have different names once their directory and extension are removed.\n"
+		"the statistics of each file are printed to the standard output as CSV, and the time spent in each stage to the standard error.\n";
+
+	enum Stage { Load, Filter, Stats, Resample, Save, StageCount };
+	const char* const stageNames[StageCount] = { "load", "filter", "stats", "resample", "save" };
+
+	struct Options
+	{
+		unsigned workers = std::max(std::thread::hardware_concurrency(), 1u);
+		DuplicatePolicy duplicates = DuplicatePolicy::KeepAll;
+		std::string filter{};
+		double threshold = 0;
+		size_t window = 0;
+		int resample = 0;
+		FillMethod fill = FillMethod::Forward;
+		std::string output{};
+		bool binary = false;
+		std::string serve{};
+		std::vector<std::string> files{};
+	};
+
+	// what happened to one file: its statistics, the rows each stage took in, and the time each stage took.
+	struct FileResult
+	{
+		bool ok = false;
+		std::string error{};
+		size_t bytes = 0;
+		size_t rows[StageCount] = {};
+		double seconds[StageCount] = {};
+		double statistics[6] = {};
+
+		// the resulting series, kept only to be served.
+		std::shared_ptr<TimeSeriesTransformations> series{};
+	};
+
+	// reads the options. Throws std::invalid_argument for an option that cannot be read.
+	Options parseOptions(int argc, char* argv[])
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string argument = argv[i];
+			auto value = [&]() -> std::string
+			{
+				if (i + 1 >= argc)
+				{
+					throw std::invalid_argument(argument + " needs a value.");
+				}
+				return argv[++i];
+			};
+
+			if (argument == "--workers")
+			{
+				options.workers = (unsigned)std::max(std::atoi(value().c_str()), 1);
+			}
+			else if (argument == "--duplicates")
+			{
+				std::string policy = value();
+				if (policy == "keepall") options.duplicates = DuplicatePolicy::KeepAll;
+				else if (policy == "keepfirst") options.duplicates = DuplicatePolicy::KeepFirst;
+				else if (policy == "keeplast") options.duplicates = DuplicatePolicy::KeepLast;
+				else if (policy == "average") options.duplicates = DuplicatePolicy::Average;
+				else throw std::invalid_argument("Unknown duplicate policy " + policy + ".");
+			}
+			else if (argument == "--filter")
+			{
+				std::stringstream ss(value());
+				std::string field;
+				getline(ss, options.filter, ':');
+				if (options.filter == "mad" && getline(ss, field, ':'))
+				{
+					options.window = (size_t)std::atoi(field.c_str());
+				}
+				if (!getline(ss, field) || (options.filter != "zscore" && options.filter != "mad" && options.filter != "spike")
+					|| (options.filter == "mad" && options.window == 0))
+				{
+					throw std::invalid_argument("Unknown filter.");
+				}
+				options.threshold = std::atof(field.c_str());
+			}
+			else if (argument == "--resample")
+			{
+				options.resample = std::atoi(value().c_str());
+				if (options.resample <= 0)
+				{
+					throw std::invalid_argument("The resampling step must be positive.");
+				}
+			}
+			else if (argument == "--fill")
+			{
+				std::string fill = value();
+				if (fill == "forward") options.fill = FillMethod::Forward;
+				else if (fill == "linear") options.fill = FillMethod::Linear;
+				else if (fill == "nan") options.fill = FillMethod::NaN;
+				else throw std::invalid_argument("Unknown fill method " + fill + ".");
+			}
+			else if (argument == "--output")
+			{
+				options.output = value();
+			}
+			else if (argument == "--format")
+			{
+				std::string format = value();
+				if (format != "csv" && format != "binary")
+				{
+					throw std::invalid_argument("Unknown format " + format + ".");
+				}
+				options.binary = (format == "binary");
+			}
+			else if (argument == "--serve")
+			{
+				options.serve = value();
+			}
+			else if (argument.size() > 1 && argument[0] == '-')
+			{
+				throw std::invalid_argument("Unknown option " + argument + ".");
+			}
+			else
+			{
+				options.files.push_back(argument);
+			}
+		}
+		return options;
+	}
+
+	// name of the file without its directory and extension.
+	std::string baseName(const std::string& path)
 	{
-		std::cout << vector[i] << '\n';
+		size_t slash = path.find_last_of("/\\");
+		std::string name = (slash == std::string::npos ? path : path.substr(slash + 1));
+		size_t dot = name.find_last_of('.');
+		return (dot == std::string::npos || dot == 0 ? name : name.substr(0, dot));
+	}
+
+	// runs the pipeline on one file, timing each stage.
+	FileResult process(const std::string& path, const Options& options)
+	{
+		FileResult result;
+		auto clock = std::chrono::steady_clock::now();
+		auto lap = [&clock](double* seconds)
+		{
+			auto now = std::chrono::steady_clock::now();
+			*seconds = std::chrono::duration<double>(now - clock).count();
+			clock = now;
+		};
+
+		try
+		{
+			std::streamoff bytes = std::ifstream(path, std::ios::binary | std::ios::ate).tellg();
+			result.bytes = (size_t)std::max<std::streamoff>(bytes, 0);
+			LoadOptions loadOptions;
+			loadOptions.duplicates = options.duplicates;
+			TimeSeriesTransformations t = TimeSeriesTransformations::load(path, loadOptions);
+			result.rows[Load] = (size_t)t.count();
+			lap(&result.seconds[Load]);
+
+			// the filters run on every worker at once, so they are the ones that report a series too short for them instead of printing it
+			// (such a series is simply left as it is).
+			result.rows[Filter] = (size_t)t.count();
+			if (options.filter == "zscore")
+			{
+				t.tryRemoveOutliersZScore(options.threshold);
+			}
+			else if (options.filter == "mad")
+			{
+				t.tryRemoveOutliersMAD(options.window, options.threshold);
+			}
+			else if (options.filter == "spike")
+			{
+				t.tryRemoveIncrementSpikes(options.threshold);
+			}
+			lap(&result.seconds[Filter]);
+
+			// the statistics are taken with the functions that report an empty series instead of printing it.
+			const double nan = std::numeric_limits<double>::quiet_NaN();
+			result.rows[Stats] = (size_t)t.count();
+			result.statistics[0] = t.tryMean().valueOr(nan);
+			result.statistics[1] = t.tryStandardDeviation().valueOr(nan);
+			result.statistics[2] = t.tryIncrementMean().valueOr(nan);
+			result.statistics[3] = t.tryIncrementStandardDeviation().valueOr(nan);
+			t.minBetween(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), &result.statistics[4]);
+			t.maxBetween(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), &result.statistics[5]);
+			lap(&result.seconds[Stats]);
+
+			if (options.resample > 0)
+			{
+				result.rows[Resample] = (size_t)t.count();
+				t = t.reindexed(options.resample, options.fill);
+				lap(&result.seconds[Resample]);
+			}
+
+			if (!options.output.empty())
+			{
+				result.rows[Save] = (size_t)t.count();
+				std::string name = options.output + "/" + baseName(path);
+				if (options.binary)
+				{
+					BinarySeriesFile::write(t, name + ".tsb");
+				}
+				else
+				{
+					t.saveData(name);
+				}
+				lap(&result.seconds[Save]);
+			}
+			if (!options.serve.empty())
+			{
+				result.series = std::make_shared<TimeSeriesTransformations>(std::move(t));
+			}
+			result.ok = true;
+		}
+		catch (const std::exception& error)
+		{
+			result.error = error.what();
+		}
+		return result;
+	}
+
+	void printTimings(const std::vector<FileResult>& results, const Options& options, double wallSeconds)
+	{
+		size_t totalRows = 0, totalBytes = 0;
+		for (const FileResult& result : results)
+		{
+			totalRows += result.rows[Load];
+			totalBytes += result.bytes;
+		}
+
+		// the stage times are summed over the files, so with several workers they add up to more than the wall clock time.
+		std::cerr << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "seconds" << std::setw(16) << "rows/s" << '\n';
+		for (int stage = 0; stage < StageCount; stage++)
+		{
+			double seconds = 0;
+			size_t rows = 0;
+			for (const FileResult& result : results)
+			{
+				seconds += result.seconds[stage];
+				rows += result.rows[stage];
+			}
+			if (rows == 0 && seconds == 0)
+			{
+				continue;
+			}
+			std::cerr << std::left << std::setw(10) << stageNames[stage] << std::right << std::fixed << std::setprecision(4) << std::setw(12) << seconds
+				<< std::setprecision(0) << std::setw(16) << (seconds > 0 ? rows / seconds : 0.0) << '\n';
+		}
+		std::cerr << std::setprecision(4) << results.size() << " files, " << totalRows << " rows, " << totalBytes / 1e6 << " MB in " << wallSeconds
+			<< " s with " << options.workers << " workers (" << std::setprecision(0) << (wallSeconds > 0 ? totalRows / wallSeconds : 0.0)
+			<< " rows/s, " << std::setprecision(1) << (wallSeconds > 0 ? totalBytes / 1e6 / wallSeconds : 0.0) << " MB/s)\n";
 	}
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-	// READY TO USE.
+	Options options;
+	try
+	{
+		options = parseOptions(argc, argv);
+	}
+	catch (const std::invalid_argument& error)
+	{
+		std::cerr << error.what() << '\n' << usage;
+		return 2;
+	}
+	if (options.files.empty())
+	{
+		std::cerr << usage;
+		return 2;
+	}
+
+	// the files written and the series served are named after the files without their directory, so two files of the same name in
+	// different directories would overwrite each other: this is refused before any file is processed.
+	if (!options.output.empty() || !options.serve.empty())
+	{
+		std::map<std::string, std::string> names;
+		for (const std::string& file : options.files)
+		{
+			auto inserted = names.emplace(baseName(file), file);
+			if (!inserted.second)
+			{
+				std::cerr << file << " and " << inserted.first->second << " would both be named " << inserted.first->first
+					<< " by --output and --serve.\n";
+				return 2;
+			}
+		}
+	}
+
+	if (!options.output.empty())
+	{
+		// the output directory is created if needed (an existing one is fine).
+#ifdef _WIN32
+		_mkdir(options.output.c_str());
+#else
+		mkdir(options.output.c_str(), 0755);
+#endif
+	}
 
-	system("pause>0");
-	return 0;
-}
\ No newline at end of file
+	// each worker takes the next file not taken yet, so that large and small files balance out.
+	std::vector<FileResult> results(options.files.size());
+	std::atomic<size_t> next{ 0 };
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	unsigned workerCount = (unsigned)std::min<size_t>(options.workers, options.files.size());
+	for (unsigned w = 0; w < workerCount; w++)
+	{
+		workers.emplace_back([&]()
+		{
+			for (size_t f = next++; f < options.files.size(); f = next++)
+			{
+				results[f] = process(options.files[f], options);
+			}
+		});
+	}
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int failures = 0;
+	std::cout << "file,rows,mean,standardDeviation,incrementMean,incrementStandardDeviation,min,max\n" << std::setprecision(10);
+	for (size_t f = 0; f < results.size(); f++)
+	{
+		if (!results[f].ok)
+		{
+			std::cerr << options.files[f] << ": " << results[f].error << '\n';
+			failures++;
+			continue;
+		}
+		std::cout << options.files[f] << ',' << results[f].rows[Stats];
+		for (double statistic : results[f].statistics)
+		{
+			std::cout << ',' << statistic;
+		}
+		std::cout << '\n';
+	}
+
+	printTimings(results, options, wallSeconds);
+
+	if (!options.serve.empty())
+	{
+#ifdef __linux__
+		// the signals are blocked before the server starts its threads, so that only sigwait below receives them.
+		sigset_t signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGINT);
+		sigaddset(&signals, SIGTERM);
+		pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+		QueryServer server(options.serve, options.workers);
+		for (size_t f = 0; f < results.size(); f++)
+		{
+			if (results[f].series)
+			{
+				server.add(baseName(options.files[f]), std::move(*results[f].series));
+				results[f].series.reset();
+			}
+		}
+		try
+		{
+			server.start();
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cerr << error.what() << '\n';
+			return 1;
+		}
+		std::cerr << "serving on " << options.serve << '\n';
+#ifdef __linux__
+		int signal;
+		sigwait(&signals, &signal);
+#endif
+		server.stop();
+	}
+	return (failures == 0 ? 0 : 1);
+}
@@ -5,3 +5,4 @@
 #pragma once
 
 #include "gtest/gtest.h"
+#include <math.h>
@@ -7,6 +7,20 @@
 #include<algorithm>
 #include<numeric>
 #include "../TimeSeriesTransformations/TimeSeriesTransformations.h"
+#include "../TimeSeriesTransformations/CompressedSeries.h"
+#include "../TimeSeriesTransformations/RealTimeSeries.h"
+#include "../TimeSeriesTransformations/PartitionedStore.h"
+#include "../TimeSeriesTransformations/BinarySeriesFile.h"
+#include "../TimeSeriesTransformations/ArrowSeries.h"
+#include "../TimeSeriesTransformations/DurableSeries.h"
+#include "../TimeSeriesTransformations/LoadCache.h"
+#include "../TimeSeriesTransformations/QueryServer.h"
+#include <thread>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 
 bool test(double in, double in2) {
@@ -482,4 +496,1776 @@ TEST(TimeSeriesTransformations, printPricesOnTrickyDay)
     std::string date = "1970-02-30 12:25";
 
     EXPECT_THROW(t.printSharePricesOnDate(date), std::runtime_error);
-}
\ No newline at end of file
+}
+
+// we test that compressing and decompressing the examination file gives back the same data, and that the statistics match.
+TEST(TimeSeriesTransformations, compressedSeriesRoundTrip)
+{
+    CompressedSeries c(t, 8);
+    EXPECT_TRUE(c.count() == t.count());
+    EXPECT_TRUE(c.blockCount() == 4);
+    EXPECT_TRUE(c.decompress() == t);
+    EXPECT_TRUE(c.decompress().getTime() == t.getTime());
+    EXPECT_TRUE(c.decompress().getPrice() == t.getPrice());
+
+    double mean, sd, compressedMean, compressedSd;
+    t.mean(&mean);
+    t.standardDeviation(&sd);
+    EXPECT_TRUE(c.mean(&compressedMean));
+    EXPECT_TRUE(c.standardDeviation(&compressedSd));
+    EXPECT_TRUE(test(mean, compressedMean));
+    EXPECT_TRUE(test(sd, compressedSd));
+}
+
+// we test the range queries of a compressed regular series, where only the blocks at the edges of the range are decoded.
+TEST(TimeSeriesTransformations, compressedSeriesRangeQueries)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 1000; i++)
+    {
+        _time.push_back(1619120010 + 5000 * i);
+        _price.push_back(100 + (i % 7) * 0.25);
+    }
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    CompressedSeries c(series, 64);
+
+    // a regular grid with few distinct prices takes much less than 16 bytes per point.
+    EXPECT_TRUE(c.memoryUsage() * 4 < series.count() * sizeof(std::pair<int, double>));
+
+    int from = _time[10], to = _time[500];
+    double sum, mean, lowest, highest, price;
+    EXPECT_TRUE(c.countBetween(from, to) == 491);
+    EXPECT_TRUE(c.sumBetween(from, to, &sum));
+    EXPECT_DOUBLE_EQ(sum, std::accumulate(_price.begin() + 10, _price.begin() + 501, 0.0));
+    EXPECT_TRUE(c.meanBetween(from, to, &mean));
+    EXPECT_DOUBLE_EQ(mean, sum / 491);
+    EXPECT_TRUE(c.minBetween(from, to, &lowest));
+    EXPECT_TRUE(c.maxBetween(from, to, &highest));
+    EXPECT_TRUE(lowest == 100 && highest == 101.5);
+    EXPECT_TRUE(c.getPriceAtTime(_time[123], &price));
+    EXPECT_TRUE(price == _price[123]);
+    EXPECT_FALSE(c.getPriceAtTime(_time[123] + 1, &price));
+    EXPECT_TRUE(isnan(price));
+}
+
+// we test that the parallel statistics give the same results as the serial ones, including the increments that cross the chunk boundaries.
+TEST(TimeSeriesTransformations, parallelStatisticsMatchSerial)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 200000; i++)
+    {
+        _time.push_back(i);
+        _price.push_back(1000 + std::sin(i * 0.01) * 50 + (i % 13) * 0.1);
+    }
+    TimeSeriesTransformations series(_time, _price, "TEST");
+
+    double serial, parallel;
+    series.mean(&serial, Execution::Serial);
+    EXPECT_TRUE(series.mean(&parallel, Execution::Parallel));
+    EXPECT_TRUE(test(serial, parallel));
+
+    series.standardDeviation(&serial, Execution::Serial);
+    EXPECT_TRUE(series.standardDeviation(&parallel, Execution::Parallel));
+    EXPECT_TRUE(test(serial, parallel));
+
+    series.computeIncrementMean(&serial, Execution::Serial);
+    EXPECT_TRUE(series.computeIncrementMean(&parallel, Execution::Parallel));
+    EXPECT_TRUE(test(serial, parallel));
+
+    series.computeIncrementStandardDeviation(&serial, Execution::Serial);
+    EXPECT_TRUE(series.computeIncrementStandardDeviation(&parallel, Execution::Parallel));
+    EXPECT_TRUE(test(serial, parallel));
+}
+
+// we test the global execution mode on the examination file, lowering the threshold so that even 28 points run in parallel.
+TEST(TimeSeriesTransformations, parallelStatisticsDefaultExecution)
+{
+    TimeSeriesTransformations::setParallelThreshold(2);
+    TimeSeriesTransformations::setDefaultExecution(Execution::Parallel);
+
+    double mean, sd, inc_sd;
+    EXPECT_TRUE(t.mean(&mean));
+    EXPECT_TRUE(t.standardDeviation(&sd));
+    EXPECT_TRUE(t.computeIncrementStandardDeviation(&inc_sd));
+    EXPECT_TRUE(test(mean, 52.851881428571438));
+    EXPECT_TRUE(test(sd, 32.997831467128677));
+    EXPECT_TRUE(test(inc_sd, 40.233938872573837));
+
+    // the empty file still fails in parallel mode.
+    EXPECT_FALSE(t1.mean(&mean));
+    EXPECT_TRUE(isnan(mean));
+
+    TimeSeriesTransformations::setDefaultExecution(Execution::Serial);
+    TimeSeriesTransformations::setParallelThreshold(size_t(1) << 17);
+}
+
+// we test the exact quantiles of the prices and of the increments against a sorted copy.
+TEST(TimeSeriesTransformations, exactQuantiles)
+{
+    std::vector<int> _time = { 1 , 2 , 3 , 4 , 5 , 6 };
+    std::vector<double> _price = { 3 , 1 , 6 , 2 , 5 , 4 };
+    TimeSeriesTransformations series(_time, _price, "TEST");
+
+    double median;
+    EXPECT_TRUE(series.quantile(0.5, &median));
+    EXPECT_DOUBLE_EQ(median, 3.5);
+
+    std::vector<double> values;
+    EXPECT_TRUE(series.quantiles({ 1, 0, 0.2 }, &values));
+    EXPECT_TRUE(values[0] == 6 && values[1] == 1);
+    EXPECT_DOUBLE_EQ(values[2], 2);
+
+    // the increments are -2, 5, -4, 3, -1.
+    double incMedian;
+    EXPECT_TRUE(series.incrementQuantile(0.5, &incMedian));
+    EXPECT_DOUBLE_EQ(incMedian, -1);
+
+    EXPECT_FALSE(series.quantile(1.5, &median));
+    EXPECT_TRUE(isnan(median));
+    EXPECT_FALSE(t1.quantile(0.5, &median));
+}
+
+// we test the histogram of the increments.
+TEST(TimeSeriesTransformations, incrementHistogram)
+{
+    std::vector<int> _time = { 1 , 2 , 3 , 4 , 5 , 6 };
+    std::vector<double> _price = { 3 , 1 , 6 , 2 , 5 , 4 };
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    std::vector<double> edges;
+    std::vector<int> counts;
+    EXPECT_TRUE(series.incrementHistogram(3, &edges, &counts));
+    EXPECT_TRUE(edges.size() == 4 && counts.size() == 3);
+    EXPECT_TRUE(edges.front() == -4 && edges.back() == 5);
+    EXPECT_TRUE(counts[0] == 2 && counts[1] == 1 && counts[2] == 2);
+}
+
+// we test that the sketches follow the prices added with addASharePrice and agree with the exact quantiles, also once merged.
+TEST(TimeSeriesTransformations, sketchQuantilesFollowAddedPrices)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 5000; i++)
+    {
+        _time.push_back(i);
+        _price.push_back((i * 7919) % 1000);
+    }
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    series.enableSketches();
+
+    double exact, approximate;
+    series.quantile(0.99, &exact);
+    EXPECT_TRUE(series.sketchQuantile(0.99, &approximate));
+    EXPECT_NEAR(exact, approximate, 5);
+
+    // prices added at the end update the sketches without rebuilding them.
+    for (int i = 0; i < 100; i++)
+    {
+        series.addASharePrice(TimeSeriesTransformations::convertToDate(5000 + i), 5000);
+    }
+    EXPECT_TRUE(series.priceSketch().count() == 5100);
+    EXPECT_TRUE(series.incrementSketch().count() == 5099);
+    EXPECT_TRUE(series.sketchQuantile(1, &approximate));
+    EXPECT_TRUE(approximate == 5000);
+
+    series.removePricesGreaterThan(999);
+    EXPECT_TRUE(series.priceSketch().count() == 5000);
+
+    TDigest merged = series.priceSketch();
+    merged.merge(series.priceSketch());
+    EXPECT_NEAR(merged.quantile(0.5), series.priceSketch().quantile(0.5), 5);
+    EXPECT_TRUE(merged.count() == 10000);
+
+    double sketchInc;
+    EXPECT_TRUE(series.sketchIncrementQuantile(0.5, &sketchInc));
+    EXPECT_FALSE(t.sketchQuantile(0.5, &sketchInc));
+}
+
+// we test the top-k increments on both sides, and that asking for more increments than there are returns them all.
+TEST(TimeSeriesTransformations, topIncrements)
+{
+    std::vector<int> _time = { 1 , 2 , 3 , 4 , 5 , 6 };
+    std::vector<double> _price = { 3 , 1 , 6 , 2 , 5 , 4 };
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    std::vector<std::pair<int, double>> largest, smallest;
+
+    // the increments are -2, 5, -4, 3, -1 at times 1 to 5.
+    EXPECT_TRUE(series.topIncrements(2, &largest, &smallest));
+    EXPECT_TRUE(largest.size() == 2 && smallest.size() == 2);
+    EXPECT_TRUE(largest[0] == std::make_pair(2, 5.0) && largest[1] == std::make_pair(4, 3.0));
+    EXPECT_TRUE(smallest[0] == std::make_pair(3, -4.0) && smallest[1] == std::make_pair(1, -2.0));
+
+    EXPECT_TRUE(series.topIncrements(10, &largest, &smallest));
+    EXPECT_TRUE(largest.size() == 5 && largest.back().second == -4);
+
+    TimeSeriesTransformations single({ 1 }, { 1 }, "TEST");
+    EXPECT_FALSE(single.topIncrements(2, &largest, &smallest));
+    EXPECT_TRUE(largest.empty());
+}
+
+// we test the greatest increment per day on data spread over two days.
+TEST(TimeSeriesTransformations, greatestIncrementPerDay)
+{
+    std::vector<int> _time = { 1 , 2 , 3 , 4 , 5 , 6 , 1607652062 , 1607652063 , 1607652064 };
+    std::vector<double> _price = { 1 , 2 , 5 , 4 , 5 , 6 , 7 , 8 , 12 };
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    std::vector<std::pair<int, double>> increments;
+    EXPECT_TRUE(series.greatestIncrementPerPeriod(86400, &increments));
+    EXPECT_TRUE(increments.size() == 2);
+    EXPECT_TRUE(increments[0] == std::make_pair(2, 3.0));
+    EXPECT_TRUE(increments[1] == std::make_pair(1607652063, 4.0));
+}
+
+// we test the per-day aggregates against the per-day print functions and the whole-series statistics.
+TEST(TimeSeriesTransformations, aggregateByDay)
+{
+    std::vector<int> _time = { 1 , 2 , 3 , 4 , 5 , 6 , 1607652062 , 1607652063 , 1607652064 };
+    std::vector<double> _price = { 1 , 2 , 3 , 4 , 5 , 6 , 7 , 8 , 10 };
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    std::vector<PeriodAggregate> days;
+    EXPECT_TRUE(series.aggregateByPeriod(86400, &days));
+    EXPECT_TRUE(days.size() == 2);
+
+    EXPECT_TRUE(days[0].periodStart == 0 && days[0].count == 6);
+    EXPECT_TRUE(days[0].first == 1 && days[0].last == 6 && days[0].min == 1 && days[0].max == 6);
+    EXPECT_DOUBLE_EQ(days[0].mean, 3.5);
+    EXPECT_DOUBLE_EQ(days[0].standardDeviation, sqrt(3.5));
+
+    // the increment from the last price of the first day to the first price of the second day belongs to the first day.
+    EXPECT_TRUE(days[0].incrementCount == 6 && days[0].greatestIncrement == 1);
+    EXPECT_DOUBLE_EQ(days[0].incrementMean, 1);
+    EXPECT_DOUBLE_EQ(days[0].incrementStandardDeviation, 0);
+
+    EXPECT_TRUE(days[1].periodStart == 1607644800 && days[1].count == 3 && days[1].incrementCount == 2);
+    EXPECT_DOUBLE_EQ(days[1].incrementMean, 1.5);
+    EXPECT_TRUE(days[1].greatestIncrement == 2);
+
+    // a single period covering the examination file gives the whole-series statistics.
+    double mean, sd;
+    t.mean(&mean);
+    t.standardDeviation(&sd);
+    EXPECT_TRUE(t.aggregateByPeriod(1 << 30, &days));
+    EXPECT_TRUE(days.size() == 1 && days[0].count == 28);
+    EXPECT_TRUE(test(days[0].mean, mean));
+    EXPECT_TRUE(test(days[0].standardDeviation, sd));
+}
+
+
+// we test that addSharePrices merges unordered prices into the series as if they had been added one by one.
+TEST(TimeSeriesTransformations, addSharePricesMergesBatch)
+{
+    std::vector<int> _time = { 1 , 3 , 5 };
+    std::vector<double> _price = { 1 , 3 , 5 };
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    series.addSharePrices({ 6 , 2 , 4 }, { 6 , 2 , 4 });
+    EXPECT_TRUE(series.getTime() == std::vector<int>({ 1 , 2 , 3 , 4 , 5 , 6 }));
+    EXPECT_TRUE(series.getPrice() == std::vector<double>({ 1 , 2 , 3 , 4 , 5 , 6 }));
+    EXPECT_THROW(series.addSharePrices({ 7 }, {}), std::runtime_error);
+}
+
+// we test that ticks pushed by several producers while a reader takes snapshots all end up, sorted, in the published series.
+TEST(TimeSeriesTransformations, realTimeSeriesConcurrentProducers)
+{
+    RealTimeSeries live(TimeSeriesTransformations({ 0 }, { 100 }, "LIVE"), 1024);
+
+    auto produce = [&live](int first)
+    {
+        for (int i = 0; i < 50000; i++)
+        {
+            // odd and even times from the two producers, retrying while the ring is full.
+            while (!live.push(first + 2 * i, 100 + (i % 10)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    bool readerFailed = false;
+    std::atomic<bool> producing{ true };
+    std::thread reader([&]()
+    {
+        while (producing)
+        {
+            // every snapshot is a consistent, sorted series.
+            std::shared_ptr<const TimeSeriesTransformations> snapshot = live.snapshot();
+            std::vector<int> time = snapshot->getTime();
+            readerFailed |= !std::is_sorted(time.begin(), time.end()) || snapshot->getName() != "LIVE";
+        }
+    });
+
+    std::thread producer1(produce, 1);
+    std::thread producer2(produce, 2);
+    producer1.join();
+    producer2.join();
+    live.flush();
+    producing = false;
+    reader.join();
+
+    std::shared_ptr<const TimeSeriesTransformations> snapshot = live.snapshot();
+    std::vector<int> time = snapshot->getTime();
+    EXPECT_FALSE(readerFailed);
+    EXPECT_TRUE(snapshot->count() == 100001);
+    EXPECT_TRUE(std::is_sorted(time.begin(), time.end()));
+    EXPECT_TRUE(time.back() == 100000);
+    EXPECT_TRUE(live.epoch() > 1);
+}
+
+// we test that the snapshots share their full chunks, that an old tick unseals the chunks after it, and that pushOrWait never drops.
+TEST(TimeSeriesTransformations, realTimeSeriesSharedChunks)
+{
+    std::vector<int> time;
+    std::vector<double> price;
+    for (int i = 0; i < (int)(2 * RealTimeSeries::chunkRows + 100); i++)
+    {
+        time.push_back(10 * i);
+        price.push_back(i % 13);
+    }
+    RealTimeSeries live(TimeSeriesTransformations(time, price, "LIVE"), 2);
+
+    std::shared_ptr<const RealTimeSeries::Snapshot> first = live.view();
+    live.pushOrWait(time.back() + 10, 1.5);
+    live.flush();
+    std::shared_ptr<const RealTimeSeries::Snapshot> appended = live.view();
+    EXPECT_EQ(appended->count(), time.size() + 1);
+    EXPECT_TRUE(first->chunks().size() == 3 && appended->chunks()[0] == first->chunks()[0] && appended->chunks()[1] == first->chunks()[1]);
+    EXPECT_EQ(appended->row(time.size()).second, 1.5);
+
+    // a tick in the second chunk leaves the first one shared.
+    int old = time[RealTimeSeries::chunkRows + 5] + 1;
+    live.pushOrWait(old, 2.5);
+    live.flush();
+    std::shared_ptr<const RealTimeSeries::Snapshot> inserted = live.view();
+    EXPECT_TRUE(inserted->chunks()[0] == first->chunks()[0] && inserted->chunks()[1] != first->chunks()[1]);
+    EXPECT_TRUE(inserted->row(RealTimeSeries::chunkRows + 6) == std::make_pair(old, 2.5));
+    std::vector<int> times = live.snapshot()->getTime();
+    EXPECT_TRUE(times.size() == time.size() + 2 && std::is_sorted(times.begin(), times.end()));
+
+    // the ring of two ticks is always full, but pushOrWait waits for the merger instead of dropping.
+    for (int i = 0; i < 10000; i++)
+    {
+        live.pushOrWait(time.back() + 20 + i, i);
+    }
+    live.flush();
+    EXPECT_TRUE(live.view()->count() == time.size() + 10002 && live.dropped() == 0);
+}
+
+// we test that loading the examination file asynchronously, in chunks much smaller than a line, gives the same series as the file constructor.
+TEST(TimeSeriesTransformations, loadAsyncExaminationFile)
+{
+    size_t lastBytes = 0, totalBytes = 0;
+    LoadOptions options;
+    options.chunkSize = 7;
+    options.progress = [&](size_t bytesRead, size_t total) { lastBytes = bytesRead; totalBytes = total; };
+
+    std::future<TimeSeriesTransformations> loading = TimeSeriesTransformations::loadAsync("headerdata.csv", options);
+    TimeSeriesTransformations loaded = loading.get();
+    EXPECT_TRUE(loaded.getName() == "ShareX");
+    EXPECT_TRUE(loaded.getSeparator() == ',');
+    EXPECT_TRUE(loaded.getTime() == t.getTime());
+    EXPECT_TRUE(loaded.getPrice() == t.getPrice());
+    EXPECT_TRUE(lastBytes == totalBytes && totalBytes > 0);
+
+    TimeSeriesTransformations headerOnly = TimeSeriesTransformations::load("headeronly.csv");
+    EXPECT_TRUE(headerOnly.getName() == "HEADER" && headerOnly.count() == 0);
+}
+
+// we test that a load can be cancelled and that loading an empty or missing file fails through the future.
+TEST(TimeSeriesTransformations, loadAsyncCancelAndErrors)
+{
+    LoadOptions options;
+    options.cancel = std::make_shared<std::atomic<bool>>(true);
+    EXPECT_THROW(TimeSeriesTransformations::loadAsync("headerdata.csv", options).get(), std::runtime_error);
+    EXPECT_THROW(TimeSeriesTransformations::loadAsync("empty.csv").get(), std::runtime_error);
+    EXPECT_THROW(TimeSeriesTransformations::loadAsync("missing.csv").get(), std::runtime_error);
+}
+
+// we test the return transforms against their definitions, and that the increments are the differences at lag 1.
+TEST(TimeSeriesTransformations, returnTransforms)
+{
+    std::vector<int> _time = { 1 , 2 , 3 , 4 };
+    std::vector<double> _price = { 100 , 110 , 99 , 121 };
+    TimeSeriesTransformations series(_time, _price, "TEST");
+
+    EXPECT_TRUE(series.computeIncrements() == series.computeReturns(ReturnType::Difference));
+    EXPECT_TRUE(series.computeReturns(ReturnType::Difference, 2) == std::vector<double>({ -1 , 11 }));
+
+    std::vector<double> logReturns = series.computeReturns(ReturnType::Log);
+    EXPECT_DOUBLE_EQ(logReturns[0], log(1.1));
+    EXPECT_DOUBLE_EQ(logReturns[1], log(0.9));
+
+    double buffer[3];
+    EXPECT_TRUE(series.computeReturns(ReturnType::Percentage, 1, buffer, 3));
+    EXPECT_NEAR(buffer[0], 0.1, 1e-12);
+    EXPECT_NEAR(buffer[1], -0.1, 1e-12);
+    EXPECT_FALSE(series.computeReturns(ReturnType::Percentage, 1, buffer, 2));
+    EXPECT_FALSE(series.computeReturns(ReturnType::Percentage, 4, buffer, 3));
+
+    TimeSeriesTransformations cumulative = series.returnsSeries(ReturnType::Cumulative);
+    EXPECT_TRUE(cumulative.count() == 3 && cumulative.getName() == "TEST");
+    EXPECT_TRUE(cumulative.getTime() == std::vector<int>({ 1 , 2 , 3 }));
+    EXPECT_NEAR(cumulative.getPrice()[2], 0.21, 1e-12);
+}
+
+// we test that the one-pass statistics of the increments match computeIncrementMean and computeIncrementStandardDeviation.
+TEST(TimeSeriesTransformations, returnStatisticsOfExaminationFile)
+{
+    double mean, sd;
+    EXPECT_TRUE(t.returnStatistics(ReturnType::Difference, 1, &mean, &sd));
+    EXPECT_TRUE(test(mean, -1.8160218518518523));
+    EXPECT_TRUE(test(sd, 40.233938872573837));
+
+    std::vector<double> logReturns = t.computeReturns(ReturnType::Log, 3);
+    double logMean, logSd;
+    EXPECT_TRUE(t.returnStatistics(ReturnType::Log, 3, &logMean, &logSd));
+    EXPECT_TRUE(test(logMean, std::accumulate(logReturns.begin(), logReturns.end(), 0.0) / logReturns.size()));
+
+    EXPECT_FALSE(t1.returnStatistics(ReturnType::Log, 1, &mean, &sd));
+    EXPECT_TRUE(isnan(mean) && isnan(sd));
+}
+
+// we test that the direct and the FFT autocovariances agree, and that the autocorrelation starts at 1.
+TEST(TimeSeriesTransformations, autocorrelationDirectAndFFT)
+{
+    std::vector<double> direct, transform;
+    EXPECT_TRUE(t.autocovariance(10, &direct, AutocorrelationMethod::Direct));
+    EXPECT_TRUE(t.autocovariance(10, &transform, AutocorrelationMethod::FFT));
+    EXPECT_TRUE(direct.size() == 11 && transform.size() == 11);
+    for (size_t k = 0; k < direct.size(); k++)
+    {
+        EXPECT_NEAR(direct[k], transform[k], 1e-9);
+    }
+
+    // the variance at lag 0 is the (biased) variance of the prices.
+    double sd;
+    t.standardDeviation(&sd);
+    EXPECT_TRUE(test(direct[0], sd * sd * 27 / 28));
+
+    std::vector<double> acf;
+    EXPECT_TRUE(t.incrementAutocorrelation(5, &acf));
+    EXPECT_DOUBLE_EQ(acf[0], 1);
+    EXPECT_FALSE(t1.autocorrelation(5, &acf));
+}
+
+// we test the autocorrelation of a long alternating series, for which the automatic choice is the FFT.
+TEST(TimeSeriesTransformations, autocorrelationOfAlternatingSeries)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 4096; i++)
+    {
+        _time.push_back(i);
+        _price.push_back(i % 2 == 0 ? 1 : -1);
+    }
+    TimeSeriesTransformations series(_time, _price, "TEST");
+    std::vector<double> acf;
+    EXPECT_TRUE(series.autocorrelation(1000, &acf));
+    EXPECT_NEAR(acf[1], -4095.0 / 4096, 1e-9);
+    EXPECT_NEAR(acf[1000], 3096.0 / 4096, 1e-9);
+}
+
+// noisy series of 1000 prices around 100 with a spike of +50 every 100 prices (at 50, 150, ...), used by the outlier tests.
+TimeSeriesTransformations spikySeries()
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 1000; i++)
+    {
+        _time.push_back(i);
+        _price.push_back(100 + (i * 37 % 11) / 10.0 + (i % 100 == 50 ? 50 : 0));
+    }
+    return TimeSeriesTransformations(_time, _price, "SPIKY");
+}
+
+// we test that the three outlier filters remove exactly the spikes, and reject bad thresholds.
+TEST(TimeSeriesTransformations, removeOutliers)
+{
+    size_t removed = 0;
+    TimeSeriesTransformations zScore = spikySeries();
+    EXPECT_TRUE(zScore.removeOutliersZScore(3, &removed));
+    EXPECT_TRUE(removed == 10 && zScore.count() == 990);
+    double highest;
+    zScore.quantile(1, &highest);
+    EXPECT_TRUE(highest < 102);
+
+    TimeSeriesTransformations mad = spikySeries();
+    EXPECT_TRUE(mad.removeOutliersMAD(21, 5, &removed));
+    EXPECT_TRUE(removed == 10 && mad == zScore);
+
+    TimeSeriesTransformations spikes = spikySeries();
+    EXPECT_TRUE(spikes.removeIncrementSpikes(3, &removed));
+    EXPECT_TRUE(removed == 10 && spikes == zScore);
+
+    EXPECT_FALSE(spikes.removeOutliersZScore(0));
+    EXPECT_FALSE(spikes.removeOutliersMAD(2, 3));
+    EXPECT_FALSE(t1.removeIncrementSpikes(3));
+}
+
+// we test that a lasting jump is not taken for a spike, and that the streaming filter keeps it after its first price.
+TEST(TimeSeriesTransformations, levelShiftIsNotASpike)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 200; i++)
+    {
+        _time.push_back(i);
+        _price.push_back((i < 100 ? 100 : 200) + (i * 37 % 11) / 10.0);
+    }
+    TimeSeriesTransformations series(_time, _price, "SHIFT");
+    size_t removed = 1;
+    EXPECT_TRUE(series.removeIncrementSpikes(3, &removed));
+    EXPECT_TRUE(removed == 0);
+
+    OutlierFilter filter = OutlierFilter::incrementSpike(3);
+    for (double price : _price)
+    {
+        filter.accept(price);
+    }
+    EXPECT_TRUE(filter.rejected() == 1);
+}
+
+// we test that a filter given to load drops the bad rows while parsing, with the same result as filtering in memory.
+TEST(TimeSeriesTransformations, loadWithOutlierFilter)
+{
+    spikySeries().saveData("SpikyData");
+    LoadOptions options;
+    options.chunkSize = 64;
+    options.filter = OutlierFilter::rollingMAD(21, 5);
+    TimeSeriesTransformations loaded = TimeSeriesTransformations::load("SpikyData.csv", options);
+
+    TimeSeriesTransformations filtered = spikySeries();
+    filtered.removeOutliersMAD(21, 5);
+    EXPECT_TRUE(loaded.count() == 990);
+    EXPECT_TRUE(loaded.getPrice() == filtered.getPrice());
+    EXPECT_TRUE(loaded.getTime() == filtered.getTime());
+}
+
+// we test the three fills of reindex on a small series, with and without a maximum gap.
+TEST(TimeSeriesTransformations, reindexFills)
+{
+    TimeSeriesTransformations series({ 0, 10, 30 }, { 1, 2, 4 }, "GRID");
+    std::vector<int> times(8);
+    std::vector<double> prices(8);
+
+    EXPECT_TRUE(series.reindex(0, 5, FillMethod::Forward, 0, times.data(), prices.data(), 8));
+    EXPECT_TRUE(times == std::vector<int>({ 0, 5, 10, 15, 20, 25, 30, 35 }));
+    EXPECT_TRUE(prices == std::vector<double>({ 1, 1, 2, 2, 2, 2, 4, 4 }));
+
+    EXPECT_TRUE(series.reindex(0, 5, FillMethod::Linear, 0, nullptr, prices.data(), 8));
+    EXPECT_TRUE(std::vector<double>(prices.begin(), prices.end() - 1) == std::vector<double>({ 1, 1.5, 2, 2.5, 3, 3.5, 4 }));
+    EXPECT_TRUE(isnan(prices[7]));
+
+    EXPECT_TRUE(series.reindex(0, 5, FillMethod::NaN, 0, nullptr, prices.data(), 8));
+    EXPECT_TRUE(prices[0] == 1 && isnan(prices[1]) && prices[2] == 2 && isnan(prices[3]) && prices[6] == 4);
+
+    // with a maximum gap of 10 s, the price at 10 is carried until 20, and there is nothing to interpolate between 10 and 30.
+    EXPECT_TRUE(series.reindex(0, 5, FillMethod::Forward, 10, nullptr, prices.data(), 8));
+    EXPECT_TRUE(prices[4] == 2 && isnan(prices[5]) && prices[7] == 4);
+    EXPECT_TRUE(series.reindex(0, 5, FillMethod::Linear, 10, nullptr, prices.data(), 8));
+    EXPECT_TRUE(prices[1] == 1.5 && isnan(prices[3]) && isnan(prices[5]));
+
+    // grid times before the first price are NaN, and a bad step is rejected.
+    EXPECT_TRUE(series.reindex(-10, 5, FillMethod::Forward, 0, nullptr, prices.data(), 2));
+    EXPECT_TRUE(isnan(prices[0]) && isnan(prices[1]));
+    EXPECT_FALSE(series.reindex(0, 0, FillMethod::Forward, 0, nullptr, prices.data(), 8));
+}
+
+// we test that reindexing the examination file on its own 5000 s grid keeps its prices.
+TEST(TimeSeriesTransformations, reindexedExaminationFile)
+{
+    TimeSeriesTransformations grid = t.reindexed(5000, FillMethod::Linear);
+    std::vector<int> times = t.getTime();
+    EXPECT_TRUE(grid.count() == (times.back() - times.front()) / 5000 + 1);
+    EXPECT_TRUE(grid.getName() == "ShareX");
+
+    std::vector<int> gridTimes = grid.getTime();
+    std::vector<double> gridPrices = grid.getPrice();
+    std::vector<double> prices = t.getPrice();
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        size_t index = (times[i] - times.front()) / 5000;
+        if (gridTimes[index] == times[i])
+        {
+            EXPECT_DOUBLE_EQ(gridPrices[index], prices[i]);
+        }
+    }
+}
+
+// we test the four duplicate policies on the vector constructor, which keep the first or last price in the order given.
+TEST(TimeSeriesTransformations, duplicatePolicies)
+{
+    std::vector<int> _time = { 3, 1, 2, 1, 2, 1 };
+    std::vector<double> _price = { 30, 12, 21, 10, 20, 11 };
+
+    TimeSeriesTransformations all(_time, _price, "DUP");
+    EXPECT_TRUE(all.count() == 6);
+    EXPECT_TRUE(all.getPrice() == std::vector<double>({ 10, 11, 12, 20, 21, 30 }));
+
+    TimeSeriesTransformations first(_time, _price, "DUP", DuplicatePolicy::KeepFirst);
+    EXPECT_TRUE(first.getTime() == std::vector<int>({ 1, 2, 3 }));
+    EXPECT_TRUE(first.getPrice() == std::vector<double>({ 12, 21, 30 }));
+
+    TimeSeriesTransformations last(_time, _price, "DUP", DuplicatePolicy::KeepLast);
+    EXPECT_TRUE(last.getPrice() == std::vector<double>({ 11, 20, 30 }));
+
+    TimeSeriesTransformations average(_time, _price, "DUP", DuplicatePolicy::Average);
+    EXPECT_TRUE(average.getPrice() == std::vector<double>({ 11, 20.5, 30 }));
+
+    // the policy set on a series applies to the data stored and to the prices added later.
+    all.setDuplicatePolicy(DuplicatePolicy::KeepLast);
+    EXPECT_TRUE(all.getTime() == std::vector<int>({ 1, 2, 3 }));
+    EXPECT_TRUE(all.getDuplicatePolicy() == DuplicatePolicy::KeepLast);
+}
+
+// we test that inserted prices follow the policy, both at the end of the series and in its middle, and that copies keep it.
+TEST(TimeSeriesTransformations, duplicatePolicyOnInsert)
+{
+    TimeSeriesTransformations last({ 1, 2, 3 }, { 10, 20, 30 }, "DUP", DuplicatePolicy::KeepLast);
+    last.enableSketches();
+    last.addSharePrices({ 3, 4, 2, 4 }, { 31, 40, 22, 41 });
+    EXPECT_TRUE(last.getTime() == std::vector<int>({ 1, 2, 3, 4 }));
+    EXPECT_TRUE(last.getPrice() == std::vector<double>({ 10, 22, 31, 41 }));
+    EXPECT_TRUE(last.priceSketch().count() == 4);
+
+    TimeSeriesTransformations first(last);
+    first.setDuplicatePolicy(DuplicatePolicy::KeepFirst);
+    first.addSharePrices({ 4, 5, 5 }, { 99, 50, 51 });
+    EXPECT_TRUE(first.getPrice() == std::vector<double>({ 10, 22, 31, 41, 50 }));
+
+    LoadOptions options;
+    options.duplicates = DuplicatePolicy::KeepFirst;
+    TimeSeriesTransformations loaded = TimeSeriesTransformations::load("headerdata.csv", options);
+    EXPECT_TRUE(loaded.getTime() == t.getTime() && loaded.getPrice() == t.getPrice());
+}
+
+// we test that the vector constructor orders pairs exactly like std::sort whether the data is sorted, made of a few ascending runs,
+// or shuffled (radix sorted), with negative times and repeated times.
+TEST(TimeSeriesTransformations, adaptiveSortMatchesStdSort)
+{
+    for (int layout = 0; layout < 3; layout++)
+    {
+        std::vector<std::pair<int, double>> pairs;
+        unsigned state = 12345;
+        for (int i = 0; i < 20000; i++)
+        {
+            state = state * 1103515245 + 12345;
+            int time = (layout == 2 ? (int)(state >> 8) % 5000 - 2500 : (layout == 1 ? (i % 4000) * 7 : i / 3));
+            pairs.push_back({ time, (double)(state % 97) });
+        }
+        std::vector<int> _time;
+        std::vector<double> _price;
+        for (const std::pair<int, double>& pair : pairs)
+        {
+            _time.push_back(pair.first);
+            _price.push_back(pair.second);
+        }
+
+        TimeSeriesTransformations series(_time, _price, "SORT");
+        std::sort(pairs.begin(), pairs.end());
+        std::vector<int> sortedTime;
+        std::vector<double> sortedPrice;
+        for (const std::pair<int, double>& pair : pairs)
+        {
+            sortedTime.push_back(pair.first);
+            sortedPrice.push_back(pair.second);
+        }
+        EXPECT_TRUE(series.getTime() == sortedTime);
+        EXPECT_TRUE(series.getPrice() == sortedPrice);
+
+        // with a policy the sort is stable: the first price given for each time is kept.
+        TimeSeriesTransformations first(_time, _price, "SORT", DuplicatePolicy::KeepFirst);
+        std::vector<int> firstTime = first.getTime();
+        std::vector<double> firstPrice = first.getPrice();
+        for (size_t i = 0; i < firstTime.size(); i += 97)
+        {
+            size_t index = std::find(_time.begin(), _time.end(), firstTime[i]) - _time.begin();
+            EXPECT_TRUE(firstPrice[i] == _price[index]);
+        }
+    }
+}
+
+// we test that the examination file written as daily partitions loads back whole, and that a range opens only the days it overlaps.
+TEST(TimeSeriesTransformations, partitionedStoreByDay)
+{
+    PartitionedStore::write(t, "PartitionedData");
+    PartitionedStore store("PartitionedData");
+    std::vector<int> times = t.getTime();
+    std::vector<double> prices = t.getPrice();
+
+    std::vector<int> days;
+    for (int time : times)
+    {
+        days.push_back(time / 86400);
+    }
+    days.erase(std::unique(days.begin(), days.end()), days.end());
+    EXPECT_TRUE(store.partitionCount() == days.size());
+    EXPECT_TRUE(store.count() == times.size() && store.getName() == "ShareX");
+    TimeSeriesTransformations loaded = store.load();
+    EXPECT_TRUE(loaded.getTime() == t.getTime() && loaded.getPrice() == t.getPrice());
+
+    // a range inside the second day opens that partition only and is cut at the times given.
+    int from = days[1] * 86400 + 3600;
+    int to = days[1] * 86400 + 7200 * 3;
+    TimeSeriesTransformations range = store.loadBetween(from, to);
+    EXPECT_TRUE(store.partitionsBetween(from, to) == 1);
+    std::vector<int> expected;
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        if (times[i] >= from && times[i] <= to)
+        {
+            expected.push_back(times[i]);
+        }
+    }
+    EXPECT_TRUE(range.getTime() == expected && !expected.empty());
+    EXPECT_TRUE(store.countBetween(from, to) == expected.size());
+    EXPECT_TRUE(store.countBetween(times.front(), times.back()) == times.size());
+    EXPECT_TRUE(store.loadBetween(to, from).count() == 0);
+}
+
+// we test monthly partitions and that a missing store cannot be opened.
+TEST(TimeSeriesTransformations, partitionedStoreByMonth)
+{
+    std::vector<int> _time = { 1609459199, 1609459200, 1612137599, 1612137600, 1614556800 };
+    std::vector<double> _price = { 1, 2, 3, 4, 5 };
+    TimeSeriesTransformations series(_time, _price, "MONTHS");
+    PartitionedStore::write(series, "PartitionedMonths", PartitionPeriod::Month);
+
+    // 2020-12-31 23:59:59, January 2021 (two prices), February 2021, March 2021.
+    PartitionedStore store("PartitionedMonths");
+    EXPECT_TRUE(store.partitionCount() == 4);
+    EXPECT_TRUE(store.period() == PartitionPeriod::Month);
+    TimeSeriesTransformations loaded = store.load();
+    EXPECT_TRUE(loaded.getTime() == series.getTime() && loaded.getPrice() == series.getPrice());
+    EXPECT_TRUE(store.loadBetween(1609459200, 1612137599).getPrice() == std::vector<double>({ 2, 3 }));
+    EXPECT_THROW(PartitionedStore("MissingStore"), std::runtime_error);
+
+    // writing a shorter series over the store removes the partitions it no longer uses and leaves no temporary file.
+    TimeSeriesTransformations february({ 1612137600 }, { 6 }, "MONTHS");
+    PartitionedStore::write(february, "PartitionedMonths", PartitionPeriod::Month);
+    PartitionedStore rewritten("PartitionedMonths");
+    EXPECT_TRUE(rewritten.partitionCount() == 1 && rewritten.load().getPrice() == std::vector<double>({ 6 }));
+    EXPECT_FALSE(std::ifstream("PartitionedMonths/2021-01.tsp").good());
+    EXPECT_FALSE(std::ifstream("PartitionedMonths/2020-12.tsp").good());
+    EXPECT_FALSE(std::ifstream("PartitionedMonths/manifest.csv.tmp").good());
+    EXPECT_TRUE(std::ifstream("PartitionedMonths/2021-02.tsp").good());
+}
+
+// we test that a binary file with small blocks gives back the examination file and answers range queries like the series itself.
+TEST(TimeSeriesTransformations, binaryFileRangeQueries)
+{
+    BinarySeriesFile::write(t, "BinaryData.tsb", 4);
+    BinarySeriesFile file("BinaryData.tsb");
+    std::vector<int> times = t.getTime();
+    std::vector<double> prices = t.getPrice();
+    EXPECT_TRUE(file.count() == times.size() && file.blockCount() == (times.size() + 3) / 4);
+    EXPECT_TRUE(file.getName() == "ShareX");
+    TimeSeriesTransformations loaded = file.load();
+    EXPECT_TRUE(loaded.getTime() == times && loaded.getPrice() == prices);
+
+    // a range cutting blocks at both ends.
+    int from = times[5] - 1, to = times[17] + 1;
+    double sum = std::accumulate(prices.begin() + 5, prices.begin() + 18, 0.0);
+    double value;
+    EXPECT_TRUE(file.countBetween(from, to) == 13);
+    EXPECT_TRUE(file.sumBetween(from, to, &value) && test(value, sum));
+    EXPECT_TRUE(file.meanBetween(from, to, &value) && test(value, sum / 13));
+    EXPECT_TRUE(file.minBetween(from, to, &value) && value == *std::min_element(prices.begin() + 5, prices.begin() + 18));
+    EXPECT_TRUE(file.maxBetween(from, to, &value) && value == *std::max_element(prices.begin() + 5, prices.begin() + 18));
+    EXPECT_TRUE(file.loadBetween(from, to).getTime() == std::vector<int>(times.begin() + 5, times.begin() + 18));
+
+    EXPECT_TRUE(file.getPriceAtTime(times[9], &value) && value == prices[9]);
+    EXPECT_FALSE(file.getPriceAtTime(times[9] + 1, &value));
+    EXPECT_TRUE(isnan(value));
+    EXPECT_FALSE(file.meanBetween(to, from, &value));
+}
+
+// we test that files that are not binary series are rejected.
+TEST(TimeSeriesTransformations, binaryFileRejectsOtherFiles)
+{
+    EXPECT_THROW(BinarySeriesFile("headerdata.csv"), std::runtime_error);
+    EXPECT_THROW(BinarySeriesFile("empty.csv"), std::runtime_error);
+    EXPECT_THROW(BinarySeriesFile("missing.tsb"), std::runtime_error);
+
+    BinarySeriesFile::write(TimeSeriesTransformations(), "EmptyData.tsb");
+    BinarySeriesFile empty("EmptyData.tsb");
+    EXPECT_TRUE(empty.count() == 0 && empty.load().count() == 0);
+}
+
+// we test that a slice exported through the Arrow C Data Interface has the expected layout and reads back through ArrowSeries.
+TEST(TimeSeriesTransformations, arrowExportAndImport)
+{
+    ArrowSchema schema;
+    ArrowArray array;
+    EXPECT_TRUE(t.exportArrow(&schema, &array, 3, 10));
+    EXPECT_TRUE(std::string(schema.format) == "+s" && std::string(schema.name) == "ShareX" && schema.n_children == 2);
+    EXPECT_TRUE(std::string(schema.children[0]->format) == "tss:UTC" && std::string(schema.children[1]->name) == "price");
+    EXPECT_TRUE(array.length == 10 && array.n_children == 2 && array.children[1]->length == 10);
+
+    ArrowSeries imported(&schema, &array);
+    EXPECT_TRUE(schema.release == nullptr && array.release == nullptr);
+    EXPECT_TRUE(imported.count() == 10 && imported.getName() == "ShareX");
+    std::vector<int> times = t.getTime();
+    std::vector<double> prices = t.getPrice();
+    EXPECT_TRUE(imported.time(0) == times[3] && imported.price(9) == prices[12]);
+
+    EXPECT_TRUE(t.exportArrow(&schema, &array));
+    TimeSeriesTransformations roundTrip = ArrowSeries(&schema, &array).toSeries();
+    EXPECT_TRUE(roundTrip.getTime() == times && roundTrip.getPrice() == prices);
+    EXPECT_FALSE(t.exportArrow(&schema, &array, times.size() + 1));
+}
+
+// a foreign array with an int32 time column, whose buffers are static and whose release callback counts its calls.
+int foreignReleases = 0;
+const int32_t foreignTimes[] = { 10, 20, 30, 40 };
+const double foreignPrices[] = { 1.5, 2.5, 3.5, 4.5 };
+
+void releaseForeignArray(ArrowArray* array)
+{
+    foreignReleases++;
+    array->release = nullptr;
+}
+
+void releaseForeignSchema(ArrowSchema* schema)
+{
+    schema->release = nullptr;
+}
+
+// we test that ArrowSeries reads foreign buffers in place, honours the struct offset, and releases the array exactly once.
+TEST(TimeSeriesTransformations, arrowImportAdoptsForeignBuffers)
+{
+    static const void* timeBuffers[] = { nullptr, foreignTimes };
+    static const void* priceBuffers[] = { nullptr, foreignPrices };
+    static const void* structBuffers[] = { nullptr };
+    static ArrowArray timeArray = { 4, 0, 0, 2, 0, timeBuffers, nullptr, nullptr, releaseForeignArray, nullptr };
+    static ArrowArray priceArray = { 4, 0, 0, 2, 0, priceBuffers, nullptr, nullptr, releaseForeignArray, nullptr };
+    static ArrowArray* arrayChildren[] = { &timeArray, &priceArray };
+    static ArrowSchema timeSchema = { "i", "time", nullptr, 0, 0, nullptr, nullptr, releaseForeignSchema, nullptr };
+    static ArrowSchema priceSchema = { "g", "price", nullptr, 0, 0, nullptr, nullptr, releaseForeignSchema, nullptr };
+    static ArrowSchema* schemaChildren[] = { &timeSchema, &priceSchema };
+
+    ArrowSchema schema = { "+s", "FOREIGN", nullptr, 0, 2, schemaChildren, nullptr, releaseForeignSchema, nullptr };
+    ArrowArray array = { 3, 0, 1, 1, 2, structBuffers, arrayChildren, nullptr, releaseForeignArray, nullptr };
+    {
+        ArrowSeries series(&schema, &array);
+        EXPECT_TRUE(series.count() == 3 && series.time(0) == 20 && series.price(2) == 4.5);
+        EXPECT_TRUE(series.prices() == foreignPrices + 1);
+        EXPECT_TRUE(foreignReleases == 0);
+    }
+    EXPECT_TRUE(foreignReleases == 1);
+
+    // a schema that is not a series is refused, and released all the same.
+    ArrowSchema wrong = { "g", "WRONG", nullptr, 0, 0, nullptr, nullptr, releaseForeignSchema, nullptr };
+    ArrowArray wrongArray = { 4, 0, 0, 2, 0, priceBuffers, nullptr, nullptr, releaseForeignArray, nullptr };
+    EXPECT_THROW(ArrowSeries(&wrong, &wrongArray), std::invalid_argument);
+    EXPECT_TRUE(foreignReleases == 2);
+
+    // so are a struct without its children, with a missing child or with a child without buffers.
+    ArrowArray* missingChild[] = { &timeArray, nullptr };
+    ArrowArray noBuffers = { 4, 0, 0, 2, 0, nullptr, nullptr, nullptr, releaseForeignArray, nullptr };
+    ArrowArray* bufferlessChild[] = { &timeArray, &noBuffers };
+    ArrowSchema* missingSchemaChild[] = { &timeSchema, nullptr };
+    for (ArrowArray** children : { (ArrowArray**)nullptr, missingChild, bufferlessChild })
+    {
+        schema = { "+s", "FOREIGN", nullptr, 0, 2, schemaChildren, nullptr, releaseForeignSchema, nullptr };
+        array = { 3, 0, 1, 1, 2, structBuffers, children, nullptr, releaseForeignArray, nullptr };
+        EXPECT_THROW(ArrowSeries(&schema, &array), std::invalid_argument);
+    }
+    for (ArrowSchema** children : { (ArrowSchema**)nullptr, missingSchemaChild })
+    {
+        schema = { "+s", "FOREIGN", nullptr, 0, 2, children, nullptr, releaseForeignSchema, nullptr };
+        array = { 3, 0, 1, 1, 2, structBuffers, arrayChildren, nullptr, releaseForeignArray, nullptr };
+        EXPECT_THROW(ArrowSeries(&schema, &array), std::invalid_argument);
+    }
+    EXPECT_TRUE(foreignReleases == 7);
+}
+
+// we test that a 64-bit time beyond the range of a series is refused instead of truncated when the rows are copied into a series.
+TEST(TimeSeriesTransformations, arrowImportRefusesTimesOutOfRange)
+{
+    static const int64_t wideTimes[] = { 10, int64_t(1) << 40 };
+    static const void* timeBuffers[] = { nullptr, wideTimes };
+    static const void* priceBuffers[] = { nullptr, foreignPrices };
+    static const void* structBuffers[] = { nullptr };
+    static ArrowArray timeArray = { 2, 0, 0, 2, 0, timeBuffers, nullptr, nullptr, releaseForeignArray, nullptr };
+    static ArrowArray priceArray = { 2, 0, 0, 2, 0, priceBuffers, nullptr, nullptr, releaseForeignArray, nullptr };
+    static ArrowArray* arrayChildren[] = { &timeArray, &priceArray };
+    static ArrowSchema timeSchema = { "tss:UTC", "time", nullptr, 0, 0, nullptr, nullptr, releaseForeignSchema, nullptr };
+    static ArrowSchema priceSchema = { "g", "price", nullptr, 0, 0, nullptr, nullptr, releaseForeignSchema, nullptr };
+    static ArrowSchema* schemaChildren[] = { &timeSchema, &priceSchema };
+
+    ArrowSchema schema = { "+s", "WIDE", nullptr, 0, 2, schemaChildren, nullptr, releaseForeignSchema, nullptr };
+    ArrowArray array = { 2, 0, 0, 1, 2, structBuffers, arrayChildren, nullptr, releaseForeignArray, nullptr };
+    ArrowSeries series(&schema, &array);
+    EXPECT_TRUE(series.count() == 2 && series.time(1) == int64_t(1) << 40);
+    EXPECT_THROW(series.toSeries(), std::invalid_argument);
+}
+
+// we test the correlation matrix of series on different time grids whose increments are proportional once aligned.
+TEST(TimeSeriesTransformations, incrementCorrelationMatrix)
+{
+    std::vector<int> timeA, timeB;
+    std::vector<double> priceA, priceB, priceC;
+    for (int i = 0; i <= 100; i++)
+    {
+        double value = std::sin(i * 0.7) + i * 0.01;
+        timeA.push_back(i * 10);
+        priceA.push_back(value);
+        priceC.push_back(5 - 3 * value);
+    }
+    // B has a price every 5 s, equal to twice the price of A at the last multiple of 10 s.
+    for (int i = 0; i <= 200; i++)
+    {
+        timeB.push_back(i * 5);
+        priceB.push_back(2 * priceA[i / 2]);
+    }
+    TimeSeriesTransformations a(timeA, priceA, "A"), b(timeB, priceB, "B"), c(timeA, priceC, "C");
+
+    std::vector<double> matrix;
+    EXPECT_TRUE(TimeSeriesTransformations::incrementCorrelationMatrix({ &a, &b, &c }, 10, &matrix));
+    EXPECT_TRUE(matrix.size() == 9);
+    EXPECT_NEAR(matrix[0], 1, 1e-12);
+    EXPECT_NEAR(matrix[1], 1, 1e-12);
+    EXPECT_NEAR(matrix[2], -1, 1e-12);
+    EXPECT_NEAR(matrix[7], -1, 1e-12);
+    EXPECT_TRUE(matrix[5] == matrix[7]);
+
+    // the covariance of A with itself is the variance of its increments.
+    double sd;
+    a.computeIncrementStandardDeviation(&sd);
+    EXPECT_TRUE(TimeSeriesTransformations::incrementCovarianceMatrix({ &a, &c }, 10, &matrix));
+    EXPECT_NEAR(matrix[0], sd * sd, 1e-12);
+    EXPECT_NEAR(matrix[1], -3 * sd * sd, 1e-12);
+
+    EXPECT_FALSE(TimeSeriesTransformations::incrementCorrelationMatrix({ &a, &t }, 10, &matrix));
+}
+
+// we test the tiled computation against direct sums for a number of series that is neither a multiple of the tile size nor even.
+TEST(TimeSeriesTransformations, incrementCovarianceTilesMatchDirectSums)
+{
+    const int k = 71, n = 300;
+    std::vector<TimeSeriesTransformations> series;
+    std::vector<std::vector<double>> increments(k);
+    unsigned state = 7;
+    for (int s = 0; s < k; s++)
+    {
+        std::vector<int> _time;
+        std::vector<double> _price;
+        for (int i = 0; i < n; i++)
+        {
+            state = state * 1103515245 + 12345;
+            _time.push_back(i);
+            _price.push_back((state >> 8) % 1000 / 100.0);
+        }
+        series.push_back(TimeSeriesTransformations(_time, _price, "S"));
+        increments[s] = series.back().computeIncrements();
+    }
+    std::vector<const TimeSeriesTransformations*> pointers;
+    for (const TimeSeriesTransformations& s : series)
+    {
+        pointers.push_back(&s);
+    }
+
+    size_t tiles = 0, values = 0;
+    EXPECT_TRUE(TimeSeriesTransformations::incrementCovarianceTiles(pointers, 1, false, [&](const MatrixTile& tile)
+    {
+        tiles++;
+        values += tile.rows * tile.columns;
+        EXPECT_TRUE(tile.firstRow <= tile.firstColumn);
+    }));
+    EXPECT_TRUE(tiles == 6 && values == 32 * 32 * 3 + 32 * 7 * 2 + 7 * 7);
+
+    std::vector<double> matrix;
+    EXPECT_TRUE(TimeSeriesTransformations::incrementCovarianceMatrix(pointers, 1, &matrix));
+    for (int i = 0; i < k; i += 5)
+    {
+        for (int j = 0; j < k; j += 3)
+        {
+            double meanI = std::accumulate(increments[i].begin(), increments[i].end(), 0.0) / (n - 1);
+            double meanJ = std::accumulate(increments[j].begin(), increments[j].end(), 0.0) / (n - 1);
+            double sum = 0;
+            for (int m = 0; m < n - 1; m++)
+            {
+                sum += (increments[i][m] - meanI) * (increments[j][m] - meanJ);
+            }
+            EXPECT_NEAR(matrix[i * k + j], sum / (n - 2), 1e-9);
+        }
+    }
+}
+
+// test that the try functions report failures through their Result, without throwing or printing.
+TEST(TimeSeriesTransformations, tryFunctionsReturnStatus)
+{
+    TimeSeriesTransformations empty;
+    EXPECT_TRUE(empty.tryMean().error() == Status::EmptySeries);
+    EXPECT_TRUE(empty.tryIncrementStandardDeviation().error() == Status::EmptySeries);
+    EXPECT_TRUE(empty.tryFindGreatestIncrement().error() == Status::NotEnoughPrices);
+
+    TimeSeriesTransformations single({ 1000 }, { 4.0 }, "Single");
+    EXPECT_TRUE(single.tryMean().hasValue() && *single.tryMean() == 4.0);
+    EXPECT_TRUE(single.tryStandardDeviation().error() == Status::NotEnoughPrices);
+    EXPECT_TRUE(single.tryIncrementMean().error() == Status::NotEnoughPrices);
+    EXPECT_TRUE(single.tryIncrementStandardDeviation().error() == Status::NotEnoughPrices);
+    TimeSeriesTransformations pair({ 1000, 2000 }, { 4.0, 6.0 }, "Pair");
+    EXPECT_TRUE(pair.tryIncrementMean().hasValue() && *pair.tryIncrementMean() == 2.0);
+    EXPECT_TRUE(pair.tryIncrementStandardDeviation().error() == Status::NotEnoughPrices);
+    double value;
+    EXPECT_TRUE(single.standardDeviation(&value) && std::isnan(value));
+
+    std::vector<int> _time = { 1000, 2000, 3000, 4000 };
+    std::vector<double> _price = { 1.0, 5.0, 2.0, 3.0 };
+    TimeSeriesTransformations t(_time, _price, "T");
+    Result<double> mean = t.tryMean();
+    EXPECT_TRUE(mean.hasValue() && *mean == 2.75);
+    Result<std::pair<int, double>> greatest = t.tryFindGreatestIncrement();
+    EXPECT_TRUE(greatest && greatest->first == 1000 && greatest->second == 4.0);
+
+    EXPECT_TRUE(t.tryGetPriceAtDate("2021-02-30").error() == Status::InvalidDate);
+    EXPECT_TRUE(t.tryGetPriceAtDate("2021-02-01").error() == Status::DateNotFound);
+    EXPECT_TRUE(t.tryGetPriceAtDate(TimeSeriesTransformations::convertToDate(2000)).valueOr(0.0) == 5.0);
+
+    EXPECT_TRUE(t.tryRemovePricesGreaterThan(10.0).error() == Status::NothingRemoved);
+    Result<size_t> removed = t.tryRemovePricesGreaterThan(2.5);
+    EXPECT_TRUE(removed && *removed == 2 && t.count() == 2);
+}
+
+// test that the analyses and filters tell a bad argument from a series too short, and that the filters succeed when nothing is removed.
+TEST(TimeSeriesTransformations, tryAnalysesReturnStatus)
+{
+    std::vector<int> _time = { 1000, 2000, 3000, 4000 };
+    std::vector<double> _price = { 1.0, 5.0, 2.0, 3.0 };
+    TimeSeriesTransformations t(_time, _price, "T");
+    TimeSeriesTransformations single({ 1000 }, { 4.0 }, "Single");
+    TimeSeriesTransformations empty;
+
+    double buffer[3];
+    EXPECT_TRUE(t.tryComputeReturns(ReturnType::Difference, 0, buffer, 3).error() == Status::InvalidArgument);
+    EXPECT_TRUE(t.tryComputeReturns(ReturnType::Difference, 4, buffer, 3).error() == Status::NotEnoughPrices);
+    EXPECT_TRUE(t.tryComputeReturns(ReturnType::Difference, 1, buffer, 2).error() == Status::InvalidArgument);
+    Result<size_t> written = t.tryComputeReturns(ReturnType::Difference, 1, buffer, 3);
+    EXPECT_TRUE(written && *written == 3 && buffer[0] == 4.0);
+
+    EXPECT_TRUE(t.tryReturnStatistics(ReturnType::Difference, 3).error() == Status::NotEnoughPrices);
+    Result<std::pair<double, double>> statistics = t.tryReturnStatistics(ReturnType::Difference, 1);
+    EXPECT_TRUE(statistics.hasValue());
+    EXPECT_NEAR(statistics->first, 2.0 / 3, 1e-12);
+
+    EXPECT_TRUE(t.tryAutocovariance(-1).error() == Status::InvalidArgument);
+    EXPECT_TRUE(single.tryAutocorrelation(1).error() == Status::NotEnoughPrices);
+    Result<std::vector<double>> autocorrelation = t.tryIncrementAutocorrelation(1);
+    EXPECT_TRUE(autocorrelation && autocorrelation->size() == 2 && autocorrelation.value()[0] == 1.0);
+
+    EXPECT_TRUE(t.tryRemoveOutliersZScore(0).error() == Status::InvalidArgument);
+    EXPECT_TRUE(single.tryRemoveIncrementSpikes(3).error() == Status::NotEnoughPrices);
+    Result<size_t> removed = t.tryRemoveOutliersMAD(3, 100);
+    EXPECT_TRUE(removed && *removed == 0 && t.count() == 4);
+
+    EXPECT_TRUE(t.tryGreatestIncrementPerPeriod(0).error() == Status::InvalidArgument);
+    EXPECT_TRUE(single.tryGreatestIncrementPerPeriod(86400).error() == Status::NotEnoughPrices);
+    Result<std::vector<PeriodAggregate>> aggregates = t.tryAggregateByPeriod(86400);
+    EXPECT_TRUE(aggregates && aggregates->size() == 1 && aggregates.value()[0].count == 4);
+
+    EXPECT_TRUE(empty.tryQuantiles({ 0.5 }).error() == Status::EmptySeries);
+    EXPECT_TRUE(t.tryIncrementQuantiles({ 1.5 }).error() == Status::InvalidArgument);
+    Result<std::vector<double>> median = t.tryQuantiles({ 0.5 });
+    EXPECT_TRUE(median && median.value()[0] == 2.5);
+
+    std::vector<double> edges;
+    std::vector<int> counts;
+    EXPECT_TRUE(t.tryIncrementHistogram(0, &edges, &counts).error() == Status::InvalidArgument);
+    EXPECT_TRUE(edges.empty() && counts.empty());
+
+    std::vector<std::pair<int, double>> largest, smallest;
+    EXPECT_TRUE(single.tryTopIncrements(1, &largest, &smallest).error() == Status::NotEnoughPrices);
+
+    ArrowSchema schema;
+    ArrowArray array;
+    EXPECT_TRUE(t.tryExportArrow(&schema, &array, 5).error() == Status::InvalidArgument);
+
+    std::vector<const TimeSeriesTransformations*> series = { &t, &empty };
+    EXPECT_TRUE(TimeSeriesTransformations::tryIncrementCovarianceTiles(series, 1000, false, [](const MatrixTile&) {}).error() == Status::EmptySeries);
+    EXPECT_TRUE(TimeSeriesTransformations::tryIncrementCovarianceTiles({ &t }, 0, false, [](const MatrixTile&) {}).error() == Status::InvalidArgument);
+}
+
+// test that the cheap date check accepts the days that exist only.
+TEST(TimeSeriesTransformations, isValidDate)
+{
+    EXPECT_TRUE(TimeSeriesTransformations::isValidDate("2020-02-29"));
+    EXPECT_TRUE(TimeSeriesTransformations::isValidDate("2021-12-31 23:59:59"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-02-29"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("1900-02-29"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-04-31"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-13-01"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("not a date"));
+
+    // the format convertToDate writes, with or without the seconds, and nothing else.
+    EXPECT_TRUE(TimeSeriesTransformations::isValidDate("1970-01-01 12:25"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-01-05garbage"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021/1/5 00:00:00"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-1-05"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-01-05 24:00:00"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-01-05 12:00:00 trailing"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2021-01-05  12:00:00"));
+
+    // the dates whose times do not fit an int in every time zone.
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2040-01-01 00:00:00"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("1901-06-01 00:00:00"));
+    EXPECT_FALSE(TimeSeriesTransformations::isValidDate("2038-01-19"));
+    EXPECT_TRUE(TimeSeriesTransformations::isValidDate("2038-01-17 23:59:59"));
+    EXPECT_TRUE(TimeSeriesTransformations::isValidDate("1901-12-15 00:00:00"));
+    TimeSeriesTransformations t;
+    EXPECT_THROW(t.addASharePrice("2040-01-01 00:00:00", 1.0), std::runtime_error);
+    EXPECT_TRUE(t.count() == 0);
+}
+
+// test that the range statistics agree with filtering a copy of the series and computing the statistics on it.
+TEST(TimeSeriesTransformations, rangeStatistics)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    unsigned int state = 7;
+    for (int i = 0; i < 5000; i++)
+    {
+        state = state * 1103515245 + 12345;
+        _time.push_back(1600000000 + 60 * i);
+        _price.push_back(1000.0 + i * 0.01 + (state >> 8) % 1000 / 1000.0);
+    }
+    TimeSeriesTransformations t(_time, _price, "Range");
+
+    int from = 1600000000 + 60 * 1234 + 30, to = 1600000000 + 60 * 3210;
+    std::vector<int> windowTime(_time.begin() + 1235, _time.begin() + 3211);
+    std::vector<double> windowPrice(_price.begin() + 1235, _price.begin() + 3211);
+    TimeSeriesTransformations window(windowTime, windowPrice, "Window");
+
+    double expected, value;
+    EXPECT_TRUE(t.countBetween(from, to) == windowTime.size());
+    window.mean(&expected);
+    EXPECT_TRUE(t.meanBetween(from, to, &value));
+    EXPECT_NEAR(value, expected, 1e-9);
+    window.standardDeviation(&expected);
+    EXPECT_TRUE(t.standardDeviationBetween(from, to, &value));
+    EXPECT_NEAR(value, expected, 1e-9);
+    window.computeIncrementMean(&expected);
+    EXPECT_TRUE(t.incrementMeanBetween(from, to, &value));
+    EXPECT_NEAR(value, expected, 1e-12);
+    window.computeIncrementStandardDeviation(&expected);
+    EXPECT_TRUE(t.incrementStandardDeviationBetween(from, to, &value));
+    EXPECT_NEAR(value, expected, 1e-12);
+
+    // a window with a single price has a mean but no standard deviation, and an empty window has neither.
+    EXPECT_TRUE(t.meanBetween(from, from + 59, &value) && value == _price[1235]);
+    EXPECT_FALSE(t.standardDeviationBetween(from, from + 59, &value) || !std::isnan(value));
+    EXPECT_FALSE(t.meanBetween(to + 1, to + 2, &value) || !std::isnan(value));
+    EXPECT_TRUE(t.countBetween(to, from) == 0);
+}
+
+// test that the range index follows prices added at the end, and prices removed or inserted elsewhere.
+TEST(TimeSeriesTransformations, rangeIndexUpdates)
+{
+    std::vector<int> _time = { 10, 20, 30 };
+    std::vector<double> _price = { 1.0, 2.0, 4.0 };
+    TimeSeriesTransformations t(_time, _price, "Range");
+    double value;
+    EXPECT_TRUE(t.meanBetween(0, 100, &value));
+    EXPECT_NEAR(value, 7.0 / 3, 1e-12);
+
+    t.addSharePrices({ 40, 50 }, { 8.0, 5.0 });
+    EXPECT_TRUE(t.meanBetween(0, 100, &value));
+    EXPECT_NEAR(value, 4.0, 1e-12);
+    EXPECT_TRUE(t.incrementMeanBetween(20, 50, &value));
+    EXPECT_NEAR(value, 1.0, 1e-12);
+
+    t.addSharePrices({ 25 }, { 3.0 });
+    EXPECT_TRUE(t.meanBetween(20, 30, &value));
+    EXPECT_NEAR(value, 3.0, 1e-12);
+
+    t.removePricesGreaterThan(4.5);
+    EXPECT_TRUE(t.countBetween(0, 100) == 4 && t.meanBetween(0, 100, &value));
+    EXPECT_NEAR(value, 2.5, 1e-12);
+
+    TimeSeriesTransformations copy(t);
+    copy.addSharePrices({ 60 }, { 10.0 });
+    EXPECT_TRUE(copy.meanBetween(0, 100, &value));
+    EXPECT_NEAR(value, 4.0, 1e-12);
+    EXPECT_TRUE(t.meanBetween(0, 100, &value));
+    EXPECT_NEAR(value, 2.5, 1e-12);
+}
+
+// test that several threads may run the first range queries of a series at once, each building the indexes it needs only once.
+TEST(TimeSeriesTransformations, rangeQueriesFromSeveralThreads)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 20000; i++)
+    {
+        _time.push_back(60 * i);
+        _price.push_back(100 + (i % 97) - (i % 13));
+    }
+    TimeSeriesTransformations series(_time, _price, "Shared");
+    for (int round = 0; round < 3; round++)
+    {
+        const TimeSeriesTransformations copy(series);
+        std::vector<std::thread> threads;
+        std::vector<int> agree(8, 0);
+        for (int k = 0; k < 8; k++)
+        {
+            threads.emplace_back([&copy, &_time, &_price, &agree, k]()
+            {
+                int from = _time[1000 * k], to = _time[1000 * k + 999];
+                double value, expected = std::accumulate(_price.begin() + 1000 * k, _price.begin() + 1000 * k + 1000, 0.0) / 1000;
+                agree[k] = copy.meanBetween(from, to, &value) && std::abs(value - expected) < 1e-9;
+                agree[k] = agree[k] && copy.maxBetween(from, to, &value) && value == *std::max_element(_price.begin() + 1000 * k, _price.begin() + 1000 * k + 1000);
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        EXPECT_TRUE(std::count(agree.begin(), agree.end(), 1) == 8);
+        series.addSharePrices({ 60 * (20000 + round) }, { 500.0 });
+    }
+}
+
+// test that the range extremums agree with a scan of the window, as the series grows at the end and after a removal.
+TEST(TimeSeriesTransformations, rangeExtremums)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    unsigned int state = 11;
+    for (int i = 0; i < 3000; i++)
+    {
+        state = state * 1103515245 + 12345;
+        _time.push_back(10 * i);
+        _price.push_back((state >> 8) % 100);
+    }
+    TimeSeriesTransformations t(std::vector<int>(_time.begin(), _time.begin() + 2000), std::vector<double>(_price.begin(), _price.begin() + 2000), "Extremums");
+
+    auto check = [&](size_t n)
+    {
+        for (int query = 0; query < 200; query++)
+        {
+            state = state * 1103515245 + 12345;
+            size_t begin = (state >> 8) % n;
+            state = state * 1103515245 + 12345;
+            size_t end = begin + (state >> 8) % (n - begin);
+
+            size_t low = begin, high = begin, smallest = begin, greatest = begin;
+            for (size_t i = begin; i <= end; i++)
+            {
+                low = (_price[i] < _price[low] ? i : low);
+                high = (_price[i] > _price[high] ? i : high);
+                if (i < end)
+                {
+                    smallest = (_price[i + 1] - _price[i] < _price[smallest + 1] - _price[smallest] ? i : smallest);
+                    greatest = (_price[i + 1] - _price[i] > _price[greatest + 1] - _price[greatest] ? i : greatest);
+                }
+            }
+
+            double value;
+            int time;
+            std::pair<int, double> increment;
+            EXPECT_TRUE(t.minBetween(_time[begin], _time[end], &value, &time) && value == _price[low] && time == _time[low]);
+            EXPECT_TRUE(t.maxBetween(_time[begin] - 5, _time[end] + 5, &value, &time) && value == _price[high] && time == _time[high]);
+            if (begin < end)
+            {
+                EXPECT_TRUE(t.smallestIncrementBetween(_time[begin], _time[end], &increment) && increment.first == _time[smallest]);
+                EXPECT_TRUE(t.greatestIncrementBetween(_time[begin], _time[end], &increment) && increment.first == _time[greatest]
+                    && increment.second == _price[greatest + 1] - _price[greatest]);
+            }
+            else
+            {
+                EXPECT_FALSE(t.greatestIncrementBetween(_time[begin], _time[end], &increment));
+            }
+        }
+    };
+
+    check(2000);
+    t.addSharePrices(std::vector<int>(_time.begin() + 2000, _time.end()), std::vector<double>(_price.begin() + 2000, _price.end()));
+    check(3000);
+
+    t.removePricesAfter(TimeSeriesTransformations::convertToDate(_time[2499]));
+    _time.resize(2500);
+    _price.resize(2500);
+    check(2500);
+
+    double value;
+    EXPECT_FALSE(t.minBetween(-10, -1, &value) || !std::isnan(value));
+}
+
+// test that missing prices (NaN) are skipped by the range extremums.
+TEST(TimeSeriesTransformations, rangeExtremumsSkipMissingPrices)
+{
+    std::vector<int> _time;
+    std::vector<double> _price;
+    for (int i = 0; i < 200; i++)
+    {
+        _time.push_back(i);
+        _price.push_back(i % 50 == 7 ? 1000.0 - i : std::numeric_limits<double>::quiet_NaN());
+    }
+    TimeSeriesTransformations t(_time, _price, "Missing");
+    double value;
+    int time;
+    EXPECT_TRUE(t.maxBetween(0, 199, &value, &time) && value == 993.0 && time == 7);
+    EXPECT_TRUE(t.minBetween(0, 199, &value, &time) && value == 843.0 && time == 157);
+    EXPECT_FALSE(t.maxBetween(8, 56, &value));
+}
+
+// test that a durable series is recovered from its log, with its snapshot after a checkpoint, and without a torn record at its end.
+TEST(TimeSeriesTransformations, durableSeriesRecovers)
+{
+    std::remove("Durable.wal");
+    // the times are built from a date, as the dates given below are read in the time zone of the machine.
+    int start = TimeSeriesTransformations::convertToUnix("2020-09-13 12:26:40");
+    std::vector<int> _time = { start, start + 60, start + 120, start + 180 };
+    std::vector<double> _price = { 10.0, 12.0, 11.0, 15.0 };
+    {
+        DurableSeries durable("Durable.wal", "Asset");
+        durable.addSharePrices(_time, _price);
+        durable.addASharePrice("2020-09-13 12:30:00", 9.0);
+        EXPECT_TRUE(durable.removePricesGreaterThan(14.0));
+        EXPECT_FALSE(durable.removePricesLowerThan(1.0));
+        durable.commit();
+    }
+
+    TimeSeriesTransformations expected(std::vector<int>({ start, start + 60, start + 120, TimeSeriesTransformations::convertToUnix("2020-09-13 12:30:00") }),
+        std::vector<double>({ 10.0, 12.0, 11.0, 9.0 }), "Asset");
+
+    // operator== only compares the first rows, so the whole columns are compared.
+    auto recovered = [&expected]()
+    {
+        TimeSeriesTransformations t = WriteAheadLog::recover("Durable.wal");
+        return t.getTime() == expected.getTime() && t.getPrice() == expected.getPrice();
+    };
+    EXPECT_TRUE(recovered());
+
+    // a torn record is ignored by recovery and cut off when the log is opened again.
+    {
+        std::ofstream out("Durable.wal", std::ios::binary | std::ios::app);
+        out.write("torn record", 11);
+    }
+    EXPECT_TRUE(recovered());
+    {
+        DurableSeries durable("Durable.wal");
+        EXPECT_TRUE(durable.series().getTime() == expected.getTime() && durable.series().getPrice() == expected.getPrice());
+        EXPECT_EQ(durable.series().getName(), "Asset");
+        durable.checkpoint();
+        EXPECT_TRUE(durable.removePricesBefore("2020-09-13 12:27:00"));
+    }
+    expected.removePricesBefore("2020-09-13 12:27:00");
+    EXPECT_TRUE(recovered());
+}
+
+// test that the removals by date are replayed at the times they removed, whatever the time zone of the machine.
+TEST(TimeSeriesTransformations, durableSeriesReplaysRemovals)
+{
+    std::remove("DurableRemovals.wal");
+    std::vector<int> times;
+    std::vector<double> prices;
+    for (int i = 0; i < 12; i++)
+    {
+        times.push_back(TimeSeriesTransformations::convertToUnix("2021-01-05 00:00:00") + 1800 * i);
+        prices.push_back(i);
+    }
+    TimeSeriesTransformations expected(times, prices, "Asset");
+    {
+        DurableSeries durable("DurableRemovals.wal", "Asset");
+        durable.addSharePrices(times, prices);
+        EXPECT_TRUE(durable.removePricesBefore("2021-01-05 02:00:00"));
+        EXPECT_TRUE(durable.removePricesAfter("2021-01-05 05:00:00"));
+        EXPECT_TRUE(durable.removeEntryAtTime("2021-01-05 03:30:00"));
+        durable.commit();
+        expected = durable.series();
+    }
+    EXPECT_EQ(expected.count(), 6);
+    TimeSeriesTransformations t = WriteAheadLog::recover("DurableRemovals.wal");
+    EXPECT_TRUE(t.getTime() == expected.getTime() && t.getPrice() == expected.getPrice());
+}
+
+// test that records appended from several threads and committed concurrently are all durable and replayed.
+TEST(TimeSeriesTransformations, writeAheadLogGroupCommit)
+{
+    std::remove("GroupCommit.wal");
+    {
+        WriteAheadLog log("GroupCommit.wal", "Ticks", 64);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&log, t]()
+            {
+                for (int i = 0; i < 500; i++)
+                {
+                    uint64_t sequence = log.append(LogOperation::Insert, t * 1000 + i, (double)i);
+                    if (i % 50 == 49)
+                    {
+                        log.commit(sequence);
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        EXPECT_TRUE(log.appended() == 2000 && log.durable() == 2000);
+    }
+
+    TimeSeriesTransformations recovered = WriteAheadLog::recover("GroupCommit.wal");
+    EXPECT_TRUE(recovered.count() == 2000 && recovered.getName() == "Ticks");
+    double value;
+    recovered.mean(&value);
+    EXPECT_DOUBLE_EQ(value, 249.5);
+}
+
+// test that a file loaded through the cache is read back from its sidecar while it is unchanged, and parsed again once it changes.
+TEST(TimeSeriesTransformations, loadCache)
+{
+    std::remove("LoadCache/cache.csv");
+    std::shared_ptr<LoadCache> cache = std::make_shared<LoadCache>("LoadCache");
+    TimeSeriesTransformations::setLoadCache(cache);
+    {
+        std::ofstream out("Cached.csv");
+        out << "Date,Cached\n30,3.5\n10,1.25\n20,2.0\n";
+    }
+    TimeSeriesTransformations parsed("Cached.csv");
+    EXPECT_TRUE(cache->entryCount() == 1);
+
+    // the sidecar has the series as parsed (sorted), for both loaders.
+    TimeSeriesTransformations cached("Cached.csv");
+    TimeSeriesTransformations loaded = TimeSeriesTransformations::load("Cached.csv");
+    EXPECT_TRUE(cached == parsed && loaded == parsed && cached.getName() == "Cached" && cached.getSeparator() == ',');
+    EXPECT_TRUE(cached.getTime() == std::vector<int>({ 10, 20, 30 }));
+
+    // another duplicate policy is another entry.
+    TimeSeriesTransformations::load("Cached.csv", LoadOptions());
+    TimeSeriesTransformations("Cached.csv", DuplicatePolicy::KeepLast);
+    EXPECT_TRUE(cache->entryCount() == 2);
+
+    {
+        std::ofstream out("Cached.csv");
+        out << "Date,Cached\n10,1.25\n20,2.0\n30,3.5\n40,4.75\n";
+    }
+    TimeSeriesTransformations changed("Cached.csv");
+    EXPECT_TRUE(changed.count() == 4);
+    EXPECT_TRUE(TimeSeriesTransformations("Cached.csv") == changed);
+    TimeSeriesTransformations::setLoadCache(nullptr);
+}
+
+// test that the file constructor still refuses a file without a header once load has cached it.
+TEST(TimeSeriesTransformations, loadCacheHeaderlessFile)
+{
+    std::remove("LoadCacheHeaderless/cache.csv");
+    std::shared_ptr<LoadCache> cache = std::make_shared<LoadCache>("LoadCacheHeaderless");
+    TimeSeriesTransformations::setLoadCache(cache);
+    {
+        std::ofstream out("Headerless.csv");
+        out << "10,1.25\n20,2.0\n";
+    }
+    TimeSeriesTransformations loaded = TimeSeriesTransformations::load("Headerless.csv");
+    EXPECT_TRUE(cache->entryCount() == 1 && loaded.getName() == "No name provided" && loaded.count() == 2);
+    EXPECT_THROW(TimeSeriesTransformations("Headerless.csv"), std::runtime_error);
+    EXPECT_TRUE(TimeSeriesTransformations::load("Headerless.csv") == loaded);
+    TimeSeriesTransformations::setLoadCache(nullptr);
+}
+
+// test that the least recently used sidecars are removed beyond the size limit.
+TEST(TimeSeriesTransformations, loadCacheEviction)
+{
+    std::remove("LoadCacheSmall/cache.csv");
+    std::shared_ptr<LoadCache> cache = std::make_shared<LoadCache>("LoadCacheSmall", 320);
+    TimeSeriesTransformations::setLoadCache(cache);
+    for (int f = 0; f < 3; f++)
+    {
+        std::ofstream out("Evicted" + std::to_string(f) + ".csv");
+        out << "Date,Evicted\n";
+        for (int i = 0; i < 5; i++)
+        {
+            out << i << ',' << f + i << '\n';
+        }
+    }
+    TimeSeriesTransformations("Evicted0.csv");
+    TimeSeriesTransformations("Evicted1.csv");
+    TimeSeriesTransformations("Evicted0.csv");
+    TimeSeriesTransformations("Evicted2.csv");
+    TimeSeriesTransformations::setLoadCache(nullptr);
+
+    // Evicted1 was the least recently used.
+    EXPECT_TRUE(cache->size() <= 320 && cache->entryCount() == 2);
+    TimeSeriesTransformations t;
+    EXPECT_TRUE(cache->lookup("Evicted0.csv", DuplicatePolicy::KeepAll, &t) && t.count() == 5);
+    EXPECT_FALSE(cache->lookup("Evicted1.csv", DuplicatePolicy::KeepAll, &t));
+}
+
+// test the answers of the query server to each kind of request.
+TEST(TimeSeriesTransformations, queryServerAnswers)
+{
+    TimeSeriesTransformations t;
+    t.addASharePrice("2020-01-01 10:00:00", 1.0);
+    t.addASharePrice("2020-01-01 12:00:00", 3.0);
+    t.addASharePrice("2020-01-02 09:00:00", 2.0);
+    QueryServer server("QueryServer.sock", 2);
+    server.add("Shares", t);
+
+    EXPECT_EQ(server.query("LIST"), "OK 1 Shares");
+    EXPECT_EQ(server.query("STATS Shares").substr(0, 7), "OK 3 2 ");
+    EXPECT_EQ(server.query("PRICE Shares 2020-01-01 12:00:00"), "OK 3");
+    EXPECT_EQ(server.query("PRICE Shares 2020-01-01 11:00:00"), "ERR DateNotFound");
+    EXPECT_EQ(server.query("PRICE Shares 2021-02-29 11:00:00"), "ERR InvalidDate");
+    EXPECT_EQ(server.query("DAY Shares 2020-01-01"), "OK 2 1 3");
+    EXPECT_EQ(server.query("DAY Shares 2020-01-03"), "OK 0");
+    EXPECT_EQ(server.query("DAY Shares 2019-12-31"), "OK 0");
+    int from = TimeSeriesTransformations::convertToUnix("2020-01-01 11:00:00");
+    int to = TimeSeriesTransformations::convertToUnix("2020-01-02 09:00:00");
+    EXPECT_EQ(server.query("RANGE Shares " + std::to_string(from) + " " + std::to_string(to)).substr(0, 9), "OK 2 2.5 ");
+    EXPECT_EQ(server.query("RANGE Shares 0 1"), "OK 0 nan nan nan nan");
+    EXPECT_EQ(server.query("STATS Bonds"), "ERR UnknownSeries");
+    EXPECT_EQ(server.query("SELECT"), "ERR UnknownCommand");
+    EXPECT_TRUE(server.remove("Shares") && server.query("LIST") == "OK 0");
+}
+
+#ifdef __linux__
+// test that pipelined requests sent over the socket by several clients are answered in order.
+TEST(TimeSeriesTransformations, queryServerSocket)
+{
+    TimeSeriesTransformations t;
+    for (int i = 0; i < 1000; i++)
+    {
+        t.addASharePrice(TimeSeriesTransformations::convertToDate(1577836800 + 60 * i), i);
+    }
+    QueryServer server("QueryServer.sock", 2);
+    server.add("Minutes", t);
+    server.start();
+
+    auto ask = [](const std::string& requests)
+    {
+        int client = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, "QueryServer.sock");
+        EXPECT_EQ(connect(client, (const sockaddr*)&address, sizeof(address)), 0);
+        EXPECT_EQ(write(client, requests.data(), requests.size()), (ssize_t)requests.size());
+        shutdown(client, SHUT_WR);
+        std::string answers;
+        char buffer[4096];
+        for (ssize_t received; (received = read(client, buffer, sizeof(buffer))) > 0;)
+        {
+            answers.append(buffer, (size_t)received);
+        }
+        close(client);
+        return answers;
+    };
+
+    std::vector<std::string> answers(4);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < 4; c++)
+    {
+        clients.emplace_back([&, c]()
+        {
+            std::string requests;
+            for (int i = 0; i < 50; i++)
+            {
+                requests += "PRICE Minutes " + TimeSeriesTransformations::convertToDate(1577836800 + 60 * (c * 50 + i)) + "\n";
+            }
+
+            // the last request has no line break: it is answered when the client shuts down its side.
+            answers[c] = ask(requests + "RANGE Minutes " + std::to_string(t.getTime()[0]) + " " + std::to_string(t.getTime()[9]));
+        });
+    }
+    for (std::thread& client : clients)
+    {
+        client.join();
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        std::string expected;
+        for (int i = 0; i < 50; i++)
+        {
+            expected += "OK " + std::to_string(c * 50 + i) + "\n";
+        }
+        EXPECT_EQ(answers[c], expected + "OK 10 4.5 3.0276503540974917 0 9\n");
+    }
+    server.stop();
+    EXPECT_FALSE(std::ifstream("QueryServer.sock").good());
+}
+
+// test that the server replaces a socket file left at its path, but neither removes nor uses a regular file there.
+TEST(TimeSeriesTransformations, queryServerSocketPath)
+{
+    std::ofstream("QueryServer.sock") << "not a socket";
+    QueryServer server("QueryServer.sock", 1);
+    EXPECT_THROW(server.start(), std::runtime_error);
+    std::string content;
+    std::getline(std::ifstream("QueryServer.sock"), content);
+    EXPECT_EQ(content, "not a socket");
+    remove("QueryServer.sock");
+
+    int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, "QueryServer.sock");
+    ASSERT_EQ(bind(stale, (const sockaddr*)&address, sizeof(address)), 0);
+    close(stale);
+    EXPECT_NO_THROW(server.start());
+    server.stop();
+    EXPECT_FALSE(std::ifstream("QueryServer.sock").good());
+}
+
+// test that a client whose answers go over the limit of unwritten answers still gets them all, in order, as it reads them.
+TEST(TimeSeriesTransformations, queryServerLargeAnswers)
+{
+    TimeSeriesTransformations t;
+    for (int i = 0; i < 300; i++)
+    {
+        t.addASharePrice(TimeSeriesTransformations::convertToDate(1577836800 + 60 * i), 1000.5 + i);
+    }
+    QueryServer server("QueryServer.sock", 2);
+    server.add("Minutes", t);
+    server.start();
+
+    // about 70 KB of requests (more than a batch) and 6 MB of answers.
+    const int requests = 3000;
+    const std::string request = "DAY Minutes " + TimeSeriesTransformations::convertToDate(1577836800).substr(0, 10);
+    const std::string expected = server.query(request) + "\n";
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, "QueryServer.sock");
+    ASSERT_EQ(connect(client, (const sockaddr*)&address, sizeof(address)), 0);
+    std::thread writer([&]()
+    {
+        for (int i = 0; i < requests; i++)
+        {
+            std::string line = request + "\n";
+            EXPECT_EQ(write(client, line.data(), line.size()), (ssize_t)line.size());
+        }
+        shutdown(client, SHUT_WR);
+    });
+    std::string answers;
+    char buffer[65536];
+    for (ssize_t received; (received = read(client, buffer, sizeof(buffer))) > 0;)
+    {
+        answers.append(buffer, (size_t)received);
+    }
+    writer.join();
+    close(client);
+    server.stop();
+
+    ASSERT_EQ(answers.size(), expected.size() * requests);
+    for (int i = 0; i < requests; i++)
+    {
+        EXPECT_EQ(answers.compare(expected.size() * i, expected.size(), expected), 0);
+    }
+}
+#endif
+
+// test that Largest-Triangle-Three-Buckets keeps the ends, the time order and a spike, and only looks at the range asked for.
+TEST(TimeSeriesTransformations, downsampleLargestTriangle)
+{
+    TimeSeriesTransformations t;
+    for (int i = 0; i < 1000; i++)
+    {
+        t.addASharePrice(TimeSeriesTransformations::convertToDate(1577836800 + 60 * i), (i == 437 ? 50.0 : sin(i / 50.0)));
+    }
+
+    TimeSeriesTransformations d = t.downsampled(50);
+    std::vector<int> times = d.getTime();
+    std::vector<double> prices = d.getPrice();
+    EXPECT_EQ(d.count(), 50);
+    EXPECT_TRUE(times.front() == 1577836800 && times.back() == 1577836800 + 60 * 999);
+    EXPECT_TRUE(std::is_sorted(times.begin(), times.end()));
+    EXPECT_TRUE(std::find(prices.begin(), prices.end(), 50.0) != prices.end());
+
+    // a range holding fewer prices than asked for is copied as it is.
+    TimeSeriesTransformations r = t.downsampledBetween(1577836800 + 60 * 100, 1577836800 + 60 * 119, 50);
+    EXPECT_TRUE(r.count() == 20 && r.getTime().front() == 1577836800 + 60 * 100);
+    EXPECT_EQ(t.downsampled(2).count(), 2);
+    EXPECT_EQ(t.downsampled(0).count(), 0);
+}
+
+// test that the min/max decimation keeps the lowest and highest prices, and that the save path writes the reduced series.
+TEST(TimeSeriesTransformations, downsampleMinMax)
+{
+    TimeSeriesTransformations t;
+    for (int i = 0; i < 1000; i++)
+    {
+        t.addASharePrice(TimeSeriesTransformations::convertToDate(1577836800 + 60 * i), (i == 600 ? -7.0 : i % 10));
+    }
+
+    int times[21];
+    double prices[21];
+    size_t size = t.downsample(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 21, DownsampleMethod::MinMax, times, prices);
+    EXPECT_TRUE(size <= 21 && size >= 11);
+    EXPECT_TRUE(std::is_sorted(times, times + size));
+    EXPECT_EQ(*std::min_element(prices, prices + size), -7.0);
+    EXPECT_EQ(*std::max_element(prices, prices + size), 9.0);
+
+    t.saveDataHumanDate("Downsampled", 10, DownsampleMethod::MinMax);
+    std::ifstream in("Downsampled.csv");
+    std::string line;
+    int lines = 0;
+    while (getline(in, line))
+    {
+        lines++;
+    }
+    EXPECT_TRUE(lines > 1 && lines <= 11);
+}
+
+// test that a series parsed from a file that changed while it was parsed is not stored.
+TEST(TimeSeriesTransformations, loadCacheSkipsChangedSource)
+{
+    std::remove("LoadCacheChanged/cache.csv");
+    LoadCache cache("LoadCacheChanged");
+    {
+        std::ofstream out("Changing.csv");
+        out << "Date,Changing\n10,1.0\n20,2.0\n";
+    }
+    TimeSeriesTransformations t;
+    LoadCache::FileVersion version;
+    EXPECT_FALSE(cache.lookup("Changing.csv", DuplicatePolicy::KeepAll, &t, &version));
+    EXPECT_TRUE(version.known && version.size > 0);
+    TimeSeriesTransformations parsed("Changing.csv");
+
+    // rows appended after the version was taken: the rows parsed before are stale.
+    {
+        std::ofstream out("Changing.csv", std::ios::app);
+        out << "30,3.0\n";
+    }
+    cache.store("Changing.csv", DuplicatePolicy::KeepAll, version, parsed, true);
+    EXPECT_EQ(cache.entryCount(), 0u);
+
+    EXPECT_FALSE(cache.lookup("Changing.csv", DuplicatePolicy::KeepAll, &t, &version));
+    cache.store("Changing.csv", DuplicatePolicy::KeepAll, version, TimeSeriesTransformations("Changing.csv"), true);
+    EXPECT_TRUE(cache.entryCount() == 1 && cache.lookup("Changing.csv", DuplicatePolicy::KeepAll, &t) && t.count() == 3);
+}
+
+// test that several threads storing the same file at once leave a single valid sidecar.
+TEST(TimeSeriesTransformations, loadCacheConcurrentStores)
+{
+    std::remove("LoadCacheShared/cache.csv");
+    LoadCache cache("LoadCacheShared");
+    {
+        std::ofstream out("Shared.csv");
+        out << "Date,Shared\n";
+        for (int i = 0; i < 2000; i++)
+        {
+            out << 10 * i << ',' << i % 17 << '\n';
+        }
+    }
+    TimeSeriesTransformations parsed("Shared.csv");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            TimeSeriesTransformations t;
+            LoadCache::FileVersion version;
+            cache.lookup("Shared.csv", DuplicatePolicy::KeepAll, &t, &version);
+            cache.store("Shared.csv", DuplicatePolicy::KeepAll, version, parsed, true);
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    TimeSeriesTransformations t;
+    EXPECT_TRUE(cache.entryCount() == 1 && cache.lookup("Shared.csv", DuplicatePolicy::KeepAll, &t));
+    EXPECT_TRUE(t.getTime() == parsed.getTime() && t.getPrice() == parsed.getPrice());
+}